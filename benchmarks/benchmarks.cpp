@@ -0,0 +1,660 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+// Measures the public algorithms on generated corpora. Every algorithm runs
+// on a std::basic_string, which takes the vectorized code paths, and on a
+// std::deque, which takes the generic (scalar) ones.
+//
+// usage: UTF8++_benchmarks [--size <octets>] [--min-time <seconds>]
+//                          [--filter <substring>] [--json]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <utf8.h>
+
+#include "corpus.hpp"
+
+namespace
+{
+#if defined(UTF8_SIMD_AVX2)
+const char *const isa = "avx2";
+#elif defined(UTF8_SIMD_SSE42)
+const char *const isa = "sse4.2";
+#else
+const char *const isa = "fallback";
+#endif
+
+#if defined(UTF8_DFA_DECODER)
+const bool dfa_decoder = true;
+#else
+const bool dfa_decoder = false;
+#endif
+
+// a corpus in all encodings and containers the algorithms run on
+struct corpus_data
+{
+    std::string name;
+    bool valid;
+    std::size_t code_points;
+
+    std::string u8;
+    std::deque<char> u8_deque;
+    std::u16string u16;
+    std::deque<char16_t> u16_deque;
+    std::u32string u32;
+    std::deque<char32_t> u32_deque;
+    // the low octets of the code points
+    std::string latin1;
+    std::deque<char> latin1_deque;
+
+    std::vector<char> out8;
+    std::vector<char16_t> out16;
+    std::vector<char32_t> out32;
+
+    corpus_data( const corpus::description &desc, std::size_t size )
+        : name( desc.name )
+        , u8( corpus::generate( desc, size ) )
+    {
+        valid = utf8::is_valid( u8.cbegin( ), u8.cend( ) );
+        code_points = utf8::utf32_length_from_utf8( u8.cbegin( ), u8.cend( ) );
+        u8_deque.assign( u8.cbegin( ), u8.cend( ) );
+        if (valid)
+        {
+            utf8::utf8to16( u8.cbegin( ), u8.cend( ), std::back_inserter( u16 ) );
+            utf8::utf8to32( u8.cbegin( ), u8.cend( ), std::back_inserter( u32 ) );
+            u16_deque.assign( u16.cbegin( ), u16.cend( ) );
+            u32_deque.assign( u32.cbegin( ), u32.cend( ) );
+            for (char32_t cp : u32)
+            {
+                latin1 += static_cast<char>(cp & 0xFF);
+            }
+            latin1_deque.assign( latin1.cbegin( ), latin1.cend( ) );
+        }
+        out8.resize( 3 * u8.size( ) + 4 );
+        out16.resize( u8.size( ) + 1 );
+        out32.resize( u8.size( ) + 1 );
+    }
+};
+
+enum class input_encoding
+{
+    utf8,
+    utf16,
+    utf32,
+    latin1,
+};
+
+template< input_encoding >
+struct encoding_tag
+{
+};
+
+// the input of a benchmark, std::true_type selects the contiguous one
+inline const std::string &input_of( const corpus_data &d, encoding_tag<input_encoding::utf8>, std::true_type )
+{
+    return d.u8;
+}
+
+inline const std::deque<char> &input_of( const corpus_data &d, encoding_tag<input_encoding::utf8>, std::false_type )
+{
+    return d.u8_deque;
+}
+
+inline const std::u16string &input_of( const corpus_data &d, encoding_tag<input_encoding::utf16>, std::true_type )
+{
+    return d.u16;
+}
+
+inline const std::deque<char16_t> &input_of( const corpus_data &d, encoding_tag<input_encoding::utf16>, std::false_type )
+{
+    return d.u16_deque;
+}
+
+inline const std::u32string &input_of( const corpus_data &d, encoding_tag<input_encoding::utf32>, std::true_type )
+{
+    return d.u32;
+}
+
+inline const std::deque<char32_t> &input_of( const corpus_data &d, encoding_tag<input_encoding::utf32>, std::false_type )
+{
+    return d.u32_deque;
+}
+
+inline const std::string &input_of( const corpus_data &d, encoding_tag<input_encoding::latin1>, std::true_type )
+{
+    return d.latin1;
+}
+
+inline const std::deque<char> &input_of( const corpus_data &d, encoding_tag<input_encoding::latin1>, std::false_type )
+{
+    return d.latin1_deque;
+}
+
+struct benchmark
+{
+    typedef std::size_t (*function)( corpus_data & );
+
+    const char *name;
+    input_encoding input;
+    // whether the algorithm throws on (or requires) invalid input
+    bool requires_valid;
+    function contiguous;
+    function generic;
+};
+
+std::vector<benchmark> &registry( )
+{
+    static std::vector<benchmark> benchmarks;
+    return benchmarks;
+}
+
+struct registrar
+{
+    explicit registrar( const benchmark &b )
+    {
+        registry( ).push_back( b );
+    }
+};
+
+// Defines a benchmark which evaluates expr with c referring to the input
+// container and d to the corpus_data (providing the output buffers).
+#define UTF8_BENCHMARK( id, name, encoding, requires_valid, expr ) \
+    struct id \
+    { \
+        template< typename contiguous > \
+        static std::size_t run( corpus_data &d ) \
+        { \
+            const auto &c = input_of( d, encoding_tag<input_encoding::encoding>( ), contiguous( ) ); \
+            (void)c; \
+            return static_cast<std::size_t>(expr); \
+        } \
+    }; \
+    const registrar id##_registrar( { name, input_encoding::encoding, requires_valid, \
+        &id::run<std::true_type>, &id::run<std::false_type> } )
+
+template< typename container >
+std::size_t measure_checked_next( const container &c )
+{
+    std::size_t sum = 0;
+    for (auto it = c.begin( ); it != c.end( ); )
+    {
+        sum += utf8::next( it, c.end( ) );
+    }
+    return sum;
+}
+
+template< typename container >
+std::size_t measure_unchecked_next( const container &c )
+{
+    std::size_t sum = 0;
+    for (auto it = c.begin( ); it != c.end( ); )
+    {
+        sum += utf8::unchecked::next( it );
+    }
+    return sum;
+}
+
+template< typename container >
+std::size_t measure_checked_iterate( const container &c )
+{
+    typedef utf8::iterator<typename container::const_iterator> iterator;
+    std::size_t sum = 0;
+    for (iterator it( c.begin( ), c.begin( ), c.end( ) ), end( c.end( ), c.begin( ), c.end( ) ); it != end; ++it)
+    {
+        sum += *it;
+    }
+    return sum;
+}
+
+// walks backwards, e.g. in order to tail a log file
+template< typename container >
+std::size_t measure_checked_reverse_iterate( const container &c )
+{
+    typedef utf8::iterator<typename container::const_iterator> iterator;
+    std::size_t sum = 0;
+    for (iterator it( c.end( ), c.begin( ), c.end( ) ), begin( c.begin( ), c.begin( ), c.end( ) ); it != begin; )
+    {
+        sum += *--it;
+    }
+    return sum;
+}
+
+template< typename container >
+std::size_t measure_unchecked_iterate( const container &c )
+{
+    typedef utf8::unchecked::iterator<typename container::const_iterator> iterator;
+    std::size_t sum = 0;
+    for (iterator it( c.begin( ) ), end( c.end( ) ); it != end; ++it)
+    {
+        sum += *it;
+    }
+    return sum;
+}
+
+template< typename container >
+std::size_t measure_checked_advance( const container &c, std::size_t n )
+{
+    auto it = c.begin( );
+    utf8::advance( it, n, c.end( ) );
+    return static_cast<std::size_t>(it - c.begin( ));
+}
+
+template< typename container >
+std::size_t measure_unchecked_advance( const container &c, std::size_t n )
+{
+    auto it = c.begin( );
+    utf8::unchecked::advance( it, n );
+    return static_cast<std::size_t>(it - c.begin( ));
+}
+
+template< typename container >
+std::size_t measure_checked_retreat( const container &c, std::size_t n )
+{
+    auto it = c.end( );
+    utf8::retreat( it, n, c.begin( ) );
+    return static_cast<std::size_t>(c.end( ) - it);
+}
+
+template< typename container >
+std::size_t measure_unchecked_retreat( const container &c, std::size_t n )
+{
+    auto it = c.end( );
+    utf8::unchecked::retreat( it, n );
+    return static_cast<std::size_t>(c.end( ) - it);
+}
+
+// the lengths needed to preallocate the output of 64KiB work items
+template< typename container >
+std::size_t measure_chunk_view( const container &c )
+{
+    std::size_t sum = 0;
+    for (const auto &chunk : utf8::chunk_view<typename container::const_iterator>( c.begin( ), c.end( ), 1 << 16 ))
+    {
+        sum += chunk.code_points + chunk.utf16_length + chunk.ascii;
+    }
+    return sum;
+}
+
+// the usual way to search for a code point, for comparison with utf8::find
+template< typename container >
+std::size_t measure_find_by_iterator( const container &c, char32_t cp )
+{
+    typedef utf8::iterator<typename container::const_iterator> iterator;
+    const iterator begin( c.begin( ), c.begin( ), c.end( ) ), end( c.end( ), c.begin( ), c.end( ) );
+    return static_cast<std::size_t>(std::find( begin, end, cp ).base( ) - c.begin( ));
+}
+
+// the usual way to obtain a new string, for comparison with to_u16string
+template< typename container >
+std::size_t measure_back_inserter( const container &c )
+{
+    std::u16string str;
+    utf8::utf8to16( c.begin( ), c.end( ), std::back_inserter( str ) );
+    return str.size( );
+}
+
+template< typename container >
+std::size_t measure_stream_decode( const container &c, std::vector<char16_t> &out )
+{
+    // chunks of the size of a typical socket read
+    utf8::stream_transcoder<char16_t> transcoder;
+    auto result = out.begin( );
+    for (auto it = c.begin( ); it != c.end( ); )
+    {
+        const auto chunk_end = c.end( ) - it > 4000 ? it + 4000 : c.end( );
+        result = transcoder.decode( it, chunk_end, result ).out;
+        it = chunk_end;
+    }
+    return static_cast<std::size_t>(result - out.begin( ));
+}
+
+// the branchy implementations of detail::sequence_length and
+// detail::encode, which are measured for comparison
+inline std::size_t branchy_sequence_length( uint8_t lead )
+{
+    if (lead < 0x80)
+        return 1;
+    else if ((lead >> 5) == 0x6)
+        return 2;
+    else if ((lead >> 4) == 0xe)
+        return 3;
+    else if ((lead >> 3) == 0x1e)
+        return 4;
+    return 0;
+}
+
+inline char *branchy_encode( char32_t cp, char *result )
+{
+    if (cp < 0x80)
+    {
+        *result++ = static_cast<char>(cp);
+    }
+    else if (cp < 0x800)
+    {
+        *result++ = static_cast<char>(cp >> 6 | 0xc0);
+        *result++ = static_cast<char>((cp & 0x3f) | 0x80);
+    }
+    else if (cp < 0x10000)
+    {
+        *result++ = static_cast<char>(cp >> 12 | 0xe0);
+        *result++ = static_cast<char>((cp >> 6 & 0x3f) | 0x80);
+        *result++ = static_cast<char>((cp & 0x3f) | 0x80);
+    }
+    else
+    {
+        *result++ = static_cast<char>(cp >> 18 | 0xf0);
+        *result++ = static_cast<char>((cp >> 12 & 0x3f) | 0x80);
+        *result++ = static_cast<char>((cp >> 6 & 0x3f) | 0x80);
+        *result++ = static_cast<char>((cp & 0x3f) | 0x80);
+    }
+    return result;
+}
+
+// steps from lead to lead
+template< typename container, typename length_function >
+std::size_t measure_sequence_length( const container &c, length_function length )
+{
+    std::size_t n = 0;
+    for (auto it = c.begin( ); it != c.end( ); ++n)
+    {
+        it += length( static_cast<uint8_t>(*it) );
+    }
+    return n;
+}
+
+// encodes one code point after another into a pointer
+template< typename container, typename encode_function >
+std::size_t measure_encode( const container &c, std::vector<char> &out, encode_function encode )
+{
+    char *const first = out.data( );
+    char *result = first;
+    for (auto it = c.begin( ); it != c.end( ); ++it)
+    {
+        result = encode( static_cast<char32_t>(*it), result );
+    }
+    return static_cast<std::size_t>(result - first);
+}
+
+UTF8_BENCHMARK( find_invalid, "find_invalid", utf8, false,
+    utf8::find_invalid( c.begin( ), c.end( ) ) - c.begin( ) );
+UTF8_BENCHMARK( find_last_invalid, "find_last_invalid", utf8, false,
+    utf8::find_last_invalid( c.begin( ), c.end( ) ) - c.begin( ) );
+UTF8_BENCHMARK( is_valid, "is_valid", utf8, false,
+    utf8::is_valid( c.begin( ), c.end( ) ) );
+UTF8_BENCHMARK( replace_invalid, "replace_invalid", utf8, false,
+    utf8::replace_invalid( c.begin( ), c.end( ), d.out8.begin( ) ) - d.out8.begin( ) );
+UTF8_BENCHMARK( try_utf8to16, "try_utf8to16", utf8, false,
+    utf8::try_utf8to16( c.begin( ), c.end( ), d.out16.begin( ) ).out - d.out16.begin( ) );
+UTF8_BENCHMARK( utf8to16_replace, "utf8to16<replace>", utf8, false,
+    utf8::utf8to16<utf8::error_policy::replace>( c.begin( ), c.end( ), d.out16.begin( ) ).out - d.out16.begin( ) );
+UTF8_BENCHMARK( stream_transcoder, "stream_transcoder<char16_t>", utf8, false,
+    measure_stream_decode( c, d.out16 ) );
+UTF8_BENCHMARK( utf16_length_from_utf8, "utf16_length_from_utf8", utf8, false,
+    utf8::utf16_length_from_utf8( c.begin( ), c.end( ) ) );
+UTF8_BENCHMARK( chunk_view, "chunk_view", utf8, true,
+    measure_chunk_view( c ) );
+// U+FFFE doesn't occur in the corpora, i.e. the whole input is searched
+UTF8_BENCHMARK( find_code_point, "find", utf8, true,
+    utf8::find( c.begin( ), c.end( ), U'\uFFFE' ) - c.begin( ) );
+UTF8_BENCHMARK( find_by_iterator, "find/iterator", utf8, true,
+    measure_find_by_iterator( c, U'\uFFFE' ) );
+UTF8_BENCHMARK( count_code_point, "count", utf8, true,
+    utf8::count( c.begin( ), c.end( ), U' ' ) );
+UTF8_BENCHMARK( utf8_length_from_utf16, "utf8_length_from_utf16", utf16, true,
+    utf8::utf8_length_from_utf16( c.begin( ), c.end( ) ) );
+UTF8_BENCHMARK( utf8_length_from_utf32, "utf8_length_from_utf32", utf32, true,
+    utf8::utf8_length_from_utf32( c.begin( ), c.end( ) ) );
+UTF8_BENCHMARK( utf8_length_from_latin1, "utf8_length_from_latin1", latin1, true,
+    utf8::utf8_length_from_latin1( c.begin( ), c.end( ) ) );
+UTF8_BENCHMARK( try_utf8tolatin1, "try_utf8tolatin1", utf8, false,
+    utf8::try_utf8tolatin1( c.begin( ), c.end( ), d.out8.begin( ) ).out - d.out8.begin( ) );
+
+UTF8_BENCHMARK( checked_next, "checked/next", utf8, true,
+    measure_checked_next( c ) );
+UTF8_BENCHMARK( checked_iterator, "checked/iterator", utf8, true,
+    measure_checked_iterate( c ) );
+UTF8_BENCHMARK( checked_reverse_iterator, "checked/iterator/reverse", utf8, true,
+    measure_checked_reverse_iterate( c ) );
+UTF8_BENCHMARK( checked_distance, "checked/distance", utf8, true,
+    utf8::distance( c.begin( ), c.end( ) ) );
+UTF8_BENCHMARK( checked_advance, "checked/advance", utf8, true,
+    measure_checked_advance( c, d.code_points ) );
+UTF8_BENCHMARK( checked_retreat, "checked/retreat", utf8, true,
+    measure_checked_retreat( c, d.code_points ) );
+UTF8_BENCHMARK( checked_utf8to16, "checked/utf8to16", utf8, true,
+    utf8::utf8to16( c.begin( ), c.end( ), d.out16.begin( ) ) - d.out16.begin( ) );
+UTF8_BENCHMARK( checked_utf8to32, "checked/utf8to32", utf8, true,
+    utf8::utf8to32( c.begin( ), c.end( ), d.out32.begin( ) ) - d.out32.begin( ) );
+UTF8_BENCHMARK( checked_utf16to8, "checked/utf16to8", utf16, true,
+    utf8::utf16to8( c.begin( ), c.end( ), d.out8.begin( ) ) - d.out8.begin( ) );
+UTF8_BENCHMARK( checked_utf32to8, "checked/utf32to8", utf32, true,
+    utf8::utf32to8( c.begin( ), c.end( ), d.out8.begin( ) ) - d.out8.begin( ) );
+UTF8_BENCHMARK( checked_utf16to32, "checked/utf16to32", utf16, true,
+    utf8::utf16to32( c.begin( ), c.end( ), d.out32.begin( ) ) - d.out32.begin( ) );
+UTF8_BENCHMARK( checked_utf32to16, "checked/utf32to16", utf32, true,
+    utf8::utf32to16( c.begin( ), c.end( ), d.out16.begin( ) ) - d.out16.begin( ) );
+UTF8_BENCHMARK( checked_latin1to8, "checked/latin1to8", latin1, true,
+    utf8::latin1to8( c.begin( ), c.end( ), d.out8.begin( ) ) - d.out8.begin( ) );
+UTF8_BENCHMARK( checked_back_inserter, "utf8to16/back_inserter", utf8, true,
+    measure_back_inserter( c ) );
+UTF8_BENCHMARK( to_u16string, "to_u16string", utf8, true,
+    utf8::to_u16string( c.begin( ), c.end( ) ).size( ) );
+
+UTF8_BENCHMARK( detail_sequence_length, "detail/sequence_length", utf8, true,
+    measure_sequence_length( c, utf8::detail::sequence_length<std::size_t> ) );
+UTF8_BENCHMARK( detail_branchy_sequence_length, "detail/sequence_length/branchy", utf8, true,
+    measure_sequence_length( c, branchy_sequence_length ) );
+UTF8_BENCHMARK( detail_encode, "detail/encode", utf32, true,
+    measure_encode( c, d.out8, []( char32_t cp, char *result ) { return utf8::detail::encode( cp, result ); } ) );
+UTF8_BENCHMARK( detail_branchy_encode, "detail/encode/branchy", utf32, true,
+    measure_encode( c, d.out8, branchy_encode ) );
+
+UTF8_BENCHMARK( unchecked_next, "unchecked/next", utf8, true,
+    measure_unchecked_next( c ) );
+UTF8_BENCHMARK( unchecked_iterator, "unchecked/iterator", utf8, true,
+    measure_unchecked_iterate( c ) );
+UTF8_BENCHMARK( unchecked_distance, "unchecked/distance", utf8, true,
+    utf8::unchecked::distance( c.begin( ), c.end( ) ) );
+UTF8_BENCHMARK( unchecked_advance, "unchecked/advance", utf8, true,
+    measure_unchecked_advance( c, d.code_points ) );
+UTF8_BENCHMARK( unchecked_retreat, "unchecked/retreat", utf8, true,
+    measure_unchecked_retreat( c, d.code_points ) );
+UTF8_BENCHMARK( unchecked_utf8to16, "unchecked/utf8to16", utf8, true,
+    utf8::unchecked::utf8to16( c.begin( ), c.end( ), d.out16.begin( ) ) - d.out16.begin( ) );
+UTF8_BENCHMARK( unchecked_utf8to32, "unchecked/utf8to32", utf8, true,
+    utf8::unchecked::utf8to32( c.begin( ), c.end( ), d.out32.begin( ) ) - d.out32.begin( ) );
+UTF8_BENCHMARK( unchecked_utf16to8, "unchecked/utf16to8", utf16, true,
+    utf8::unchecked::utf16to8( c.begin( ), c.end( ), d.out8.begin( ) ) - d.out8.begin( ) );
+UTF8_BENCHMARK( unchecked_utf32to8, "unchecked/utf32to8", utf32, true,
+    utf8::unchecked::utf32to8( c.begin( ), c.end( ), d.out8.begin( ) ) - d.out8.begin( ) );
+UTF8_BENCHMARK( unchecked_utf16to32, "unchecked/utf16to32", utf16, true,
+    utf8::unchecked::utf16to32( c.begin( ), c.end( ), d.out32.begin( ) ) - d.out32.begin( ) );
+UTF8_BENCHMARK( unchecked_utf32to16, "unchecked/utf32to16", utf32, true,
+    utf8::unchecked::utf32to16( c.begin( ), c.end( ), d.out16.begin( ) ) - d.out16.begin( ) );
+
+struct result
+{
+    std::string benchmark;
+    std::string corpus;
+    std::string input;
+    std::size_t input_octets;
+    std::size_t code_points;
+    std::size_t iterations;
+    double seconds;
+
+    double octets_per_second( ) const
+    {
+        return input_octets * iterations / seconds;
+    }
+
+    double code_points_per_second( ) const
+    {
+        return code_points * iterations / seconds;
+    }
+};
+
+// prevents the compiler from discarding the results
+volatile std::size_t sink;
+
+// Runs f until min_time has elapsed, starting with a single iteration and
+// doubling the iterations per round.
+result measure( benchmark::function f, corpus_data &d, double min_time )
+{
+    typedef std::chrono::steady_clock clock;
+    result r = result( );
+    sink = f( d );
+    for (std::size_t iterations = 1; ; iterations *= 2)
+    {
+        const clock::time_point start = clock::now( );
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+            sink = sink + f( d );
+        }
+        const double seconds = std::chrono::duration<double>( clock::now( ) - start ).count( );
+        if (seconds >= min_time || iterations >= (std::size_t( 1 ) << 30))
+        {
+            r.iterations = iterations;
+            r.seconds = seconds;
+            return r;
+        }
+    }
+}
+
+std::size_t input_octets( const corpus_data &d, input_encoding input )
+{
+    switch (input)
+    {
+    case input_encoding::utf16:
+        return 2 * d.u16.size( );
+    case input_encoding::utf32:
+        return 4 * d.u32.size( );
+    case input_encoding::latin1:
+        return d.latin1.size( );
+    default:
+        return d.u8.size( );
+    }
+}
+
+void print_json( std::ostream &out, const std::vector<result> &results, std::size_t size )
+{
+    out << "{\n"
+        << "  \"library\": \"UTF8++\",\n"
+        << "  \"isa\": \"" << isa << "\",\n"
+        << "  \"dfa_decoder\": " << (dfa_decoder ? "true" : "false") << ",\n"
+        << "  \"corpus_size\": " << size << ",\n"
+        << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size( ); ++i)
+    {
+        const result &r = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    { \"benchmark\": \"" << r.benchmark << "\", \"corpus\": \"" << r.corpus
+            << "\", \"input\": \"" << r.input << "\", \"input_octets\": " << r.input_octets
+            << ", \"code_points\": " << r.code_points << ", \"iterations\": " << r.iterations
+            << ", \"seconds\": " << r.seconds << ", \"octets_per_second\": " << r.octets_per_second( )
+            << ", \"code_points_per_second\": " << r.code_points_per_second( ) << " }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int usage( )
+{
+    std::cerr << "usage: UTF8++_benchmarks [--size <octets>] [--min-time <seconds>]\n"
+                 "                         [--filter <substring>] [--json]\n";
+    return 2;
+}
+}
+
+int main( int argc, char **argv )
+{
+    std::size_t size = std::size_t( 1 ) << 20;
+    double min_time = 0.2;
+    std::string filter;
+    bool json = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--json")
+        {
+            json = true;
+        }
+        else if (i + 1 < argc && arg == "--size")
+        {
+            size = std::strtoull( argv[++i], nullptr, 10 );
+        }
+        else if (i + 1 < argc && arg == "--min-time")
+        {
+            min_time = std::strtod( argv[++i], nullptr );
+        }
+        else if (i + 1 < argc && arg == "--filter")
+        {
+            filter = argv[++i];
+        }
+        else
+        {
+            return usage( );
+        }
+    }
+
+    if (!json)
+    {
+        std::cout << "isa: " << isa << ", dfa decoder: " << (dfa_decoder ? "on" : "off")
+            << ", corpus size: " << size << " octets\n\n"
+            << std::left << std::setw( 30 ) << "benchmark" << std::setw( 14 ) << "corpus"
+            << std::setw( 12 ) << "input" << std::right << std::setw( 10 ) << "GB/s"
+            << std::setw( 14 ) << "Mcp/s" << '\n';
+    }
+
+    std::vector<result> results;
+    for (const corpus::description &desc : corpus::descriptions( ))
+    {
+        corpus_data d( desc, size );
+        for (const benchmark &b : registry( ))
+        {
+            if (b.requires_valid && !d.valid)
+            {
+                continue;
+            }
+            for (int generic = 0; generic < 2; ++generic)
+            {
+                const std::string input = generic ? "deque" : "contiguous";
+                const std::string full_name = std::string( b.name ) + " " + d.name + " " + input;
+                if (full_name.find( filter ) == std::string::npos)
+                {
+                    continue;
+                }
+
+                result r = measure( generic ? b.generic : b.contiguous, d, min_time );
+                r.benchmark = b.name;
+                r.corpus = d.name;
+                r.input = input;
+                r.input_octets = input_octets( d, b.input );
+                r.code_points = d.code_points;
+                results.push_back( r );
+
+                if (!json)
+                {
+                    std::cout << std::left << std::setw( 30 ) << r.benchmark << std::setw( 14 ) << r.corpus
+                        << std::setw( 12 ) << r.input << std::right << std::fixed << std::setprecision( 3 )
+                        << std::setw( 10 ) << r.octets_per_second( ) / 1e9
+                        << std::setw( 14 ) << std::setprecision( 1 ) << r.code_points_per_second( ) / 1e6 << std::endl;
+                }
+            }
+        }
+    }
+    if (json)
+    {
+        print_json( std::cout, results, size );
+    }
+    return 0;
+}
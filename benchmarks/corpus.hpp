@@ -0,0 +1,86 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <utf8.h>
+
+namespace corpus
+{
+// Describes a generated text: the code points are drawn from the ranges
+// according to their weights, words are separated by spaces, and invalid
+// octets are spliced in with the given probability per code point.
+struct description
+{
+    struct range
+    {
+        char32_t first;
+        char32_t last;
+        unsigned weight;
+    };
+
+    std::string name;
+    std::vector<range> ranges;
+    // the probability of an invalid octet in front of a code point
+    double invalid_density;
+};
+
+inline std::vector<description> descriptions( )
+{
+    const description::range ascii = { 0x61, 0x7A, 1 };
+    return {
+        { "ascii", { { 0x21, 0x7E, 1 } }, 0.0 },
+        { "latin1", { { 0x61, 0x7A, 6 }, { 0xC0, 0xFF, 1 } }, 0.0 },
+        { "cyrillic", { { 0x430, 0x44F, 1 } }, 0.0 },
+        { "cjk", { { 0x4E00, 0x9FFF, 1 } }, 0.0 },
+        { "emoji", { { 0x1F300, 0x1F64F, 1 } }, 0.0 },
+        { "mixed", { { 0x61, 0x7A, 4 }, { 0x430, 0x44F, 2 }, { 0x4E00, 0x9FFF, 2 }, { 0x1F300, 0x1F64F, 1 } }, 0.0 },
+        { "invalid_0.1%", { ascii, { 0x430, 0x44F, 1 }, { 0x4E00, 0x9FFF, 1 } }, 0.001 },
+        { "invalid_1%", { ascii, { 0x430, 0x44F, 1 }, { 0x4E00, 0x9FFF, 1 } }, 0.01 },
+        { "invalid_10%", { ascii, { 0x430, 0x44F, 1 }, { 0x4E00, 0x9FFF, 1 } }, 0.1 },
+    };
+}
+
+// Generates about size octets of text, the result is the same on every run.
+inline std::string generate( const description &desc, std::size_t size )
+{
+    static const char *const invalid_octets[] = {
+        "\x80", "\xBF", "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xFE", "\xE6\x97",
+    };
+
+    std::mt19937 rng( 0x55AA );
+    std::vector<double> weights;
+    for (const description::range &r : desc.ranges)
+    {
+        weights.push_back( r.weight );
+    }
+    std::discrete_distribution<std::size_t> pick_range( weights.begin( ), weights.end( ) );
+    std::uniform_int_distribution<unsigned> word_length( 1, 10 );
+    std::bernoulli_distribution invalid( desc.invalid_density );
+
+    std::string text;
+    text.reserve( size + 64 );
+    while (text.size( ) < size)
+    {
+        for (unsigned n = word_length( rng ); n != 0; --n)
+        {
+            if (invalid( rng ))
+            {
+                text += invalid_octets[rng( ) % (sizeof( invalid_octets ) / sizeof( *invalid_octets ))];
+            }
+            const description::range &r = desc.ranges[pick_range( rng )];
+            utf8::unchecked::append( r.first + rng( ) % (r.last - r.first + 1), std::back_inserter( text ) );
+        }
+        text += ' ';
+    }
+    return text;
+}
+}
@@ -9,5 +9,10 @@
 
 #include "utf8/checked.h"
 #include "utf8/unchecked.h"
+#include "utf8/stream.h"
+#include "utf8/offset_index.h"
+#include "utf8/convert.h"
+#include "utf8/literal.h"
+#include "utf8/chunk.h"
 
 #endif // header guard
@@ -6,77 +6,1082 @@
 ////////////////////////////////////////////////////////////////////////////////
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
 #include "core.h"
 
-namespace utf8
+namespace utf8
+{
+namespace detail
+{
+// The number of octets validated at once before they are transcoded, small
+// enough for the chunk to stay in the L1 cache.
+const std::ptrdiff_t transcode_chunk_size = 4096;
+
+template< typename octet_iterator >
+inline octet_iterator encode_checked( char32_t cp, octet_iterator result )
+{
+    if (!is_code_point_valid( cp ))
+    {
+        throw invalid_code_point( cp );
+    }
+    return encode( cp, result );
+}
+
+// The non-throwing conversions stop in front of the first invalid sequence
+// and report it along with the positions reached.
+
+template< typename unit_iterator, typename unit_size, typename octet_iterator >
+conversion_result<octet_iterator, unit_iterator> try_utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size, std::false_type )
+{
+    char32_t cp;
+    while (start != end)
+    {
+        const error_code error = try_decode( start, end, cp );
+        if (error != error_code::ok)
+        {
+            return { error, start, result };
+        }
+        result = encode_units( cp, result, unit_size( ) );
+    }
+    return { error_code::ok, start, result };
+}
+
+// Validates the input chunk by chunk and transcodes the valid parts without
+// any further checks. The blocks rejected by the validator are decoded one
+// sequence after another in order to locate the error.
+template< typename unit_iterator, typename unit_size >
+conversion_result<const uint8_t *, unit_iterator> try_utf8_decode( const uint8_t *it, const uint8_t *end, unit_iterator result, unit_size )
+{
+    char32_t cp;
+    while (it != end)
+    {
+        const uint8_t *const chunk_end = end - it > transcode_chunk_size ? it + transcode_chunk_size : end;
+        const uint8_t *const valid = simd::valid_prefix( it, chunk_end );
+        if (valid != it)
+        {
+            result = utf8_decode_valid( it, valid, result, unit_size( ) );
+            it = valid;
+            continue;
+        }
+
+        const uint8_t *const stop = end - it > simd::block_size ? it + simd::block_size : end;
+        while (it < stop)
+        {
+            const error_code error = try_decode( it, end, cp );
+            if (error != error_code::ok)
+            {
+                return { error, it, result };
+            }
+            result = encode_units( cp, result, unit_size( ) );
+        }
+    }
+    return { error_code::ok, it, result };
+}
+
+// decodes to UTF-16 or UTF-32 depending on unit_size
+template< typename unit_iterator, typename unit_size, typename octet_iterator >
+conversion_result<octet_iterator, unit_iterator> try_utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size, std::true_type )
+{
+    if (start == end)
+    {
+        return { error_code::ok, start, result };
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    const conversion_result<const uint8_t *, unit_iterator> r = try_utf8_decode( first, first + (end - start), result, unit_size( ) );
+    return { r.error, start + (r.in - first), r.out };
+}
+
+template< typename u16bit_iterator, typename octet_iterator >
+conversion_result<u16bit_iterator, octet_iterator> try_utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result, std::false_type )
+{
+    char32_t cp;
+    while (start != end)
+    {
+        if (try_decode_utf16( start, end, cp ) != error_code::ok)
+        {
+            return { error_code::invalid_utf16, start, result };
+        }
+        result = encode( cp, result );
+    }
+    return { error_code::ok, start, result };
+}
+
+// Same scheme as try_utf8_decode, the validation only needs to pair
+// surrogates.
+template< typename u16_type, typename octet_iterator >
+conversion_result<const u16_type *, octet_iterator> try_utf16to8( const u16_type *it, const u16_type *end, octet_iterator result )
+{
+    char32_t cp;
+    while (it != end)
+    {
+        const u16_type *const chunk_end = end - it > transcode_chunk_size ? it + transcode_chunk_size : end;
+        const u16_type *const valid = simd::valid_utf16_prefix( it, chunk_end );
+        if (valid != it)
+        {
+            result = utf16to8_valid( it, valid, result );
+            it = valid;
+            continue;
+        }
+
+        // the first code point is either invalid or the chunk is too short
+        if (try_decode_utf16( it, end, cp ) != error_code::ok)
+        {
+            return { error_code::invalid_utf16, it, result };
+        }
+        result = encode( cp, result );
+    }
+    return { error_code::ok, it, result };
+}
+
+template< typename u16bit_iterator, typename octet_iterator >
+conversion_result<u16bit_iterator, octet_iterator> try_utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return { error_code::ok, start, result };
+    }
+    typedef typename std::iterator_traits<u16bit_iterator>::value_type u16_type;
+    const u16_type *const first = to_pointer<const u16_type>( start );
+    const conversion_result<const u16_type *, octet_iterator> r = try_utf16to8( first, first + (end - start), result );
+    return { r.error, start + (r.in - first), r.out };
+}
+
+template< typename u32bit_iterator, typename octet_iterator >
+conversion_result<u32bit_iterator, octet_iterator> try_utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result, std::false_type )
+{
+    for (; start != end; ++start)
+    {
+        const char32_t cp = static_cast<char32_t>(*start);
+        if (!is_code_point_valid( cp ))
+        {
+            return { error_code::invalid_code_point, start, result };
+        }
+        result = encode( cp, result );
+    }
+    return { error_code::ok, start, result };
+}
+
+// Same scheme as try_utf8_decode, the validation only needs to check ranges.
+template< typename u32_type, typename octet_iterator >
+conversion_result<const u32_type *, octet_iterator> try_utf32to8( const u32_type *it, const u32_type *end, octet_iterator result )
+{
+    while (it != end)
+    {
+        const u32_type *const chunk_end = end - it > transcode_chunk_size ? it + transcode_chunk_size : end;
+        const u32_type *const valid = simd::valid_utf32_prefix( it, chunk_end );
+        if (valid == it)
+        {
+            return { error_code::invalid_code_point, it, result };
+        }
+        result = utf32to8_valid( it, valid, result );
+        it = valid;
+    }
+    return { error_code::ok, it, result };
+}
+
+template< typename u32bit_iterator, typename octet_iterator >
+conversion_result<u32bit_iterator, octet_iterator> try_utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return { error_code::ok, start, result };
+    }
+    typedef typename std::iterator_traits<u32bit_iterator>::value_type u32_type;
+    const u32_type *const first = to_pointer<const u32_type>( start );
+    const conversion_result<const u32_type *, octet_iterator> r = try_utf32to8( first, first + (end - start), result );
+    return { r.error, start + (r.in - first), r.out };
+}
+
+template< typename u16bit_iterator, typename u32bit_iterator >
+conversion_result<u16bit_iterator, u32bit_iterator> try_utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result, std::false_type )
+{
+    char32_t cp;
+    while (start != end)
+    {
+        if (try_decode_utf16( start, end, cp ) != error_code::ok)
+        {
+            return { error_code::invalid_utf16, start, result };
+        }
+        *result++ = cp;
+    }
+    return { error_code::ok, start, result };
+}
+
+// Same scheme as try_utf16to8.
+template< typename u16_type, typename u32bit_iterator >
+conversion_result<const u16_type *, u32bit_iterator> try_utf16to32( const u16_type *it, const u16_type *end, u32bit_iterator result )
+{
+    char32_t cp;
+    while (it != end)
+    {
+        const u16_type *const chunk_end = end - it > transcode_chunk_size ? it + transcode_chunk_size : end;
+        const u16_type *const valid = simd::valid_utf16_prefix( it, chunk_end );
+        if (valid != it)
+        {
+            result = utf16to32_valid( it, valid, result );
+            it = valid;
+            continue;
+        }
+
+        // the first code point is either invalid or the chunk is too short
+        if (try_decode_utf16( it, end, cp ) != error_code::ok)
+        {
+            return { error_code::invalid_utf16, it, result };
+        }
+        *result++ = cp;
+    }
+    return { error_code::ok, it, result };
+}
+
+template< typename u16bit_iterator, typename u32bit_iterator >
+conversion_result<u16bit_iterator, u32bit_iterator> try_utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return { error_code::ok, start, result };
+    }
+    typedef typename std::iterator_traits<u16bit_iterator>::value_type u16_type;
+    const u16_type *const first = to_pointer<const u16_type>( start );
+    const conversion_result<const u16_type *, u32bit_iterator> r = try_utf16to32( first, first + (end - start), result );
+    return { r.error, start + (r.in - first), r.out };
+}
+
+template< typename u32bit_iterator, typename u16bit_iterator >
+conversion_result<u32bit_iterator, u16bit_iterator> try_utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result, std::false_type )
+{
+    for (; start != end; ++start)
+    {
+        const char32_t cp = static_cast<char32_t>(*start);
+        if (!is_code_point_valid( cp ))
+        {
+            return { error_code::invalid_code_point, start, result };
+        }
+        result = encode_utf16( cp, result );
+    }
+    return { error_code::ok, start, result };
+}
+
+// Same scheme as try_utf32to8.
+template< typename u32_type, typename u16bit_iterator >
+conversion_result<const u32_type *, u16bit_iterator> try_utf32to16( const u32_type *it, const u32_type *end, u16bit_iterator result )
+{
+    while (it != end)
+    {
+        const u32_type *const chunk_end = end - it > transcode_chunk_size ? it + transcode_chunk_size : end;
+        const u32_type *const valid = simd::valid_utf32_prefix( it, chunk_end );
+        if (valid == it)
+        {
+            return { error_code::invalid_code_point, it, result };
+        }
+        result = utf32to16_valid( it, valid, result );
+        it = valid;
+    }
+    return { error_code::ok, it, result };
+}
+
+template< typename u32bit_iterator, typename u16bit_iterator >
+conversion_result<u32bit_iterator, u16bit_iterator> try_utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return { error_code::ok, start, result };
+    }
+    typedef typename std::iterator_traits<u32bit_iterator>::value_type u32_type;
+    const u32_type *const first = to_pointer<const u32_type>( start );
+    const conversion_result<const u32_type *, u16bit_iterator> r = try_utf32to16( first, first + (end - start), result );
+    return { r.error, start + (r.in - first), r.out };
+}
+
+template< typename octet_iterator, typename latin1_iterator >
+conversion_result<octet_iterator, latin1_iterator> try_utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result, std::false_type )
+{
+    char32_t cp;
+    while (start != end)
+    {
+        const octet_iterator sequence = start;
+        const error_code error = try_decode( start, end, cp );
+        if (error != error_code::ok)
+        {
+            return { error, start, result };
+        }
+        if (cp > 0xFF)
+        {
+            return { error_code::invalid_code_point, sequence, result };
+        }
+        *result++ = static_cast<uint8_t>(cp);
+    }
+    return { error_code::ok, start, result };
+}
+
+// Same scheme as try_utf8_decode, the valid parts are transcoded up to the
+// first code point above U+00FF.
+template< typename latin1_iterator >
+conversion_result<const uint8_t *, latin1_iterator> try_utf8tolatin1( const uint8_t *it, const uint8_t *end, latin1_iterator result )
+{
+    char32_t cp;
+    while (it != end)
+    {
+        const uint8_t *const chunk_end = end - it > transcode_chunk_size ? it + transcode_chunk_size : end;
+        const uint8_t *const valid = simd::valid_prefix( it, chunk_end );
+        if (valid != it)
+        {
+            result = utf8tolatin1_valid( it, valid, result );
+            if (it != valid)
+            {
+                return { error_code::invalid_code_point, it, result };
+            }
+            continue;
+        }
+
+        const uint8_t *const stop = end - it > simd::block_size ? it + simd::block_size : end;
+        while (it < stop)
+        {
+            const uint8_t *const sequence = it;
+            const error_code error = try_decode( it, end, cp );
+            if (error != error_code::ok)
+            {
+                return { error, it, result };
+            }
+            if (cp > 0xFF)
+            {
+                return { error_code::invalid_code_point, sequence, result };
+            }
+            *result++ = static_cast<uint8_t>(cp);
+        }
+    }
+    return { error_code::ok, it, result };
+}
+
+template< typename octet_iterator, typename latin1_iterator >
+conversion_result<octet_iterator, latin1_iterator> try_utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return { error_code::ok, start, result };
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    const conversion_result<const uint8_t *, latin1_iterator> r = try_utf8tolatin1( first, first + (end - start), result );
+    return { r.error, start + (r.in - first), r.out };
+}
+
+// The throwing conversions work like the non-throwing ones for contiguous
+// input and decode the offending sequence again in order to throw the
+// matching exception. Other input is decoded one sequence after another.
+
+template< typename unit_iterator, typename unit_size, typename octet_iterator >
+unit_iterator utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size, std::false_type )
+{
+    while (start != end)
+    {
+        result = encode_units( decode<err_handler::exc>( start, end ), result, unit_size( ) );
+    }
+    return result;
+}
+
+template< typename unit_iterator, typename unit_size, typename octet_iterator >
+unit_iterator utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size, std::true_type )
+{
+    conversion_result<octet_iterator, unit_iterator> r = try_utf8_decode( start, end, result, unit_size( ), std::true_type( ) );
+    if (!r)
+    {
+        decode<err_handler::exc>( r.in, end );
+    }
+    return r.out;
+}
+
+template< typename u16bit_iterator, typename octet_iterator >
+octet_iterator utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result, std::false_type )
+{
+    while (start != end)
+    {
+        result = encode( decode_utf16<err_handler::exc>( start, end ), result );
+    }
+    return result;
+}
+
+template< typename u16bit_iterator, typename octet_iterator >
+octet_iterator utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result, std::true_type )
+{
+    conversion_result<u16bit_iterator, octet_iterator> r = try_utf16to8( start, end, result, std::true_type( ) );
+    if (!r)
+    {
+        decode_utf16<err_handler::exc>( r.in, end );
+    }
+    return r.out;
+}
+
+template< typename u32bit_iterator, typename octet_iterator >
+octet_iterator utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result, std::false_type )
+{
+    while (start != end)
+    {
+        result = encode_checked( *start++, result );
+    }
+    return result;
+}
+
+template< typename u32bit_iterator, typename octet_iterator >
+octet_iterator utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result, std::true_type )
+{
+    const conversion_result<u32bit_iterator, octet_iterator> r = try_utf32to8( start, end, result, std::true_type( ) );
+    if (!r)
+    {
+        encode_checked( *r.in, r.out );
+    }
+    return r.out;
+}
+
+template< typename u16bit_iterator, typename u32bit_iterator >
+u32bit_iterator utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result, std::false_type )
+{
+    while (start != end)
+    {
+        *result++ = decode_utf16<err_handler::exc>( start, end );
+    }
+    return result;
+}
+
+template< typename u16bit_iterator, typename u32bit_iterator >
+u32bit_iterator utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result, std::true_type )
+{
+    conversion_result<u16bit_iterator, u32bit_iterator> r = try_utf16to32( start, end, result, std::true_type( ) );
+    if (!r)
+    {
+        decode_utf16<err_handler::exc>( r.in, end );
+    }
+    return r.out;
+}
+
+template< typename u32bit_iterator, typename u16bit_iterator >
+u16bit_iterator utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result, std::false_type )
+{
+    for (; start != end; ++start)
+    {
+        const char32_t cp = static_cast<char32_t>(*start);
+        if (!is_code_point_valid( cp ))
+        {
+            throw invalid_code_point( cp );
+        }
+        result = encode_utf16( cp, result );
+    }
+    return result;
+}
+
+template< typename u32bit_iterator, typename u16bit_iterator >
+u16bit_iterator utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result, std::true_type )
+{
+    const conversion_result<u32bit_iterator, u16bit_iterator> r = try_utf32to16( start, end, result, std::true_type( ) );
+    if (!r)
+    {
+        throw invalid_code_point( static_cast<char32_t>(*r.in) );
+    }
+    return r.out;
+}
+
+template< typename octet_iterator, typename latin1_iterator >
+latin1_iterator utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result, std::false_type )
+{
+    while (start != end)
+    {
+        const char32_t cp = decode<err_handler::exc>( start, end );
+        if (cp > 0xFF)
+        {
+            throw invalid_code_point( cp );
+        }
+        *result++ = static_cast<uint8_t>(cp);
+    }
+    return result;
+}
+
+template< typename octet_iterator, typename latin1_iterator >
+latin1_iterator utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result, std::true_type )
+{
+    conversion_result<octet_iterator, latin1_iterator> r = try_utf8tolatin1( start, end, result, std::true_type( ) );
+    if (!r)
+    {
+        // throws for invalid UTF-8, too
+        throw invalid_code_point( decode<err_handler::exc>( r.in, end ) );
+    }
+    return r.out;
+}
+
+template< typename octet_iterator >
+typename std::iterator_traits<octet_iterator>::difference_type distance( octet_iterator first, octet_iterator last, std::false_type )
+{
+    typename std::iterator_traits<octet_iterator>::difference_type dist;
+    for (dist = 0; first < last; ++dist)
+        decode<err_handler::exc>( first, last );
+    return dist;
+}
+
+// Validates and counts one chunk after another while it is in the cache,
+// the rejected blocks are counted by the throwing decoder.
+inline std::size_t distance( const uint8_t *it, const uint8_t *end )
+{
+    std::size_t dist = 0;
+    while (it != end)
+    {
+        const uint8_t *const chunk_end = end - it > transcode_chunk_size ? it + transcode_chunk_size : end;
+        const uint8_t *const valid = simd::valid_prefix( it, chunk_end );
+        if (valid != it)
+        {
+            dist += simd::count_utf8<false>( it, valid );
+            it = valid;
+            continue;
+        }
+
+        const uint8_t *const stop = end - it > simd::block_size ? it + simd::block_size : end;
+        for (; it < stop; ++dist)
+        {
+            decode<err_handler::exc>( it, end );
+        }
+    }
+    return dist;
+}
+
+template< typename octet_iterator >
+typename std::iterator_traits<octet_iterator>::difference_type distance( octet_iterator first, octet_iterator last, std::true_type )
+{
+    if (!(first < last))
+    {
+        return 0;
+    }
+    const uint8_t *const begin = to_pointer<const uint8_t>( first );
+    typedef typename std::iterator_traits<octet_iterator>::difference_type diff_t;
+    return static_cast<diff_t>(distance( begin, begin + (last - first) ));
+}
+
+template< typename octet_iterator, typename distance_type >
+void advance( octet_iterator &it, distance_type n, octet_iterator end, std::false_type )
+{
+    for (distance_type i = 0; i < n; ++i)
+        decode<err_handler::exc>( it, end );
+}
+
+// Skips up to n code points of the valid UTF-8 [it, end) and decrements n by
+// the number of skipped ones. Every code point takes at least one octet, so
+// the next n - 1 octets lie in front of the target and it suffices to count
+// their leads.
+inline const uint8_t *skip_valid( const uint8_t *it, const uint8_t *end, std::size_t &n ) noexcept
+{
+    while (n > 64 && end - it > 64)
+    {
+        const std::size_t length = n - 1 < static_cast<std::size_t>(end - it) ? n - 1 : static_cast<std::size_t>(end - it);
+        n -= simd::count_utf8<false>( it, it + length );
+        it += length;
+    }
+    // it may point into a sequence whose lead has been counted already
+    while (it != end && is_trail( *it ))
+    {
+        ++it;
+    }
+    for (; n > 0 && it != end; --n)
+    {
+        it += sequence_length<std::ptrdiff_t>( *it );
+    }
+    return it;
+}
+
+// Skips the validated parts of each chunk, the blocks rejected by the
+// validator are decoded by the throwing decoder.
+inline void advance( const uint8_t *&it, const uint8_t *end, std::size_t n )
+{
+    while (n > 0)
+    {
+        const uint8_t *const chunk_end = end - it > transcode_chunk_size ? it + transcode_chunk_size : end;
+        const uint8_t *const valid = simd::valid_prefix( it, chunk_end );
+        if (valid != it)
+        {
+            it = skip_valid( it, valid, n );
+            continue;
+        }
+
+        const uint8_t *const stop = end - it > simd::block_size ? it + simd::block_size : end;
+        do
+        {
+            decode<err_handler::exc>( it, end );
+        } while (--n > 0 && it < stop);
+    }
+}
+
+template< typename octet_iterator, typename distance_type >
+void advance( octet_iterator &it, distance_type n, octet_iterator end, std::true_type )
+{
+    if (!(n > 0 && it < end))
+    {
+        // nothing to do or not_enough_room
+        advance( it, n, end, std::false_type( ) );
+        return;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( it );
+    const uint8_t *pos = first;
+    try
+    {
+        advance( pos, first + (end - it), static_cast<std::size_t>(n) );
+    }
+    catch (const exception &)
+    {
+        it += pos - first;
+        throw;
+    }
+    it += pos - first;
+}
+
+// Copies the sequence at begin to out if it is valid, writes the replacement
+// otherwise. Advances begin behind the sequence in both cases.
+template< typename octet_iterator, typename output_iterator >
+inline output_iterator replace_next( octet_iterator &begin, octet_iterator end, output_iterator out, char32_t replacement )
+{
+    if (static_cast<uint8_t>(*begin) < 0x80)
+    {
+        *out++ = *begin;
+        ++begin;
+        return out;
+    }
+    octet_iterator tmp;
+#if defined(UTF8_DFA_DECODER)
+    // the DFA only accepts, the replacement is determined below
+    char32_t dfa_cp;
+    tmp = begin;
+    if (dfa::decode( tmp, end, dfa_cp ))
+    {
+        do
+        {
+            *out++ = *begin;
+        } while (++begin != tmp);
+        return out;
+    }
+#endif
+    // Determine the sequence length based on the lead octet
+    typedef typename std::iterator_traits<octet_iterator>::difference_type diff_t;
+    if (const diff_t length = sequence_length<diff_t>( *begin ) )
+    {
+        tmp = begin;
+        char32_t cp = ERROR_CHAR;
+        switch (length)
+        {
+        case 1:
+            cp = get_sequence<1, err_handler::icp>( begin, end );
+            break;
+        case 2:
+            cp = get_sequence<2, err_handler::icp>( begin, end );
+            break;
+        case 3:
+            cp = get_sequence<3, err_handler::icp>( begin, end );
+            break;
+        case 4:
+            cp = get_sequence<4, err_handler::icp>( begin, end );
+            break;
+        }
+        if (is_code_point_valid( cp ) && length == encoded_utf8_size<diff_t>( cp ))
+        {
+            do
+            {
+                *out++ = *tmp;
+            } while (++tmp != begin);
+            return out;
+        }
+    }
+    else
+    {
+        ++begin;
+    }
+    return encode( replacement, out );
+}
+
+template< typename octet_iterator, typename output_iterator >
+output_iterator replace_invalid( octet_iterator begin, octet_iterator end, output_iterator out, char32_t replacement, std::false_type )
+{
+    while (begin != end)
+    {
+        out = replace_next( begin, end, out, replacement );
+    }
+    return out;
+}
+
+// copies the valid octets [it, end) in one go
+template< typename output_iterator >
+output_iterator copy_valid( const uint8_t *it, const uint8_t *end, output_iterator out, std::true_type )
+{
+    typedef typename std::iterator_traits<output_iterator>::value_type octet_type;
+    std::memcpy( to_pointer<octet_type>( out ), it, static_cast<std::size_t>(end - it) );
+    return out + (end - it);
+}
+
+template< typename output_iterator >
+output_iterator copy_valid( const uint8_t *it, const uint8_t *end, output_iterator out, std::false_type )
+{
+    return std::copy( it, end, out );
+}
+
+// The valid runs between the invalid sequences are located by the vectorized
+// validator and copied as a whole, only the invalid sequences are replaced by
+// the loop above.
+template< typename octet_iterator, typename output_iterator >
+output_iterator replace_invalid( octet_iterator begin, octet_iterator end, output_iterator out, char32_t replacement, std::true_type )
+{
+    if (begin == end)
+    {
+        return out;
+    }
+    const uint8_t *it = to_pointer<const uint8_t>( begin );
+    const uint8_t *const stop = it + (end - begin);
+    for (;;)
+    {
+        const uint8_t *const invalid = find_invalid( it, stop );
+        if (invalid != it)
+        {
+            out = copy_valid( it, invalid, out, is_contiguous<output_iterator, 1>( ) );
+        }
+        if (invalid == stop)
+        {
+            return out;
+        }
+        it = invalid;
+        out = replace_next( it, stop, out, replacement );
+        if (it == stop)
+        {
+            return out;
+        }
+    }
+}
+
+// The error policies select the overloads below by tag dispatch.
+template< error_policy policy >
+using policy_tag = std::integral_constant<error_policy, policy>;
+
+// Advances it behind the next valid or invalid sequence, returns whether it
+// was valid.
+template< typename octet_iterator >
+inline bool next_sequence( octet_iterator &it, octet_iterator end, char32_t &cp )
+{
+    if (try_decode( it, end, cp ) == error_code::ok)
+    {
+        return true;
+    }
+    skip_invalid( it, end );
+    return false;
+}
+
+// Moves it to the start of the sequence in front of it, which next_sequence
+// would have stopped at. Each lead starts a sequence and a continuation
+// belongs to the closest lead in front of it or forms an invalid sequence of
+// its own. Returns whether the sequence is valid and stores its code point
+// in cp if it is.
+template< typename octet_iterator >
+bool previous_sequence( octet_iterator &it, octet_iterator start, char32_t &cp )
+{
+    const octet_iterator end = it;
+    octet_iterator lead = it;
+    for (int i = 0; i < 4 && lead != start; ++i)
+    {
+        if (!is_trail( *--lead ))
+        {
+            octet_iterator tmp = lead;
+            const bool valid = next_sequence( tmp, end, cp );
+            if (tmp == end)
+            {
+                it = lead;
+                return valid;
+            }
+            break;
+        }
+    }
+    --it;
+    return false;
+}
+
+// Steps back over at most three continuations to the lead in front of it
+// and decodes the sequence, it is only modified if the sequence is valid and
+// ends at it.
+template< typename octet_iterator >
+char32_t decode_previous( octet_iterator &it, octet_iterator start )
+{
+    if (it == start)
+    {
+        throw not_enough_room( );
+    }
+    octet_iterator lead = it;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (!is_trail( *--lead ))
+        {
+            octet_iterator tmp = lead;
+            const char32_t cp = decode<err_handler::exc>( tmp, it );
+            if (tmp != it)
+            {
+                // a stray continuation
+                throw invalid_utf8( static_cast<uint8_t>(*tmp) );
+            }
+            it = lead;
+            return cp;
+        }
+        if (lead == start)
+        {
+            break;
+        }
+    }
+    // error - no lead octet in the sequence
+    throw invalid_utf8( static_cast<uint8_t>(*lead) );
+}
+
+template< typename octet_iterator, typename distance_type >
+void retreat( octet_iterator &it, distance_type n, octet_iterator start, std::false_type )
+{
+    for (distance_type i = 0; i < n; ++i)
+        decode_previous( it, start );
+}
+
+// Steps back by counting the leads and validates the skipped octets
+// afterwards. Invalid input is rare, so it is handed to the code point wise
+// loop which throws at the same position.
+template< typename octet_iterator, typename distance_type >
+void retreat( octet_iterator &it, distance_type n, octet_iterator start, std::true_type )
+{
+    if (!(n > 0 && start < it))
+    {
+        retreat( it, n, start, std::false_type( ) );
+        return;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    const uint8_t *const last = first + (it - start);
+    std::size_t count = static_cast<std::size_t>(n);
+    const uint8_t *const pos = retreat_valid( last, first, count );
+    if (find_invalid( pos, last ) != last)
+    {
+        retreat( it, n, start, std::false_type( ) );
+        return;
+    }
+    it -= last - pos;
+    if (count > 0)
+    {
+        throw not_enough_room( );
+    }
+}
+
+template< typename octet_iterator >
+char32_t next( octet_iterator &it, octet_iterator end, policy_tag<error_policy::throw_exception> )
 {
-/// The library API - functions intended to be called by the users
-inline namespace checked
+    return decode<err_handler::exc>( it, end );
+}
+
+template< typename octet_iterator >
+char32_t next( octet_iterator &it, octet_iterator end, policy_tag<error_policy::replace> )
 {
+    char32_t cp;
+    if (it == end)
+    {
+        return no_code_point;
+    }
+    return next_sequence( it, end, cp ) ? cp : replacement_char;
+}
+
 template< typename octet_iterator >
-inline octet_iterator append( char32_t cp, octet_iterator result )
+char32_t next( octet_iterator &it, octet_iterator end, policy_tag<error_policy::stop> )
 {
-    using namespace utf8::detail;
-    if (!is_code_point_valid( cp ))
+    char32_t cp;
+    return try_decode( it, end, cp ) == error_code::ok ? cp : no_code_point;
+}
+
+template< typename octet_iterator >
+char32_t next( octet_iterator &it, octet_iterator end, policy_tag<error_policy::skip> )
+{
+    char32_t cp;
+    while (it != end)
     {
-        throw invalid_code_point( cp );
+        if (next_sequence( it, end, cp ))
+        {
+            return cp;
+        }
     }
-    return encode( cp, result );
+    return no_code_point;
 }
 
-template< typename octet_iterator, typename output_iterator >
-output_iterator replace_invalid( octet_iterator begin, octet_iterator end, output_iterator out, char32_t replacement = 0xFFFD )
+// The conversions with an error policy. The replace and skip policies resume
+// the non-throwing conversion behind every invalid sequence, so the valid
+// runs in between still take the vectorized path. They report the first
+// error they came across.
+
+template< typename unit_iterator, typename unit_size, typename octet_iterator >
+conversion_result<octet_iterator, unit_iterator> utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size,
+    policy_tag<error_policy::throw_exception> )
 {
-    using namespace utf8::detail;
-    typedef octet_iterator iterator_t;
+    return { error_code::ok, end,
+        utf8_decode( start, end, result, unit_size( ), is_contiguous<octet_iterator, 1>( ) ) };
+}
 
-    if (begin > end)
+template< typename unit_iterator, typename unit_size, typename octet_iterator >
+conversion_result<octet_iterator, unit_iterator> utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size,
+    policy_tag<error_policy::stop> )
+{
+    return try_utf8_decode( start, end, result, unit_size( ), is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename unit_iterator, typename unit_size, typename octet_iterator, error_policy policy >
+conversion_result<octet_iterator, unit_iterator> utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size,
+    policy_tag<policy> )
+{
+    static_assert(policy == error_policy::replace || policy == error_policy::skip, "unhandled error policy");
+    conversion_result<octet_iterator, unit_iterator> r =
+        try_utf8_decode( start, end, result, unit_size( ), is_contiguous<octet_iterator, 1>( ) );
+    const error_code error = r.error;
+    while (r.error != error_code::ok)
     {
-        //TODO: should be an argument exception
-        throw not_enough_room( );
+        skip_invalid( r.in, end );
+        if (policy == error_policy::replace)
+        {
+            r.out = encode_units( replacement_char, r.out, unit_size( ) );
+        }
+        r = try_utf8_decode( r.in, end, r.out, unit_size( ), is_contiguous<octet_iterator, 1>( ) );
     }
+    r.error = error;
+    return r;
+}
 
-    iterator_t tmp;
+template< typename u16bit_iterator, typename octet_iterator >
+conversion_result<u16bit_iterator, octet_iterator> utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result,
+    policy_tag<error_policy::throw_exception> )
+{
+    return { error_code::ok, end, utf16to8( start, end, result, is_contiguous<u16bit_iterator, 2>( ) ) };
+}
 
-    while (begin != end)
+template< typename u16bit_iterator, typename octet_iterator >
+conversion_result<u16bit_iterator, octet_iterator> utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result,
+    policy_tag<error_policy::stop> )
+{
+    return try_utf16to8( start, end, result, is_contiguous<u16bit_iterator, 2>( ) );
+}
+
+// an unpaired surrogate is replaced or skipped on its own
+template< typename u16bit_iterator, typename octet_iterator, error_policy policy >
+conversion_result<u16bit_iterator, octet_iterator> utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result,
+    policy_tag<policy> )
+{
+    static_assert(policy == error_policy::replace || policy == error_policy::skip, "unhandled error policy");
+    conversion_result<u16bit_iterator, octet_iterator> r =
+        try_utf16to8( start, end, result, is_contiguous<u16bit_iterator, 2>( ) );
+    const error_code error = r.error;
+    while (r.error != error_code::ok)
     {
-        // Determine the sequence length based on the lead octet
-        typedef typename std::iterator_traits<octet_iterator>::difference_type diff_t;
-        if (const diff_t length = sequence_length<diff_t>( *begin ) )
+        ++r.in;
+        if (policy == error_policy::replace)
         {
-            tmp = begin;
-            char32_t cp = ERROR_CHAR;
-            switch (length)
-            {
-            case 1:
-                cp = get_sequence<1, err_handler::icp>( begin, end );
-                break;
-            case 2:
-                cp = get_sequence<2, err_handler::icp>( begin, end );
-                break;
-            case 3:
-                cp = get_sequence<3, err_handler::icp>( begin, end );
-                break;
-            case 4:
-                cp = get_sequence<4, err_handler::icp>( begin, end );
-                break;
-            }
-            if (is_code_point_valid( cp ) && length == encoded_utf8_size<diff_t>( cp ))
-            {
-                do
-                {
-                    *out++ = *tmp;
-                } while (++tmp != begin);
-                continue;
-            }
+            r.out = encode( replacement_char, r.out );
         }
-        else
+        r = try_utf16to8( r.in, end, r.out, is_contiguous<u16bit_iterator, 2>( ) );
+    }
+    r.error = error;
+    return r;
+}
+// The octet wise search only reports matches which start a sequence. The
+// needles of the code point searches start with a lead anyway.
+template< typename octet_iterator >
+octet_iterator find_octets( octet_iterator it, octet_iterator end, const uint8_t *needle, std::size_t size, std::false_type )
+{
+    typedef typename std::iterator_traits<octet_iterator>::value_type octet_type;
+    const auto equal = []( octet_type l, uint8_t r )
+    {
+        return static_cast<uint8_t>(l) == r;
+    };
+    for (; ; ++it)
+    {
+        it = std::search( it, end, needle, needle + size, equal );
+        if (it == end || size == 0 || !is_trail( *it ))
         {
-            ++begin;
+            return it;
         }
-        out = encode( replacement, out );
     }
-    return out;
+}
+
+struct starts_sequence
+{
+    bool operator ()( const uint8_t *match ) const noexcept
+    {
+        return !is_trail( *match );
+    }
+};
+
+template< typename octet_iterator >
+octet_iterator find_octets( octet_iterator it, octet_iterator end, const uint8_t *needle, std::size_t size, std::true_type )
+{
+    if (!(it < end) || size == 0)
+    {
+        return it;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( it );
+    const uint8_t *const last = first + (end - it);
+    return it + (simd::search_octets( first, last, needle, size, starts_sequence( ) ) - first);
+}
+
+template< typename octet_iterator, typename needle_iterator >
+octet_iterator find( octet_iterator start, octet_iterator end, needle_iterator needle_start, needle_iterator needle_end, std::false_type )
+{
+    std::vector<uint8_t> needle;
+    for (; needle_start != needle_end; ++needle_start)
+    {
+        needle.push_back( static_cast<uint8_t>(*needle_start) );
+    }
+    return find_octets( start, end, needle.data( ), needle.size( ), is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename octet_iterator, typename needle_iterator >
+octet_iterator find( octet_iterator start, octet_iterator end, needle_iterator needle_start, needle_iterator needle_end, std::true_type )
+{
+    if (!(needle_start < needle_end))
+    {
+        return start;
+    }
+    return find_octets( start, end, to_pointer<const uint8_t>( needle_start ), static_cast<std::size_t>(needle_end - needle_start),
+        is_contiguous<octet_iterator, 1>( ) );
+}
+
+// A match of an encoded code point can't overlap another one, because it
+// contains only one lead.
+template< typename octet_iterator >
+std::size_t count_octets( octet_iterator it, octet_iterator end, const uint8_t *needle, std::size_t size, std::false_type )
+{
+    std::size_t count = 0;
+    while ((it = find_octets( it, end, needle, size, std::false_type( ) )) != end)
+    {
+        ++count;
+        ++it;
+    }
+    return count;
+}
+
+template< typename octet_iterator >
+std::size_t count_octets( octet_iterator it, octet_iterator end, const uint8_t *needle, std::size_t size, std::true_type )
+{
+    if (!(it < end))
+    {
+        return 0;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( it );
+    return simd::count_octets( first, first + (end - it), needle, size );
+}
+} // namespace detail
+
+/// The library API - functions intended to be called by the users
+inline namespace checked
+{
+template< typename octet_iterator >
+inline octet_iterator append( char32_t cp, octet_iterator result )
+{
+    return detail::encode_checked( cp, result );
+}
+
+template< typename octet_iterator, typename output_iterator >
+output_iterator replace_invalid( octet_iterator begin, octet_iterator end, output_iterator out, char32_t replacement = 0xFFFD )
+{
+    if (begin > end)
+    {
+        //TODO: should be an argument exception
+        throw not_enough_room( );
+    }
+    return detail::replace_invalid( begin, end, out, replacement, detail::is_contiguous<octet_iterator, 1>( ) );
 }
 
 template< typename octet_iterator >
@@ -92,125 +1097,227 @@ char32_t peek_next( octet_iterator it, octet_iterator end )
     return next( it, end );
 }
 
-/// Deprecated in versions that include "prior"
+// With the replace policy an invalid sequence yields replacement_char, with
+// skip the next valid code point is returned. stop leaves it in front of an
+// invalid sequence. All of them return no_code_point if they didn't decode
+// anything, i.e. at end or in front of an invalid sequence with stop.
+template< error_policy policy, typename octet_iterator >
+char32_t next( octet_iterator &it, octet_iterator end )
+{
+    return detail::next( it, end, detail::policy_tag<policy>( ) );
+}
+
+// Takes constant time, it isn't modified if the sequence in front of it is
+// invalid.
 template< typename octet_iterator >
 uint32_t previous( octet_iterator &it, octet_iterator start )
 {
-    if (it == start)
-    {
-        throw not_enough_room( );
-    }
+    return detail::decode_previous( it, start );
+}
 
-    octet_iterator end = it;
-    // Go back until we hit either a lead octet or start
-    while (utf8::detail::is_trail( *--it ))
-    {
-        if (it == start)
-        {
-            // error - no lead byte in the sequence
-            throw invalid_utf8( static_cast<uint8_t>(*it) );
-        }
-    }
-    return peek_next( it, end );
+// Steps back by n code points. Contiguous input is counted backwards by the
+// kernel from simd.h and validated afterwards.
+template< typename octet_iterator, typename distance_type >
+void retreat( octet_iterator &it, distance_type n, octet_iterator start )
+{
+    detail::retreat( it, n, start, detail::is_contiguous<octet_iterator, 1>( ) );
 }
 
+// Contiguous input is validated by the kernel from simd.h and skipped by
+// counting the leads instead of decoding every sequence.
 template< typename octet_iterator, typename distance_type >
 void advance( octet_iterator &it, distance_type n, octet_iterator end )
 {
-    for (distance_type i = 0; i < n; ++i)
-        next( it, end );
+    detail::advance( it, n, end, detail::is_contiguous<octet_iterator, 1>( ) );
 }
 
+// Contiguous input is validated and counted by the kernels from simd.h.
 template< typename octet_iterator >
 typename std::iterator_traits<octet_iterator>::difference_type distance( octet_iterator first, octet_iterator last )
 {
-    typename std::iterator_traits<octet_iterator>::difference_type dist;
-    for (dist = 0; first < last; ++dist)
-        next( first, last );
-    return dist;
+    return detail::distance( first, last, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+// The first occurrence of the code point cp in [start, end) or end. The
+// encoding of cp is searched octet wise, contiguous input is searched by the
+// kernel from simd.h. The input isn't validated, but a match always starts
+// at a lead. Throws invalid_code_point if cp isn't a valid code point.
+template< typename octet_iterator >
+octet_iterator find( octet_iterator start, octet_iterator end, char32_t cp )
+{
+    uint8_t needle[4];
+    const std::size_t size = static_cast<std::size_t>(detail::encode_checked( cp, needle ) - needle);
+    return detail::find_octets( start, end, needle, size, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+// The first occurrence of the UTF-8 encoded needle in [start, end) which
+// starts at a lead or end. A valid needle therefore only matches whole code
+// points. An empty needle matches at start.
+template< typename octet_iterator, typename needle_iterator >
+octet_iterator find( octet_iterator start, octet_iterator end, needle_iterator needle_start, needle_iterator needle_end )
+{
+    return detail::find( start, end, needle_start, needle_end, detail::is_contiguous<needle_iterator, 1>( ) );
+}
+
+template< typename octet_iterator, typename char_type, typename traits, typename allocator >
+octet_iterator find( octet_iterator start, octet_iterator end, const std::basic_string<char_type, traits, allocator> &needle )
+{
+    return utf8::find( start, end, needle.begin( ), needle.end( ) );
+}
+
+// The number of occurrences of the code point cp in [start, end), i.e. the
+// input doesn't have to be decoded. Throws invalid_code_point if cp isn't a
+// valid code point.
+template< typename octet_iterator >
+typename std::iterator_traits<octet_iterator>::difference_type count( octet_iterator start, octet_iterator end, char32_t cp )
+{
+    typedef typename std::iterator_traits<octet_iterator>::difference_type diff_t;
+    uint8_t needle[4];
+    const std::size_t size = static_cast<std::size_t>(detail::encode_checked( cp, needle ) - needle);
+    return static_cast<diff_t>(detail::count_octets( start, end, needle, size, detail::is_contiguous<octet_iterator, 1>( ) ));
 }
 
+// Contiguous input is transcoded by the kernels from simd.h.
 template< typename u16bit_iterator, typename octet_iterator >
 octet_iterator utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result )
 {
-    namespace detail = utf8::detail;
-    while (start != end)
-    {
-        char32_t cp = static_cast<char16_t>(*start++);
-        // Take care of surrogate pairs first
-        if (detail::is_lead_surrogate( cp ))
-        {
-            if (start != end)
-            {
-                char16_t trail_surrogate = static_cast<char16_t>(*start++);
-                if (detail::is_trail_surrogate( trail_surrogate ))
-                {
-                    cp = (cp << 10) + trail_surrogate + detail::SURROGATE_OFFSET;
-                }
-                else
-                {
-                    throw invalid_utf16( trail_surrogate );
-                }
-            }
-            else
-            {
-                throw invalid_utf16( static_cast<char16_t>(cp) );
-            }
-        }
-        // Lone trail surrogate
-        else if (detail::is_trail_surrogate( cp ))
-        {
-            throw invalid_utf16( static_cast<char16_t>(cp) );
-        }
-        result = detail::encode( cp, result );
-    }
-    return result;
+    return detail::utf16to8( start, end, result, detail::is_contiguous<u16bit_iterator, 2>( ) );
 }
 
+// Contiguous input is validated and transcoded by the kernels from simd.h.
 template< typename u16bit_iterator, typename octet_iterator >
 u16bit_iterator utf8to16( octet_iterator start, octet_iterator end, u16bit_iterator result )
 {
-    using namespace utf8::detail;
-
-    while (start != end)
-    {
-        char32_t cp = next( start, end );
-        if (cp > 0xffff)
-        {
-            //make a surrogate pair
-            *result++ = static_cast<char16_t>((cp >> 10) + LEAD_OFFSET);
-            *result++ = static_cast<char16_t>((cp & 0x3ff) + TRAIL_SURROGATE_MIN);
-        }
-        else
-        {
-            *result++ = static_cast<char16_t>(cp);
-        }
-    }
-    return result;
+    return detail::utf8_decode( start, end, result, detail::utf16_tag( ),
+        detail::is_contiguous<octet_iterator, 1>( ) );
 }
 
+// Contiguous input is validated and transcoded by the kernels from simd.h.
 template< typename octet_iterator, typename u32bit_iterator >
 octet_iterator utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result )
 {
-    while (start != end)
-        result = append( *start++, result );
-
-    return result;
+    return detail::utf32to8( start, end, result, detail::is_contiguous<u32bit_iterator, 4>( ) );
 }
 
+// Contiguous input is validated and transcoded by the kernels from simd.h.
 template< typename octet_iterator, typename u32bit_iterator >
 u32bit_iterator utf8to32( octet_iterator start, octet_iterator end, u32bit_iterator result )
 {
-    while (start != end)
-        *result++ = next( start, end );
+    return detail::utf8_decode( start, end, result, detail::utf32_tag( ),
+        detail::is_contiguous<octet_iterator, 1>( ) );
+}
 
-    return result;
+// The conversions above with an error policy, e.g.
+// utf8::utf8to16<utf8::error_policy::replace>( start, end, result ). They
+// return the positions reached along with the first error they came across,
+// with stop that is where they stopped. The replace and skip policies
+// resume behind every invalid sequence, so their valid runs are transcoded
+// by the kernels from simd.h as well.
+template< error_policy policy, typename octet_iterator, typename u16bit_iterator >
+conversion_result<octet_iterator, u16bit_iterator> utf8to16( octet_iterator start, octet_iterator end, u16bit_iterator result )
+{
+    return detail::utf8_decode( start, end, result, detail::utf16_tag( ), detail::policy_tag<policy>( ) );
 }
 
-// The iterator class
-template< typename octet_iterator >
+template< error_policy policy, typename octet_iterator, typename u32bit_iterator >
+conversion_result<octet_iterator, u32bit_iterator> utf8to32( octet_iterator start, octet_iterator end, u32bit_iterator result )
+{
+    return detail::utf8_decode( start, end, result, detail::utf32_tag( ), detail::policy_tag<policy>( ) );
+}
+
+template< error_policy policy, typename u16bit_iterator, typename octet_iterator >
+conversion_result<u16bit_iterator, octet_iterator> utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result )
+{
+    return detail::utf16to8( start, end, result, detail::policy_tag<policy>( ) );
+}
+
+// Non-throwing variants of the conversions above. They stop in front of the
+// first invalid sequence and return the error along with the positions
+// reached, the output written up to there is the same.
+template< typename octet_iterator, typename u16bit_iterator >
+conversion_result<octet_iterator, u16bit_iterator> try_utf8to16( octet_iterator start, octet_iterator end, u16bit_iterator result )
+{
+    return detail::try_utf8_decode( start, end, result, detail::utf16_tag( ),
+        detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename octet_iterator, typename u32bit_iterator >
+conversion_result<octet_iterator, u32bit_iterator> try_utf8to32( octet_iterator start, octet_iterator end, u32bit_iterator result )
+{
+    return detail::try_utf8_decode( start, end, result, detail::utf32_tag( ),
+        detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename u16bit_iterator, typename octet_iterator >
+conversion_result<u16bit_iterator, octet_iterator> try_utf16to8( u16bit_iterator start, u16bit_iterator end, octet_iterator result )
+{
+    return detail::try_utf16to8( start, end, result, detail::is_contiguous<u16bit_iterator, 2>( ) );
+}
+
+template< typename u32bit_iterator, typename octet_iterator >
+conversion_result<u32bit_iterator, octet_iterator> try_utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result )
+{
+    return detail::try_utf32to8( start, end, result, detail::is_contiguous<u32bit_iterator, 4>( ) );
+}
+
+// Transcodes between UTF-16 and UTF-32 without a detour through UTF-8,
+// contiguous input is validated and transcoded by the kernels from simd.h.
+template< typename u16bit_iterator, typename u32bit_iterator >
+u32bit_iterator utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result )
+{
+    return detail::utf16to32( start, end, result, detail::is_contiguous<u16bit_iterator, 2>( ) );
+}
+
+template< typename u32bit_iterator, typename u16bit_iterator >
+u16bit_iterator utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result )
+{
+    return detail::utf32to16( start, end, result, detail::is_contiguous<u32bit_iterator, 4>( ) );
+}
+
+template< typename u16bit_iterator, typename u32bit_iterator >
+conversion_result<u16bit_iterator, u32bit_iterator> try_utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result )
+{
+    return detail::try_utf16to32( start, end, result, detail::is_contiguous<u16bit_iterator, 2>( ) );
+}
+
+template< typename u32bit_iterator, typename u16bit_iterator >
+conversion_result<u32bit_iterator, u16bit_iterator> try_utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result )
+{
+    return detail::try_utf32to16( start, end, result, detail::is_contiguous<u32bit_iterator, 4>( ) );
+}
+
+// Latin-1 consists of the code points up to U+00FF, so the conversion to
+// UTF-8 can't fail. The conversion from UTF-8 throws invalid_code_point for
+// the first code point above U+00FF. Contiguous input is transcoded by the
+// kernels from simd.h.
+template< typename latin1_iterator, typename octet_iterator >
+octet_iterator latin1to8( latin1_iterator start, latin1_iterator end, octet_iterator result )
+{
+    return detail::latin1to8( start, end, result, detail::is_contiguous<latin1_iterator, 1>( ) );
+}
+
+template< typename octet_iterator, typename latin1_iterator >
+latin1_iterator utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result )
+{
+    return detail::utf8tolatin1( start, end, result, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename octet_iterator, typename latin1_iterator >
+conversion_result<octet_iterator, latin1_iterator> try_utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result )
+{
+    return detail::try_utf8tolatin1( start, end, result, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+// The iterator class. With the replace policy it yields replacement_char
+// for every invalid sequence, with skip it steps over them. stop has no
+// meaning for an iterator.
+template< typename octet_iterator, error_policy policy = error_policy::throw_exception >
 class iterator : public std::iterator<std::bidirectional_iterator_tag, char32_t>
 {
+    static_assert(policy != error_policy::stop, "the iterator doesn't support the stop policy");
+
+    typedef detail::policy_tag<policy> policy_t;
+
 public:
     iterator( )
     {
@@ -225,6 +1332,7 @@ public:
     {
         if (it < range_start || it > range_end)
             throw std::out_of_range( "Invalid utf-8 iterator position" );
+        skip_invalid( policy_t( ) );
     }
 
     // the default "big three" are OK
@@ -235,8 +1343,13 @@ public:
 
     char32_t operator *( ) const
     {
-        octet_iterator temp = it;
-        return next( temp, range_end );
+        if (length == 0)
+        {
+            octet_iterator temp = it;
+            cp = detail::next( temp, range_end, policy_t( ) );
+            length = static_cast<uint8_t>(std::distance( it, temp ));
+        }
+        return cp;
     }
 
     bool operator ==( const iterator &rhs ) const
@@ -253,34 +1366,107 @@ public:
 
     iterator & operator ++( )
     {
-        next( it, range_end );
+        increment( );
         return *this;
     }
 
     iterator operator ++( int )
     {
         iterator temp = *this;
-        next( it, range_end );
+        increment( );
         return temp;
     }
 
     iterator & operator --( )
     {
-        previous( it, range_start );
+        decrement( policy_t( ) );
         return *this;
     }
 
     iterator operator --( int )
     {
         iterator temp = *this;
-        previous( it, range_start );
+        decrement( policy_t( ) );
         return temp;
     }
 
 private:
+    // the sequence at it has been decoded by operator * if length != 0
+    void increment( )
+    {
+        if (length != 0)
+        {
+            ::std::advance( it, length );
+            length = 0;
+        }
+        else
+        {
+            detail::next( it, range_end, policy_t( ) );
+        }
+        skip_invalid( policy_t( ) );
+    }
+
+    // the sequence in front of it is decoded anyway, so it is cached for
+    // operator *
+    void decrement( detail::policy_tag<error_policy::throw_exception> )
+    {
+        const octet_iterator end = it;
+        cp = previous( it, range_start );
+        length = static_cast<uint8_t>(std::distance( it, end ));
+    }
+
+    void decrement( detail::policy_tag<error_policy::replace> )
+    {
+        const octet_iterator end = it;
+        if (!detail::previous_sequence( it, range_start, cp ))
+        {
+            cp = replacement_char;
+        }
+        length = static_cast<uint8_t>(std::distance( it, end ));
+    }
+
+    void decrement( detail::policy_tag<error_policy::skip> )
+    {
+        for (;;)
+        {
+            const octet_iterator end = it;
+            if (detail::previous_sequence( it, range_start, cp ))
+            {
+                length = static_cast<uint8_t>(std::distance( it, end ));
+                return;
+            }
+            if (it == range_start)
+            {
+                length = 0;
+                return;
+            }
+        }
+    }
+
+    template< typename policy_type >
+    void skip_invalid( policy_type )
+    {
+    }
+
+    // Keeps it at a valid sequence (or range_end) with the skip policy. The
+    // code point is decoded anyway, so it is cached for operator *.
+    void skip_invalid( detail::policy_tag<error_policy::skip> )
+    {
+        octet_iterator temp = it;
+        while (it != range_end && !detail::next_sequence( temp, range_end, cp ))
+        {
+            it = temp;
+        }
+        length = static_cast<uint8_t>(std::distance( it, temp ));
+    }
+
     octet_iterator it;
     octet_iterator range_start;
     octet_iterator range_end;
+    // the code point at it and its encoded length, decoded by operator *
+    // and reused by operator ++; a length of 0 marks an empty cache
+    mutable char32_t cp = 0;
+    mutable uint8_t length = 0;
 }; // class iterator
 }
 } // namespace utf8
@@ -0,0 +1,241 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include "core.h"
+
+namespace utf8
+{
+// A part of a UTF-8 buffer which starts and ends at sequence boundaries,
+// e.g. a work item for a thread pool. The lengths allow to preallocate the
+// transcoded output of every chunk, they are only exact for valid input.
+template< typename octet_iterator >
+struct chunk
+{
+    octet_iterator first;
+    octet_iterator last;
+    // none of the octets is above 0x7F
+    bool ascii;
+    std::size_t code_points;
+    std::size_t utf16_length;
+};
+
+namespace detail
+{
+template< typename octet_iterator >
+chunk<octet_iterator> make_chunk( octet_iterator first, octet_iterator last, std::false_type )
+{
+    chunk<octet_iterator> result = { first, last, true, 0, 0 };
+    for (; first != last; ++first)
+    {
+        const uint8_t octet = static_cast<uint8_t>(*first);
+        result.ascii = result.ascii && octet < 0x80;
+        result.code_points += !is_trail( octet );
+        result.utf16_length += decoded_utf16_size( octet );
+    }
+    return result;
+}
+
+// all lengths are computed by one pass of the kernel from simd.h
+template< typename octet_iterator >
+chunk<octet_iterator> make_chunk( octet_iterator first, octet_iterator last, std::true_type )
+{
+    if (!(first < last))
+    {
+        return make_chunk( first, last, std::false_type( ) );
+    }
+    const uint8_t *const it = to_pointer<const uint8_t>( first );
+    const simd::utf8_counts counts = simd::measure_utf8( it, it + (last - first) );
+    chunk<octet_iterator> result = { first, last, counts.ascii, counts.leads, counts.leads + counts.four_octet_leads };
+    return result;
+}
+
+template< typename octet_iterator >
+chunk<octet_iterator> make_chunk( octet_iterator first, octet_iterator last )
+{
+    return make_chunk( first, last, is_contiguous<octet_iterator, 1>( ) );
+}
+
+// Moves it n octets forward and returns false if end comes first.
+template< typename octet_iterator >
+bool advance_within( octet_iterator &it, octet_iterator end, std::size_t n, std::random_access_iterator_tag )
+{
+    if (static_cast<std::size_t>(end - it) <= n)
+    {
+        it = end;
+        return false;
+    }
+    it += static_cast<std::ptrdiff_t>(n);
+    return true;
+}
+
+template< typename octet_iterator >
+bool advance_within( octet_iterator &it, octet_iterator end, std::size_t n, std::bidirectional_iterator_tag )
+{
+    for (; n > 0 && it != end; --n)
+    {
+        ++it;
+    }
+    return it != end;
+}
+
+// The end of the chunk starting at first which is about size octets long.
+// It is aligned to the sequence which covers the octet size octets behind
+// first, a chunk which would become empty is extended behind that sequence.
+template< typename octet_iterator >
+octet_iterator chunk_end( octet_iterator first, octet_iterator end, std::size_t size )
+{
+    octet_iterator cut = first;
+    if (!advance_within( cut, end, size, typename std::iterator_traits<octet_iterator>::iterator_category( ) ))
+    {
+        return end;
+    }
+    const octet_iterator boundary = align_to_boundary( first, cut );
+    if (boundary != first)
+    {
+        return boundary;
+    }
+    for (int i = 0; i < 3 && cut != end && is_trail( *cut ); ++i)
+    {
+        ++cut;
+    }
+    return cut;
+}
+} // namespace utf8::detail
+
+// Iterates over the chunks of about chunk_size octets which [start, end) is
+// split into. Each chunk is measured when the iterator reaches it. Contiguous
+// ranges are measured by the vectorized kernel, other ranges must at least
+// be bidirectional.
+template< typename octet_iterator >
+class chunk_view
+{
+public:
+    class iterator : public std::iterator<std::forward_iterator_tag, chunk<octet_iterator>>
+    {
+    public:
+        iterator( )
+        {
+        }
+
+        const chunk<octet_iterator> & operator *( ) const
+        {
+            return current;
+        }
+
+        const chunk<octet_iterator> * operator ->( ) const
+        {
+            return &current;
+        }
+
+        bool operator ==( const iterator &rhs ) const
+        {
+            return current.first == rhs.current.first;
+        }
+
+        bool operator !=( const iterator &rhs ) const
+        {
+            return !(operator ==( rhs ));
+        }
+
+        iterator & operator ++( )
+        {
+            load( current.last );
+            return *this;
+        }
+
+        iterator operator ++( int )
+        {
+            iterator temp = *this;
+            load( current.last );
+            return temp;
+        }
+
+    private:
+        friend class chunk_view;
+
+        iterator( octet_iterator first, octet_iterator range_end, std::size_t chunk_size )
+            : range_end( range_end )
+            , chunk_size( chunk_size )
+        {
+            load( first );
+        }
+
+        void load( octet_iterator first )
+        {
+            current = first != range_end
+                ? detail::make_chunk( first, detail::chunk_end( first, range_end, chunk_size ) )
+                : chunk<octet_iterator>{ range_end, range_end, true, 0, 0 };
+        }
+
+        chunk<octet_iterator> current;
+        octet_iterator range_end;
+        std::size_t chunk_size;
+    };
+
+    chunk_view( octet_iterator start, octet_iterator end, std::size_t chunk_size )
+        : range_start( start )
+        , range_end( end )
+        , chunk_size( chunk_size )
+    {
+        if (chunk_size == 0)
+            throw std::invalid_argument( "The utf-8 chunk size must not be 0" );
+    }
+
+    iterator begin( ) const
+    {
+        return iterator( range_start, range_end, chunk_size );
+    }
+
+    iterator end( ) const
+    {
+        return iterator( range_end, range_end, chunk_size );
+    }
+
+private:
+    octet_iterator range_start;
+    octet_iterator range_end;
+    std::size_t chunk_size;
+};
+
+// Splits [start, end) into at most n chunks of about equal size, chunks
+// which would become empty are omitted. The split points are found in
+// constant time for random access iterators, the chunks are measured in one
+// pass each.
+template< typename octet_iterator >
+std::vector<chunk<octet_iterator>> split_at_boundaries( octet_iterator start, octet_iterator end, std::size_t n )
+{
+    if (n == 0)
+        throw std::invalid_argument( "The number of utf-8 chunks must not be 0" );
+
+    const std::size_t size = static_cast<std::size_t>(std::distance( start, end ));
+    std::vector<chunk<octet_iterator>> chunks;
+    chunks.reserve( n < size ? n : size );
+    octet_iterator first = start;
+    octet_iterator target = start;
+    std::size_t offset = 0;
+    for (std::size_t i = 1; i <= n; ++i)
+    {
+        // the ideal split points are i * size / n without overflowing
+        const std::size_t next = size / n * i + size % n * i / n;
+        std::advance( target, next - offset );
+        offset = next;
+        const octet_iterator last = i != n ? detail::align_to_boundary( first, target ) : end;
+        if (last != first)
+        {
+            chunks.push_back( detail::make_chunk( first, last ) );
+            first = last;
+        }
+    }
+    return chunks;
+}
+}
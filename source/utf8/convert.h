@@ -0,0 +1,177 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "checked.h"
+
+namespace utf8
+{
+namespace detail
+{
+// The encoding of the input is told by the size of its code units: octets
+// are UTF-8, 16bit units UTF-16 and 32bit units UTF-32.
+template< typename iterator_t >
+struct input_unit_size
+    : std::integral_constant<std::size_t, sizeof( typename std::iterator_traits<iterator_t>::value_type )>
+{
+};
+
+template< typename iterator_t >
+std::size_t utf8_length( iterator_t start, iterator_t end, utf16_tag )
+{
+    return utf8::utf8_length_from_utf16( start, end );
+}
+
+template< typename iterator_t >
+std::size_t utf8_length( iterator_t start, iterator_t end, utf32_tag )
+{
+    return utf8::utf8_length_from_utf32( start, end );
+}
+
+template< typename iterator_t >
+std::size_t utf16_length( iterator_t start, iterator_t end, std::integral_constant<std::size_t, 1> )
+{
+    return utf8::utf16_length_from_utf8( start, end );
+}
+
+template< typename iterator_t >
+std::size_t utf16_length( iterator_t start, iterator_t end, utf32_tag )
+{
+    return utf8::utf16_length_from_utf32( start, end );
+}
+
+template< typename iterator_t >
+std::size_t utf32_length( iterator_t start, iterator_t end, std::integral_constant<std::size_t, 1> )
+{
+    return utf8::utf32_length_from_utf8( start, end );
+}
+
+template< typename iterator_t >
+std::size_t utf32_length( iterator_t start, iterator_t end, utf16_tag )
+{
+    return utf8::utf32_length_from_utf16( start, end );
+}
+
+template< typename iterator_t, typename unit_type >
+unit_type *transcode( iterator_t start, iterator_t end, unit_type *result, utf16_tag, std::integral_constant<std::size_t, 1> )
+{
+    return utf8::utf16to8( start, end, result );
+}
+
+template< typename iterator_t, typename unit_type >
+unit_type *transcode( iterator_t start, iterator_t end, unit_type *result, utf32_tag, std::integral_constant<std::size_t, 1> )
+{
+    return utf8::utf32to8( start, end, result );
+}
+
+template< typename iterator_t, typename unit_type >
+unit_type *transcode( iterator_t start, iterator_t end, unit_type *result, std::integral_constant<std::size_t, 1>, utf16_tag )
+{
+    return utf8::utf8to16( start, end, result );
+}
+
+template< typename iterator_t, typename unit_type >
+unit_type *transcode( iterator_t start, iterator_t end, unit_type *result, utf32_tag, utf16_tag )
+{
+    return utf8::utf32to16( start, end, result );
+}
+
+template< typename iterator_t, typename unit_type >
+unit_type *transcode( iterator_t start, iterator_t end, unit_type *result, std::integral_constant<std::size_t, 1>, utf32_tag )
+{
+    return utf8::utf8to32( start, end, result );
+}
+
+template< typename iterator_t, typename unit_type >
+unit_type *transcode( iterator_t start, iterator_t end, unit_type *result, utf16_tag, utf32_tag )
+{
+    return utf8::utf16to32( start, end, result );
+}
+
+// Allocates the string once with the given length and transcodes straight
+// into it. The length is exact for valid input, invalid input throws before
+// the conversion writes beyond the length of its valid prefix.
+template< typename string_type, typename iterator_t >
+string_type transcode_to( iterator_t start, iterator_t end, std::size_t length, const typename string_type::allocator_type &alloc )
+{
+    typedef typename string_type::value_type unit_type;
+    string_type str( length, unit_type( ), alloc );
+    if (length != 0)
+    {
+        unit_type *const first = &str[0];
+        unit_type *const last = transcode( start, end, first, input_unit_size<iterator_t>( ),
+            std::integral_constant<std::size_t, sizeof( unit_type )>( ) );
+        // a length which doesn't match the output is a bug of the counting
+        assert(last == first + length);
+        str.resize( static_cast<std::size_t>(last - first) );
+    }
+    return str;
+}
+} // namespace utf8::detail
+
+// Transcode a range to a new string which is allocated exactly once through
+// alloc. The encoding of the input is told by its code unit size (UTF-8,
+// UTF-16 or UTF-32), so e.g. std::wstring input works on every platform; it
+// has to differ from the encoding of the result.
+// Invalid input throws like the conversion functions. With C++17 a
+// std::pmr::polymorphic_allocator can be passed in order to allocate from
+// an arena.
+template< typename allocator = std::allocator<char>, typename iterator_t >
+std::basic_string<char, std::char_traits<char>, allocator> to_u8string( iterator_t start, iterator_t end,
+    const allocator &alloc = allocator( ) )
+{
+    typedef std::basic_string<char, std::char_traits<char>, allocator> string_type;
+    return detail::transcode_to<string_type>( start, end,
+        detail::utf8_length( start, end, detail::input_unit_size<iterator_t>( ) ), alloc );
+}
+
+template< typename allocator = std::allocator<char16_t>, typename iterator_t >
+std::basic_string<char16_t, std::char_traits<char16_t>, allocator> to_u16string( iterator_t start, iterator_t end,
+    const allocator &alloc = allocator( ) )
+{
+    typedef std::basic_string<char16_t, std::char_traits<char16_t>, allocator> string_type;
+    return detail::transcode_to<string_type>( start, end,
+        detail::utf16_length( start, end, detail::input_unit_size<iterator_t>( ) ), alloc );
+}
+
+template< typename allocator = std::allocator<char32_t>, typename iterator_t >
+std::basic_string<char32_t, std::char_traits<char32_t>, allocator> to_u32string( iterator_t start, iterator_t end,
+    const allocator &alloc = allocator( ) )
+{
+    typedef std::basic_string<char32_t, std::char_traits<char32_t>, allocator> string_type;
+    return detail::transcode_to<string_type>( start, end,
+        detail::utf32_length( start, end, detail::input_unit_size<iterator_t>( ) ), alloc );
+}
+
+// the same for whole strings, which are passed to the kernels as pointers
+template< typename allocator = std::allocator<char>, typename unit_type, typename traits, typename str_allocator >
+std::basic_string<char, std::char_traits<char>, allocator> to_u8string(
+    const std::basic_string<unit_type, traits, str_allocator> &str, const allocator &alloc = allocator( ) )
+{
+    return to_u8string( str.data( ), str.data( ) + str.size( ), alloc );
+}
+
+template< typename allocator = std::allocator<char16_t>, typename unit_type, typename traits, typename str_allocator >
+std::basic_string<char16_t, std::char_traits<char16_t>, allocator> to_u16string(
+    const std::basic_string<unit_type, traits, str_allocator> &str, const allocator &alloc = allocator( ) )
+{
+    return to_u16string( str.data( ), str.data( ) + str.size( ), alloc );
+}
+
+template< typename allocator = std::allocator<char32_t>, typename unit_type, typename traits, typename str_allocator >
+std::basic_string<char32_t, std::char_traits<char32_t>, allocator> to_u32string(
+    const std::basic_string<unit_type, traits, str_allocator> &str, const allocator &alloc = allocator( ) )
+{
+    return to_u32string( str.data( ), str.data( ) + str.size( ), alloc );
+}
+}
@@ -8,7 +8,13 @@
 
 #include <cstdint>
 #include <iterator>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "simd.h"
 
 namespace utf8
 {
@@ -90,6 +96,55 @@ public:
     }
 };
 
+// The errors reported by the non-throwing functions, they correspond to the
+// exceptions above.
+enum class error_code
+{
+    ok,
+    invalid_code_point,
+    invalid_utf8,
+    invalid_utf16,
+    // the input ends in the middle of a sequence
+    not_enough_room,
+};
+
+// The outcome of a non-throwing conversion.
+template< typename input_iterator, typename output_iterator >
+struct conversion_result
+{
+    error_code error;
+    // the end of the input or the start of the offending sequence
+    input_iterator in;
+    // behind the last code unit written
+    output_iterator out;
+
+    explicit operator bool( ) const noexcept
+    {
+        return error == error_code::ok;
+    }
+};
+
+// How the algorithms taking an error_policy template argument treat invalid
+// input. The policy is a template argument, so replace, stop and skip compile
+// to loops without any exception handling.
+enum class error_policy
+{
+    // throw the exceptions above like the functions without a policy
+    throw_exception,
+    // substitute replacement_char for every invalid sequence, the same
+    // sequences as replace_invalid does
+    replace,
+    // stop in front of the first invalid sequence like the try_ functions
+    stop,
+    // drop invalid sequences
+    skip,
+};
+
+// U+FFFD REPLACEMENT CHARACTER
+const char32_t replacement_char = 0xFFFDu;
+// returned by next if it didn't decode a code point
+const char32_t no_code_point = 0xFFFFFFFFu;
+
 // Helper code - not intended to be directly called by the library users. May be changed at any time
 namespace detail
 {
@@ -101,8 +156,8 @@ const uint16_t LEAD_SURROGATE_MAX = 0xDBFFu;
 const uint16_t TRAIL_SURROGATE_MIN = 0xDC00u;
 const uint16_t TRAIL_SURROGATE_MAX = 0xDFFFu;
 const uint16_t LEAD_OFFSET = LEAD_SURROGATE_MIN - (0x10000 >> 10);
-const uint32_t SURROGATE_OFFSET = 0x10000u - (LEAD_SURROGATE_MIN << 10) - TRAIL_SURROGATE_MIN
-const uint32_t CODE_POINT_MAX = 0x10FFFFu
+const uint32_t SURROGATE_OFFSET = 0x10000u - (LEAD_SURROGATE_MIN << 10) - TRAIL_SURROGATE_MIN;
+const uint32_t CODE_POINT_MAX = 0x10FFFFu;
 const char32_t ERROR_CHAR = 0xFFFFFFFFu;
 
 template< typename result_type, uintmax_t bit_mask, typename input_type >
@@ -136,34 +191,52 @@ constexpr bool is_code_point_valid( char32_t cp ) noexcept
     return cp <= CODE_POINT_MAX && !is_surrogate( cp );
 }
 
+// The following helpers are constexpr, so they can be used at compile time
+// as well (see literal.h). They are branchless, the chains of comparisons
+// they replace mispredicted constantly on mixed script text. The sequence
+// length is looked up in a table of nibbles indexed by the high nibble of
+// the lead, F8-FF share the nibble with the 4 octet leads and are masked out.
 template< typename diff_type >
-inline diff_type sequence_length( uint8_t lead_byte ) noexcept
-{
-    if (lead_byte < 0x80)
-        return 1;
-    else if ((lead_byte >> 5) == 0x6)
-        return 2;
-    else if ((lead_byte >> 4) == 0xe)
-        return 3;
-    else if ((lead_byte >> 3) == 0x1e)
-        return 4;
-    else
-        return 0;
+constexpr diff_type sequence_length( uint8_t lead_byte ) noexcept
+{
+    return static_cast<diff_type>((0x4322000011111111ull >> (lead_byte >> 4) * 4 & 0xF) * (lead_byte < 0xF8));
+}
+
+// The decoders switch on the length anyway. There the compiler folds these
+// comparisons into the dispatch, which beats a table lookup followed by a
+// jump table.
+template< typename diff_type >
+constexpr diff_type dispatch_length( uint8_t lead_byte ) noexcept
+{
+    return lead_byte < 0x80 ? 1
+        : (lead_byte >> 5) == 0x6 ? 2
+        : (lead_byte >> 4) == 0xe ? 3
+        : (lead_byte >> 3) == 0x1e ? 4
+        : 0;
 }
 
 template <typename octet_difference_type>
-inline octet_difference_type encoded_utf8_size( char32_t cp ) noexcept
+constexpr octet_difference_type encoded_utf8_size( char32_t cp ) noexcept
 {
-    if (cp < 0x80)
-        return 1;
-    if (cp < 0x800)
-        return 2;
-    if (cp < 0x10000)
-        return 3;
-    if (cp <= CODE_POINT_MAX)
-        return 4;
+    return static_cast<octet_difference_type>((1 + (cp >= 0x80) + (cp >= 0x800) + (cp >= 0x10000))
+        * (cp <= CODE_POINT_MAX));
+}
+
+// the number of octets a UTF-16 code unit accounts for in the UTF-8
+// encoding, i.e. two for each half of a surrogate pair
+template <typename octet_difference_type>
+constexpr octet_difference_type encoded_utf8_size_utf16( char16_t cu ) noexcept
+{
+    return cu < 0x80 ? 1
+        : cu < 0x800 || is_surrogate( cu ) ? 2
+        : 3;
+}
 
-    return 0;
+// the number of UTF-16 code units the sequence starting with oc decodes to,
+// continuations don't count
+constexpr std::size_t decoded_utf16_size( uint8_t oc ) noexcept
+{
+    return static_cast<std::size_t>(!is_trail( oc )) + (oc >= 0xF0);
 }
 
 template< typename octet_iterator >
@@ -194,6 +267,60 @@ inline octet_iterator encode( char32_t cp, octet_iterator result )
     return ++result;
 }
 
+// Pointer outputs are encoded without branches: all three continuations are
+// stored back to front and the ones a shorter sequence doesn't have are
+// clamped onto the lead, which is stored last. So nothing is written past
+// the end of the sequence.
+template< typename octet_type >
+inline octet_type *encode( char32_t cp, octet_type *result )
+{
+    const std::size_t last = (cp >= 0x80) + (cp >= 0x800) + (cp >= 0x10000);
+    result[last] = static_cast<octet_type>((cp & 0x3f) | 0x80);
+    result[last - (last != 0)] = static_cast<octet_type>((cp >> 6 & 0x3f) | 0x80);
+    result[last == 3] = static_cast<octet_type>((cp >> 12 & 0x3f) | 0x80);
+    result[0] = static_cast<octet_type>(static_cast<uint8_t>(0xF0E0C000u >> 8 * last) | (cp >> 6 * last));
+    return result + last + 1;
+}
+
+template< typename u16bit_iterator >
+inline u16bit_iterator encode_utf16( char32_t cp, u16bit_iterator result )
+{
+    if (cp > 0xffff)
+    {
+        //make a surrogate pair
+        *result++ = static_cast<char16_t>((cp >> 10) + LEAD_OFFSET);
+        *result++ = static_cast<char16_t>((cp & 0x3ff) + TRAIL_SURROGATE_MIN);
+    }
+    else
+    {
+        *result++ = static_cast<char16_t>(cp);
+    }
+    return result;
+}
+
+template< typename u32bit_iterator >
+inline u32bit_iterator encode_utf32( char32_t cp, u32bit_iterator result )
+{
+    *result++ = cp;
+    return result;
+}
+
+// selects the encoding of decoded code points by the code unit size
+typedef std::integral_constant<std::size_t, 2> utf16_tag;
+typedef std::integral_constant<std::size_t, 4> utf32_tag;
+
+template< typename u16bit_iterator >
+inline u16bit_iterator encode_units( char32_t cp, u16bit_iterator result, utf16_tag )
+{
+    return encode_utf16( cp, result );
+}
+
+template< typename u32bit_iterator >
+inline u32bit_iterator encode_units( char32_t cp, u32bit_iterator result, utf32_tag )
+{
+    return encode_utf32( cp, result );
+}
+
 enum class err_handler
 {
     // no checks
@@ -204,6 +331,151 @@ enum class err_handler
     exc,
 };
 
+// compile time sequences of indices, make_indices<n>::type is indices<0, ..., n - 1>
+template< std::size_t... i >
+struct indices
+{
+};
+
+template< std::size_t n, std::size_t... i >
+struct make_indices : make_indices<n - 1, n - 1, i...>
+{
+};
+
+template< std::size_t... i >
+struct make_indices<0, i...>
+{
+    typedef indices<i...> type;
+};
+
+// A table driven DFA in the style of Bjoern Hoehrmann's decoder. It validates
+// the lead and trail ranges, overlong sequences and surrogates with a single
+// transition per octet.
+namespace dfa
+{
+// The classes are chosen such that 0xFF >> class masks the payload of a lead.
+constexpr uint8_t octet_class( std::size_t octet ) noexcept
+{
+    return octet < 0x80 ? 0
+        : octet < 0x90 ? 1
+        : octet < 0xA0 ? 9
+        : octet < 0xC0 ? 7
+        : octet < 0xC2 ? 8
+        : octet < 0xE0 ? 2
+        : octet == 0xE0 ? 10
+        : octet == 0xED ? 4
+        : octet < 0xF0 ? 3
+        : octet == 0xF0 ? 11
+        : octet < 0xF4 ? 6
+        : octet == 0xF4 ? 5
+        : 8;
+}
+
+const std::size_t num_classes = 12;
+
+// the states are offsets into the transition table
+enum state : uint8_t
+{
+    accept = 0,
+    reject = 1 * num_classes,
+    // any continuation
+    trail_1 = 2 * num_classes,
+    trail_2 = 3 * num_classes,
+    trail_3 = 4 * num_classes,
+    // restricted second octets: E0 A0..BF, ED 80..9F, F0 90..BF, F4 80..8F
+    after_e0 = 5 * num_classes,
+    after_ed = 6 * num_classes,
+    after_f0 = 7 * num_classes,
+    after_f4 = 8 * num_classes,
+};
+
+const std::size_t num_states = 9;
+
+constexpr bool is_trail_class( std::size_t c ) noexcept
+{
+    return c == 1 || c == 7 || c == 9;
+}
+
+constexpr uint8_t transition( std::size_t s, std::size_t c ) noexcept
+{
+    return s == accept
+        ? (c == 0 ? accept
+            : c == 2 ? trail_1
+            : c == 3 ? trail_2
+            : c == 4 ? after_ed
+            : c == 5 ? after_f4
+            : c == 6 ? trail_3
+            : c == 10 ? after_e0
+            : c == 11 ? after_f0
+            : reject)
+        : s == trail_1 ? (is_trail_class( c ) ? accept : reject)
+        : s == trail_2 ? (is_trail_class( c ) ? trail_1 : reject)
+        : s == trail_3 ? (is_trail_class( c ) ? trail_2 : reject)
+        : s == after_e0 ? (c == 7 ? trail_1 : reject)
+        : s == after_ed ? (c == 1 || c == 9 ? trail_1 : reject)
+        : s == after_f0 ? (c == 7 || c == 9 ? trail_2 : reject)
+        : s == after_f4 ? (c == 1 ? trail_2 : reject)
+        : reject;
+}
+
+struct tables
+{
+    uint8_t classes[256];
+    uint8_t transitions[num_states * num_classes];
+};
+
+template< std::size_t... c, std::size_t... t >
+constexpr tables make_tables( indices<c...>, indices<t...> ) noexcept
+{
+    return { { octet_class( c )... }, { transition( t - t % num_classes, t % num_classes )... } };
+}
+
+// a class template, so the definition may live in the header
+template< typename = void >
+struct table_storage
+{
+    static constexpr tables value = make_tables( make_indices<256>::type( ),
+        make_indices<num_states * num_classes>::type( ) );
+};
+
+template< typename T >
+constexpr tables table_storage<T>::value;
+
+// Decodes the sequence at it and advances it behind it. Returns false if the
+// sequence is invalid or truncated, it is unspecified in that case.
+template< typename octet_iterator >
+inline bool decode( octet_iterator &it, octet_iterator end, char32_t &cp )
+{
+    if (it == end)
+    {
+        return false;
+    }
+    const uint8_t lead = static_cast<uint8_t>(*it);
+    ++it;
+    if (lead < 0x80)
+    {
+        cp = lead;
+        return true;
+    }
+    const tables &t = table_storage<>::value;
+    const uint8_t c = t.classes[lead];
+    cp = (0xFFu >> c) & lead;
+    uint8_t s = t.transitions[c];
+    while (s > reject)
+    {
+        if (it == end)
+        {
+            return false;
+        }
+        const uint8_t octet = static_cast<uint8_t>(*it);
+        ++it;
+        cp = (octet & 0x3Fu) | cp << 6;
+        s = t.transitions[s + t.classes[octet]];
+    }
+    return s == accept;
+}
+} // namespace dfa
+
 template< int seq_length, err_handler eh, typename octet_iterator >
 inline char32_t get_sequence( octet_iterator &it, octet_iterator end )
 {
@@ -265,13 +537,27 @@ inline char32_t decode( octet_iterator &it, octet_iterator end )
         }
     }
 
+#if defined(UTF8_DFA_DECODER)
+    if (eh != err_handler::none)
+    {
+        // the DFA only accepts, errors are reported by the code below
+        iterator_t dfa_it = it;
+        char32_t dfa_cp;
+        if (dfa::decode( dfa_it, end, dfa_cp ))
+        {
+            it = dfa_it;
+            return dfa_cp;
+        }
+    }
+#endif
+
     // Save the original value of it so we can go back in case of failure
     // Of course, it does not make much sense with i.e. stream iterators
     iterator_t original_it = it;
 
     // Determine the sequence length based on the lead octet
     typedef typename std::iterator_traits<iterator_t>::difference_type diff_t;
-    const diff_t length = sequence_length<diff_t>( *it );
+    const diff_t length = dispatch_length<diff_t>( *it );
 
     // calculate the code point
     char32_t cp = ERROR_CHAR;
@@ -330,17 +616,222 @@ inline char32_t decode( octet_iterator &it, octet_iterator end )
     }
     return cp;
 }
-} // namespace detail
 
-/// The library API - functions intended to be called by the users
+template< err_handler eh, typename u16bit_iterator >
+inline char32_t decode_utf16( u16bit_iterator &it, u16bit_iterator end )
+{
+    char32_t cp = static_cast<char16_t>(*it++);
+    // Take care of surrogate pairs first
+    if (is_lead_surrogate( cp ))
+    {
+        if (eh != err_handler::none && it == end)
+        {
+            if (eh == err_handler::exc)
+                throw invalid_utf16( static_cast<char16_t>(cp) );
+            else
+                return ERROR_CHAR;
+        }
+        char16_t trail_surrogate = static_cast<char16_t>(*it++);
+        if (eh != err_handler::none && !is_trail_surrogate( trail_surrogate ))
+        {
+            if (eh == err_handler::exc)
+                throw invalid_utf16( trail_surrogate );
+            else
+                return ERROR_CHAR;
+        }
+        cp = (cp << 10) + trail_surrogate + SURROGATE_OFFSET;
+    }
+    // Lone trail surrogate
+    else if (eh != err_handler::none && is_trail_surrogate( cp ))
+    {
+        if (eh == err_handler::exc)
+            throw invalid_utf16( static_cast<char16_t>(cp) );
+        else
+            return ERROR_CHAR;
+    }
+    return cp;
+}
 
-// Byte order mark
-const uint8_t bom[] = { 0xEF, 0xBB, 0xBF };
+// Decodes like decode<err_handler::exc>, but reports errors instead of
+// throwing and leaves it at the offending sequence.
+template< typename octet_iterator >
+inline error_code try_decode( octet_iterator &it, octet_iterator end, char32_t &cp )
+{
+    if (it >= end)
+    {
+        return error_code::not_enough_room;
+    }
+
+#if defined(UTF8_DFA_DECODER)
+    octet_iterator dfa_it = it;
+    if (dfa::decode( dfa_it, end, cp ))
+    {
+        it = dfa_it;
+        return error_code::ok;
+    }
+#endif
+
+    const octet_iterator original_it = it;
+    typedef typename std::iterator_traits<octet_iterator>::difference_type diff_t;
+    const diff_t length = dispatch_length<diff_t>( *it );
+    switch (length)
+    {
+    case 1:
+        cp = get_sequence<1, err_handler::icp>( it, end );
+        return error_code::ok;
+    case 2:
+        cp = get_sequence<2, err_handler::icp>( it, end );
+        break;
+    case 3:
+        cp = get_sequence<3, err_handler::icp>( it, end );
+        break;
+    case 4:
+        cp = get_sequence<4, err_handler::icp>( it, end );
+        break;
+    default:
+        return error_code::invalid_utf8;
+    }
+
+    error_code error = error_code::ok;
+    if (cp == ERROR_CHAR)
+    {
+        // get_sequence stopped at the end or at the missing continuation
+        error = it == end ? error_code::not_enough_room : error_code::invalid_utf8;
+    }
+    else if (!is_code_point_valid( cp ))
+    {
+        error = error_code::invalid_code_point;
+    }
+    else if (length != encoded_utf8_size<diff_t>( cp ))
+    {
+        error = error_code::invalid_utf8;
+    }
+    if (error != error_code::ok)
+    {
+        it = original_it;
+    }
+    return error;
+}
 
+// Advances it behind the invalid sequence at it, i.e. as far as
+// replace_next in checked.h does. A truncated sequence ends at end, the
+// octet which cuts a sequence short isn't skipped along with it.
 template< typename octet_iterator >
-octet_iterator find_invalid( octet_iterator it, octet_iterator end )
+inline void skip_invalid( octet_iterator &it, octet_iterator end )
+{
+    typedef typename std::iterator_traits<octet_iterator>::difference_type diff_t;
+    switch (dispatch_length<diff_t>( *it ))
+    {
+    case 2:
+        get_sequence<2, err_handler::icp>( it, end );
+        break;
+    case 3:
+        get_sequence<3, err_handler::icp>( it, end );
+        break;
+    case 4:
+        get_sequence<4, err_handler::icp>( it, end );
+        break;
+    default:
+        ++it;
+    }
+}
+
+// Decodes like decode_utf16<err_handler::exc>, but reports errors instead of
+// throwing and leaves it at the unpaired surrogate.
+template< typename u16bit_iterator >
+inline error_code try_decode_utf16( u16bit_iterator &it, u16bit_iterator end, char32_t &cp )
+{
+    const u16bit_iterator original_it = it;
+    cp = decode_utf16<err_handler::icp>( it, end );
+    if (cp == ERROR_CHAR)
+    {
+        it = original_it;
+        return error_code::invalid_utf16;
+    }
+    return error_code::ok;
+}
+
+// C++11 has no way to detect contiguous iterators in general, therefore only
+// pointers and the iterators of std::basic_string and std::vector are known
+// to refer to contiguous storage. All other iterators take the generic path.
+template< typename value_type >
+struct string_iterators
+{
+    typedef void iterator;
+    typedef void const_iterator;
+};
+
+template< typename char_type >
+struct basic_string_iterators
+{
+    typedef typename std::basic_string<char_type>::iterator iterator;
+    typedef typename std::basic_string<char_type>::const_iterator const_iterator;
+};
+
+template< >
+struct string_iterators<char> : basic_string_iterators<char>
+{
+};
+
+template< >
+struct string_iterators<wchar_t> : basic_string_iterators<wchar_t>
+{
+};
+
+template< >
+struct string_iterators<char16_t> : basic_string_iterators<char16_t>
+{
+};
+
+template< >
+struct string_iterators<char32_t> : basic_string_iterators<char32_t>
+{
+};
+
+template< typename iterator_t, typename value_type,
+    bool = std::is_integral<value_type>::value && !std::is_same<value_type, bool>::value >
+struct contiguous_unit_size_impl
+    : std::integral_constant<std::size_t, 0>
+{
+};
+
+template< typename iterator_t, typename value_type >
+struct contiguous_unit_size_impl<iterator_t, value_type, true>
+    : std::integral_constant<std::size_t,
+        std::is_pointer<iterator_t>::value
+        || std::is_same<iterator_t, typename std::vector<value_type>::iterator>::value
+        || std::is_same<iterator_t, typename std::vector<value_type>::const_iterator>::value
+        || std::is_same<iterator_t, typename string_iterators<value_type>::iterator>::value
+        || std::is_same<iterator_t, typename string_iterators<value_type>::const_iterator>::value
+        ? sizeof( value_type ) : 0>
+{
+};
+
+// the size of the code units an iterator refers to if they are stored
+// contiguously, zero otherwise
+template< typename iterator_t >
+struct contiguous_unit_size
+    : contiguous_unit_size_impl<iterator_t,
+        typename std::remove_cv<typename std::iterator_traits<iterator_t>::value_type>::type>
+{
+};
+
+template< typename iterator_t, std::size_t unit_size >
+struct is_contiguous
+    : std::integral_constant<bool, contiguous_unit_size<iterator_t>::value == unit_size>
+{
+};
+
+// the iterator must be dereferencable, i.e. the range must not be empty
+template< typename unit_type, typename iterator_t >
+inline unit_type *to_pointer( iterator_t it )
+{
+    return reinterpret_cast<unit_type *>(std::addressof( *it ));
+}
+
+template< typename octet_iterator >
+octet_iterator find_invalid( octet_iterator it, octet_iterator end, std::false_type )
 {
-    using namespace detail;
     octet_iterator result;
     do
     {
@@ -349,17 +840,735 @@ octet_iterator find_invalid( octet_iterator it, octet_iterator end )
     return result;
 }
 
+inline const uint8_t *find_invalid( const uint8_t *it, const uint8_t *end )
+{
+    for (;;)
+    {
+        it = simd::valid_prefix( it, end );
+
+        // the kernel stopped either in front of an error or the trailing
+        // partial block, so decode (at least) one block worth of sequences
+        const uint8_t *const stop = end - it > simd::block_size ? it + simd::block_size : end;
+        while (it < stop)
+        {
+            const uint8_t *const result = it;
+            if (decode<err_handler::icp>( it, end ) == ERROR_CHAR)
+            {
+                return result;
+            }
+        }
+        if (it == end)
+        {
+            return end;
+        }
+    }
+}
+
 template< typename octet_iterator >
-inline bool is_valid( octet_iterator start, octet_iterator end )
+octet_iterator find_invalid( octet_iterator it, octet_iterator end, std::true_type )
 {
-    return find_invalid( start, end ) == end;
+    if (!(it < end))
+    {
+        return it;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( it );
+    return it + (find_invalid( first, first + (end - it) ) - first);
 }
 
 template< typename octet_iterator >
-inline bool starts_with_bom( octet_iterator it, octet_iterator end )
+octet_iterator find_last_invalid( octet_iterator it, octet_iterator end, std::false_type )
 {
-    return (it != end && static_cast<uint8_t>(*it) == bom[0])
-        && (++it != end && static_cast<uint8_t>(*it) == bom[1])
-        && (++it != end && static_cast<uint8_t>(*it) == bom[2]);
+    octet_iterator result = end;
+    while ((it = find_invalid( it, end, std::false_type( ) )) != end)
+    {
+        result = it;
+        skip_invalid( it, end );
+    }
+    return result;
+}
+
+// Validates windows from the back with the vectorized validator. Each lead
+// starts a sequence and a continuation more than three octets behind the
+// closest lead is invalid on its own, so a window can start at the closest
+// lead at most three octets in front of its nominal start or at the nominal
+// start itself and is decoded exactly like the whole input.
+inline const uint8_t *find_last_invalid( const uint8_t *begin, const uint8_t *end )
+{
+    const std::ptrdiff_t window_size = 4096;
+    for (const uint8_t *window_end = end; window_end != begin; )
+    {
+        const uint8_t *window = window_end - begin > window_size ? window_end - window_size : begin;
+        const uint8_t *lead = window;
+        for (int i = 0; i < 3 && lead != begin && is_trail( *lead ); ++i)
+        {
+            --lead;
+        }
+        if (!is_trail( *lead ))
+        {
+            window = lead;
+        }
+
+        const uint8_t *invalid = find_invalid( window, window_end );
+        if (invalid != window_end)
+        {
+            const uint8_t *result;
+            do
+            {
+                result = invalid;
+                skip_invalid( invalid, window_end );
+            } while ((invalid = find_invalid( invalid, window_end )) != window_end);
+            return result;
+        }
+        window_end = window;
+    }
+    return end;
+}
+
+template< typename octet_iterator >
+octet_iterator find_last_invalid( octet_iterator it, octet_iterator end, std::true_type )
+{
+    if (!(it < end))
+    {
+        return end;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( it );
+    return it + (find_last_invalid( first, first + (end - it) ) - first);
+}
+
+// Moves cut in front of the sequence it points into by backing off over at
+// most three continuations. Every lead and every stray continuation starts a
+// sequence, so the result is a sequence boundary of invalid input as well.
+template< typename octet_iterator >
+octet_iterator align_to_boundary( octet_iterator start, octet_iterator cut )
+{
+    octet_iterator lead = cut;
+    for (std::size_t i = 1; i <= 3 && lead != start; ++i)
+    {
+        if (!is_trail( *--lead ))
+        {
+            // the continuations in front of cut belong to this lead unless
+            // they are stray ones
+            return sequence_length<std::size_t>( *lead ) > i ? lead : cut;
+        }
+    }
+    return cut;
+}
+
+// Steps back over up to n code points of the valid UTF-8 in front of it and
+// decrements n by the number of skipped ones. The n code points take at least
+// n octets, so the last n octets in front of it belong to them and it
+// suffices to count their leads. it may end up inside a sequence whose lead
+// hasn't been counted, the scalar loop steps back to that lead.
+inline const uint8_t *retreat_valid( const uint8_t *it, const uint8_t *start, std::size_t &n ) noexcept
+{
+    while (n > 64 && it - start > 64)
+    {
+        const std::size_t length = n < static_cast<std::size_t>(it - start) ? n : static_cast<std::size_t>(it - start);
+        n -= simd::count_utf8<false>( it - length, it );
+        it -= length;
+    }
+    for (; n > 0 && it != start; --n)
+    {
+        while (--it != start && is_trail( *it ))
+        {
+        }
+    }
+    return it;
+}
+
+// The transcoders below expect valid input, they are used by the unchecked
+// API and by the checked one after validating the input.
+
+// [it, end) must be valid UTF-8
+template< typename unit_type >
+unit_type *utf8_decode_valid( const uint8_t *it, const uint8_t *end, unit_type *result )
+{
+    typedef std::integral_constant<std::size_t, sizeof( unit_type )> unit_size;
+    for (;;)
+    {
+        simd::utf8_decode( it, end, result );
+
+        const uint8_t *const stop = end - it > simd::block_size ? it + simd::block_size : end;
+        while (it < stop)
+        {
+            result = encode_units( decode<err_handler::none>( it, end ), result, unit_size( ) );
+        }
+        // a truncated sequence may take it past end
+        if (it >= end)
+        {
+            return result;
+        }
+    }
+}
+
+template< typename unit_iterator, typename unit_size >
+unit_iterator utf8_decode_valid( const uint8_t *it, const uint8_t *end, unit_iterator result, unit_size, std::true_type )
+{
+    typedef typename std::iterator_traits<unit_iterator>::value_type unit_type;
+    unit_type *const first = to_pointer<unit_type>( result );
+    return result + (utf8_decode_valid( it, end, first ) - first);
+}
+
+template< typename unit_iterator, typename unit_size >
+unit_iterator utf8_decode_valid( const uint8_t *it, const uint8_t *end, unit_iterator result, unit_size, std::false_type )
+{
+    while (it != end)
+    {
+        result = encode_units( decode<err_handler::none>( it, end ), result, unit_size( ) );
+    }
+    return result;
+}
+
+// decodes to UTF-16 or UTF-32 depending on unit_size
+template< typename unit_iterator, typename unit_size >
+unit_iterator utf8_decode_valid( const uint8_t *it, const uint8_t *end, unit_iterator result, unit_size )
+{
+    if (it == end)
+    {
+        return result;
+    }
+    return utf8_decode_valid( it, end, result, unit_size( ),
+        is_contiguous<unit_iterator, unit_size::value>( ) );
+}
+
+// [it, end) must be valid UTF-16
+template< typename u16_type, typename octet_type >
+octet_type *utf16to8_valid( const u16_type *it, const u16_type *end, octet_type *result )
+{
+    for (;;)
+    {
+        simd::utf16to8( it, end, result );
+
+        const u16_type *const stop = end - it > 8 ? it + 8 : end;
+        while (it < stop)
+        {
+            result = encode( decode_utf16<err_handler::none>( it, end ), result );
+        }
+        if (it == end)
+        {
+            return result;
+        }
+    }
+}
+
+template< typename u16_type, typename octet_iterator >
+octet_iterator utf16to8_valid( const u16_type *it, const u16_type *end, octet_iterator result, std::true_type )
+{
+    typedef typename std::iterator_traits<octet_iterator>::value_type octet_type;
+    octet_type *const first = to_pointer<octet_type>( result );
+    return result + (utf16to8_valid( it, end, first ) - first);
+}
+
+template< typename u16_type, typename octet_iterator >
+octet_iterator utf16to8_valid( const u16_type *it, const u16_type *end, octet_iterator result, std::false_type )
+{
+    while (it != end)
+    {
+        result = encode( decode_utf16<err_handler::none>( it, end ), result );
+    }
+    return result;
+}
+
+template< typename u16_type, typename octet_iterator >
+octet_iterator utf16to8_valid( const u16_type *it, const u16_type *end, octet_iterator result )
+{
+    if (it == end)
+    {
+        return result;
+    }
+    return utf16to8_valid( it, end, result, is_contiguous<octet_iterator, 1>( ) );
+}
+
+// [it, end) must be valid UTF-32
+template< typename u32_type, typename octet_type >
+octet_type *utf32to8_valid( const u32_type *it, const u32_type *end, octet_type *result )
+{
+    for (;;)
+    {
+        simd::utf32to8( it, end, result );
+
+        const u32_type *const stop = end - it > 8 ? it + 8 : end;
+        while (it < stop)
+        {
+            result = encode( static_cast<char32_t>(*it++), result );
+        }
+        if (it == end)
+        {
+            return result;
+        }
+    }
+}
+
+template< typename u32_type, typename octet_iterator >
+octet_iterator utf32to8_valid( const u32_type *it, const u32_type *end, octet_iterator result, std::true_type )
+{
+    typedef typename std::iterator_traits<octet_iterator>::value_type octet_type;
+    octet_type *const first = to_pointer<octet_type>( result );
+    return result + (utf32to8_valid( it, end, first ) - first);
+}
+
+template< typename u32_type, typename octet_iterator >
+octet_iterator utf32to8_valid( const u32_type *it, const u32_type *end, octet_iterator result, std::false_type )
+{
+    while (it != end)
+    {
+        result = encode( static_cast<char32_t>(*it++), result );
+    }
+    return result;
+}
+
+template< typename u32_type, typename octet_iterator >
+octet_iterator utf32to8_valid( const u32_type *it, const u32_type *end, octet_iterator result )
+{
+    if (it == end)
+    {
+        return result;
+    }
+    return utf32to8_valid( it, end, result, is_contiguous<octet_iterator, 1>( ) );
+}
+
+// [it, end) must be valid UTF-16
+template< typename u16_type, typename u32_type >
+u32_type *utf16to32_valid( const u16_type *it, const u16_type *end, u32_type *result )
+{
+    for (;;)
+    {
+        simd::utf16to32( it, end, result );
+
+        const u16_type *const stop = end - it > 8 ? it + 8 : end;
+        while (it < stop)
+        {
+            *result++ = static_cast<u32_type>(decode_utf16<err_handler::none>( it, end ));
+        }
+        if (it == end)
+        {
+            return result;
+        }
+    }
+}
+
+template< typename u16_type, typename u32bit_iterator >
+u32bit_iterator utf16to32_valid( const u16_type *it, const u16_type *end, u32bit_iterator result, std::true_type )
+{
+    typedef typename std::iterator_traits<u32bit_iterator>::value_type u32_type;
+    u32_type *const first = to_pointer<u32_type>( result );
+    return result + (utf16to32_valid( it, end, first ) - first);
+}
+
+template< typename u16_type, typename u32bit_iterator >
+u32bit_iterator utf16to32_valid( const u16_type *it, const u16_type *end, u32bit_iterator result, std::false_type )
+{
+    while (it != end)
+    {
+        *result++ = decode_utf16<err_handler::none>( it, end );
+    }
+    return result;
+}
+
+template< typename u16_type, typename u32bit_iterator >
+u32bit_iterator utf16to32_valid( const u16_type *it, const u16_type *end, u32bit_iterator result )
+{
+    if (it == end)
+    {
+        return result;
+    }
+    return utf16to32_valid( it, end, result, is_contiguous<u32bit_iterator, 4>( ) );
+}
+
+// [it, end) must be valid UTF-32
+template< typename u32_type, typename u16_type >
+u16_type *utf32to16_valid( const u32_type *it, const u32_type *end, u16_type *result )
+{
+    for (;;)
+    {
+        simd::utf32to16( it, end, result );
+
+        const u32_type *const stop = end - it > 8 ? it + 8 : end;
+        while (it < stop)
+        {
+            result = encode_utf16( static_cast<char32_t>(*it++), result );
+        }
+        if (it == end)
+        {
+            return result;
+        }
+    }
+}
+
+template< typename u32_type, typename u16bit_iterator >
+u16bit_iterator utf32to16_valid( const u32_type *it, const u32_type *end, u16bit_iterator result, std::true_type )
+{
+    typedef typename std::iterator_traits<u16bit_iterator>::value_type u16_type;
+    u16_type *const first = to_pointer<u16_type>( result );
+    return result + (utf32to16_valid( it, end, first ) - first);
+}
+
+template< typename u32_type, typename u16bit_iterator >
+u16bit_iterator utf32to16_valid( const u32_type *it, const u32_type *end, u16bit_iterator result, std::false_type )
+{
+    while (it != end)
+    {
+        result = encode_utf16( static_cast<char32_t>(*it++), result );
+    }
+    return result;
+}
+
+template< typename u32_type, typename u16bit_iterator >
+u16bit_iterator utf32to16_valid( const u32_type *it, const u32_type *end, u16bit_iterator result )
+{
+    if (it == end)
+    {
+        return result;
+    }
+    return utf32to16_valid( it, end, result, is_contiguous<u16bit_iterator, 2>( ) );
+}
+
+// Latin-1 are the code points up to U+00FF, so every octet is valid input.
+template< typename octet_type >
+octet_type *latin1to8_valid( const uint8_t *it, const uint8_t *end, octet_type *result )
+{
+    for (;;)
+    {
+        simd::latin1to8( it, end, result );
+
+        const uint8_t *const stop = end - it > 16 ? it + 16 : end;
+        while (it < stop)
+        {
+            result = encode( *it++, result );
+        }
+        if (it == end)
+        {
+            return result;
+        }
+    }
+}
+
+template< typename octet_iterator >
+octet_iterator latin1to8_valid( const uint8_t *it, const uint8_t *end, octet_iterator result, std::true_type )
+{
+    typedef typename std::iterator_traits<octet_iterator>::value_type octet_type;
+    octet_type *const first = to_pointer<octet_type>( result );
+    return result + (latin1to8_valid( it, end, first ) - first);
+}
+
+template< typename octet_iterator >
+octet_iterator latin1to8_valid( const uint8_t *it, const uint8_t *end, octet_iterator result, std::false_type )
+{
+    while (it != end)
+    {
+        result = encode( *it++, result );
+    }
+    return result;
+}
+
+template< typename latin1_iterator, typename octet_iterator >
+octet_iterator latin1to8( latin1_iterator start, latin1_iterator end, octet_iterator result, std::false_type )
+{
+    while (start != end)
+    {
+        result = encode( static_cast<uint8_t>(*start++), result );
+    }
+    return result;
+}
+
+template< typename latin1_iterator, typename octet_iterator >
+octet_iterator latin1to8( latin1_iterator start, latin1_iterator end, octet_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return result;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    return latin1to8_valid( first, first + (end - start), result, is_contiguous<octet_iterator, 1>( ) );
+}
+
+// [it, end) must be valid UTF-8, the conversion stops in front of the first
+// code point above U+00FF and leaves it there.
+template< typename octet_type >
+octet_type *utf8tolatin1_valid( const uint8_t *&it, const uint8_t *end, octet_type *result )
+{
+    for (;;)
+    {
+        simd::utf8tolatin1( it, end, result );
+
+        const uint8_t *const stop = end - it > 16 ? it + 16 : end;
+        while (it < stop)
+        {
+            if (*it >= 0xC4)
+            {
+                return result;
+            }
+            if (*it < 0x80)
+            {
+                *result++ = static_cast<octet_type>(*it++);
+            }
+            else
+            {
+                *result++ = static_cast<octet_type>((it[0] & 0x03) << 6 | (it[1] & 0x3F));
+                it += 2;
+            }
+        }
+        if (it == end)
+        {
+            return result;
+        }
+    }
+}
+
+template< typename octet_iterator >
+octet_iterator utf8tolatin1_valid( const uint8_t *&it, const uint8_t *end, octet_iterator result, std::true_type )
+{
+    typedef typename std::iterator_traits<octet_iterator>::value_type octet_type;
+    octet_type *const first = to_pointer<octet_type>( result );
+    return result + (utf8tolatin1_valid( it, end, first ) - first);
+}
+
+template< typename octet_iterator >
+octet_iterator utf8tolatin1_valid( const uint8_t *&it, const uint8_t *end, octet_iterator result, std::false_type )
+{
+    while (it != end && *it < 0xC4)
+    {
+        *result++ = static_cast<uint8_t>(decode<err_handler::none>( it, end ));
+    }
+    return result;
+}
+
+template< typename octet_iterator >
+octet_iterator utf8tolatin1_valid( const uint8_t *&it, const uint8_t *end, octet_iterator result )
+{
+    if (it == end)
+    {
+        return result;
+    }
+    return utf8tolatin1_valid( it, end, result, is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename octet_iterator >
+std::size_t utf16_length_from_utf8( octet_iterator start, octet_iterator end, std::false_type )
+{
+    std::size_t length = 0;
+    for (; start != end; ++start)
+    {
+        length += decoded_utf16_size( static_cast<uint8_t>(*start) );
+    }
+    return length;
+}
+
+template< typename octet_iterator >
+std::size_t utf16_length_from_utf8( octet_iterator start, octet_iterator end, std::true_type )
+{
+    if (start == end)
+    {
+        return 0;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    return simd::count_utf8<true>( first, first + (end - start) );
+}
+
+template< typename octet_iterator >
+std::size_t utf32_length_from_utf8( octet_iterator start, octet_iterator end, std::false_type )
+{
+    std::size_t length = 0;
+    for (; start != end; ++start)
+    {
+        length += !is_trail( static_cast<uint8_t>(*start) );
+    }
+    return length;
+}
+
+template< typename octet_iterator >
+std::size_t utf32_length_from_utf8( octet_iterator start, octet_iterator end, std::true_type )
+{
+    if (start == end)
+    {
+        return 0;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    return simd::count_utf8<false>( first, first + (end - start) );
+}
+
+template< typename u16bit_iterator >
+std::size_t utf8_length_from_utf16( u16bit_iterator start, u16bit_iterator end, std::false_type )
+{
+    std::size_t length = 0;
+    for (; start != end; ++start)
+    {
+        length += encoded_utf8_size_utf16<std::size_t>( static_cast<char16_t>(*start) );
+    }
+    return length;
+}
+
+template< typename u16bit_iterator >
+std::size_t utf8_length_from_utf16( u16bit_iterator start, u16bit_iterator end, std::true_type )
+{
+    if (start == end)
+    {
+        return 0;
+    }
+    typedef typename std::iterator_traits<u16bit_iterator>::value_type u16_type;
+    const u16_type *const first = to_pointer<const u16_type>( start );
+    return simd::utf8_length_from_utf16( first, first + (end - start) );
+}
+
+template< typename u32bit_iterator >
+std::size_t utf8_length_from_utf32( u32bit_iterator start, u32bit_iterator end, std::false_type )
+{
+    std::size_t length = 0;
+    for (; start != end; ++start)
+    {
+        length += encoded_utf8_size<std::size_t>( static_cast<char32_t>(*start) );
+    }
+    return length;
+}
+
+template< typename u32bit_iterator >
+std::size_t utf8_length_from_utf32( u32bit_iterator start, u32bit_iterator end, std::true_type )
+{
+    if (start == end)
+    {
+        return 0;
+    }
+    typedef typename std::iterator_traits<u32bit_iterator>::value_type u32_type;
+    const u32_type *const first = to_pointer<const u32_type>( start );
+    return simd::utf8_length_from_utf32( first, first + (end - start) );
+}
+
+template< typename latin1_iterator >
+std::size_t utf8_length_from_latin1( latin1_iterator start, latin1_iterator end, std::false_type )
+{
+    std::size_t length = 0;
+    for (; start != end; ++start)
+    {
+        length += 1 + (static_cast<uint8_t>(*start) >= 0x80);
+    }
+    return length;
+}
+
+template< typename latin1_iterator >
+std::size_t utf8_length_from_latin1( latin1_iterator start, latin1_iterator end, std::true_type )
+{
+    if (start == end)
+    {
+        return 0;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    return simd::utf8_length_from_latin1( first, first + (end - start) );
+}
+} // namespace detail
+
+/// The library API - functions intended to be called by the users
+
+// Byte order mark
+const uint8_t bom[] = { 0xEF, 0xBB, 0xBF };
+
+// Contiguous ranges (pointers, std::string and std::vector iterators) are
+// validated by the vectorized kernel from simd.h.
+template< typename octet_iterator >
+octet_iterator find_invalid( octet_iterator it, octet_iterator end )
+{
+    return detail::find_invalid( it, end, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename octet_iterator >
+inline bool is_valid( octet_iterator start, octet_iterator end )
+{
+    return find_invalid( start, end ) == end;
+}
+
+// The start of the last invalid sequence or end if the input is valid.
+// Contiguous ranges are validated window by window from the back by the
+// kernel from simd.h, so an error close to the end is found without
+// validating the whole input.
+template< typename octet_iterator >
+octet_iterator find_last_invalid( octet_iterator start, octet_iterator end )
+{
+    return detail::find_last_invalid( start, end, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+// The end of the longest prefix of [start, end) which consists of at most
+// max_octets octets and doesn't cut a sequence in half. It backs off over at
+// most three continuations, i.e. it takes constant time for random access
+// iterators and doesn't validate anything.
+template< typename octet_iterator >
+octet_iterator truncate_to_boundary( octet_iterator start, octet_iterator end, std::size_t max_octets )
+{
+    if (static_cast<std::size_t>(std::distance( start, end )) <= max_octets)
+    {
+        return end;
+    }
+    octet_iterator cut = start;
+    std::advance( cut, max_octets );
+    return detail::align_to_boundary( start, cut );
+}
+
+template< typename octet_iterator >
+inline bool starts_with_bom( octet_iterator it, octet_iterator end )
+{
+    return (it != end && static_cast<uint8_t>(*it) == bom[0])
+        && (++it != end && static_cast<uint8_t>(*it) == bom[1])
+        && (++it != end && static_cast<uint8_t>(*it) == bom[2]);
+}
+
+// The number of code units the conversion of valid input produces, so the
+// output can be allocated up front. Invalid input yields an unspecified
+// result. Contiguous ranges are counted by the kernels from simd.h.
+template< typename octet_iterator >
+std::size_t utf16_length_from_utf8( octet_iterator start, octet_iterator end )
+{
+    return detail::utf16_length_from_utf8( start, end, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename octet_iterator >
+std::size_t utf32_length_from_utf8( octet_iterator start, octet_iterator end )
+{
+    return detail::utf32_length_from_utf8( start, end, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename u16bit_iterator >
+std::size_t utf8_length_from_utf16( u16bit_iterator start, u16bit_iterator end )
+{
+    return detail::utf8_length_from_utf16( start, end, detail::is_contiguous<u16bit_iterator, 2>( ) );
+}
+
+template< typename u32bit_iterator >
+std::size_t utf8_length_from_utf32( u32bit_iterator start, u32bit_iterator end )
+{
+    return detail::utf8_length_from_utf32( start, end, detail::is_contiguous<u32bit_iterator, 4>( ) );
+}
+
+// every code point takes one code unit, the trail surrogates aren't counted
+template< typename u16bit_iterator >
+std::size_t utf32_length_from_utf16( u16bit_iterator start, u16bit_iterator end )
+{
+    std::size_t length = 0;
+    for (; start != end; ++start)
+    {
+        length += !detail::is_trail_surrogate( detail::masked_cast<char32_t, 0xFFFF>( *start ) );
+    }
+    return length;
+}
+
+template< typename u32bit_iterator >
+std::size_t utf16_length_from_utf32( u32bit_iterator start, u32bit_iterator end )
+{
+    std::size_t length = 0;
+    for (; start != end; ++start)
+    {
+        length += 1 + (static_cast<char32_t>(*start) > 0xFFFF);
+    }
+    return length;
+}
+
+template< typename latin1_iterator >
+std::size_t utf8_length_from_latin1( latin1_iterator start, latin1_iterator end )
+{
+    return detail::utf8_length_from_latin1( start, end, detail::is_contiguous<latin1_iterator, 1>( ) );
+}
+
+// every code point of the valid UTF-8 input takes one Latin-1 octet
+template< typename octet_iterator >
+std::size_t latin1_length_from_utf8( octet_iterator start, octet_iterator end )
+{
+    return utf32_length_from_utf8( start, end );
 }
 } // namespace utf8
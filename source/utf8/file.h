@@ -0,0 +1,498 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "checked.h"
+
+// Validates and transcodes files through memory mappings, window by window,
+// so neither the input nor the output needs to be read into memory at once.
+// This header isn't included by utf8.h, because it depends on the operating
+// system's API.
+namespace utf8
+{
+namespace detail
+{
+// The files are processed in windows of about this many octets. The next
+// window is read ahead by the operating system while the current one is
+// processed, processed windows are dropped from the working set.
+const std::size_t file_window_size = std::size_t( 1 ) << 24;
+
+#if defined(_WIN32)
+inline std::system_error last_system_error( const char *what )
+{
+    return std::system_error( static_cast<int>(GetLastError( )), std::system_category( ), what );
+}
+#else
+inline std::system_error last_system_error( const char *what )
+{
+    return std::system_error( errno, std::system_category( ), what );
+}
+
+inline void advise_pages( const void *begin, const void *end, int advice ) noexcept
+{
+    // only whole pages inside the range
+    static const std::uintptr_t page_size = static_cast<std::uintptr_t>(sysconf( _SC_PAGESIZE ));
+    const std::uintptr_t first = (reinterpret_cast<std::uintptr_t>(begin) + page_size - 1) & ~(page_size - 1);
+    const std::uintptr_t last = reinterpret_cast<std::uintptr_t>(end) & ~(page_size - 1);
+    if (first < last)
+    {
+        madvise( reinterpret_cast<void *>(first), last - first, advice );
+    }
+}
+#endif
+
+// the base of file and output_file, owns the file handle and the mapping
+class mapped_file
+{
+public:
+    mapped_file( const mapped_file & ) = delete;
+    mapped_file &operator =( const mapped_file & ) = delete;
+
+    std::size_t size( ) const noexcept
+    {
+        return length;
+    }
+
+protected:
+    mapped_file( ) noexcept
+        : data( nullptr )
+        , length( 0 )
+#if defined(_WIN32)
+        , handle( INVALID_HANDLE_VALUE )
+#else
+        , handle( -1 )
+#endif
+    {
+    }
+
+    mapped_file( mapped_file &&other ) noexcept
+        : mapped_file( )
+    {
+        swap( other );
+    }
+
+    ~mapped_file( )
+    {
+        unmap( );
+        close_handle( );
+    }
+
+    void swap( mapped_file &other ) noexcept
+    {
+        std::swap( data, other.data );
+        std::swap( length, other.length );
+        std::swap( handle, other.handle );
+    }
+
+#if defined(_WIN32)
+    void open( const std::string &path, bool writable )
+    {
+        handle = CreateFileA( path.c_str( ), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+            writable ? 0 : FILE_SHARE_READ, nullptr, writable ? CREATE_ALWAYS : OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            throw last_system_error( "utf8::file: cannot open file" );
+        }
+    }
+
+    std::size_t file_size( ) const
+    {
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx( handle, &size ))
+        {
+            throw last_system_error( "utf8::file: cannot determine file size" );
+        }
+        return static_cast<std::size_t>(size.QuadPart);
+    }
+
+    void resize( std::size_t size )
+    {
+        LARGE_INTEGER pos;
+        pos.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx( handle, pos, nullptr, FILE_BEGIN ) || !SetEndOfFile( handle ))
+        {
+            throw last_system_error( "utf8::file: cannot resize file" );
+        }
+    }
+
+    void map( std::size_t size, bool writable )
+    {
+        length = size;
+        if (size == 0)
+        {
+            return;
+        }
+        const unsigned long long max_size = size;
+        HANDLE mapping = CreateFileMappingA( handle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+            static_cast<DWORD>(max_size >> 32), static_cast<DWORD>(max_size), nullptr );
+        if (mapping == nullptr)
+        {
+            throw last_system_error( "utf8::file: cannot map file" );
+        }
+        data = static_cast<uint8_t *>(MapViewOfFile( mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size ));
+        CloseHandle( mapping );
+        if (data == nullptr)
+        {
+            throw last_system_error( "utf8::file: cannot map file" );
+        }
+    }
+
+    void unmap( ) noexcept
+    {
+        if (data != nullptr)
+        {
+            UnmapViewOfFile( data );
+            data = nullptr;
+        }
+    }
+
+    void close_handle( ) noexcept
+    {
+        if (handle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle( handle );
+            handle = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    void will_need( const uint8_t *, const uint8_t * ) const noexcept
+    {
+    }
+
+    void release( const uint8_t *, const uint8_t * ) const noexcept
+    {
+        // Windows trims the working set of mapped files on its own
+    }
+#else
+    void open( const std::string &path, bool writable )
+    {
+        handle = ::open( path.c_str( ), writable ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0666 );
+        if (handle == -1)
+        {
+            throw last_system_error( "utf8::file: cannot open file" );
+        }
+    }
+
+    std::size_t file_size( ) const
+    {
+        struct stat info;
+        if (fstat( handle, &info ) != 0)
+        {
+            throw last_system_error( "utf8::file: cannot determine file size" );
+        }
+        return static_cast<std::size_t>(info.st_size);
+    }
+
+    void resize( std::size_t size )
+    {
+        if (ftruncate( handle, static_cast<off_t>(size) ) != 0)
+        {
+            throw last_system_error( "utf8::file: cannot resize file" );
+        }
+    }
+
+    void map( std::size_t size, bool writable )
+    {
+        length = size;
+        if (size == 0)
+        {
+            return;
+        }
+        void *const addr = mmap( nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+            MAP_SHARED, handle, 0 );
+        if (addr == MAP_FAILED)
+        {
+            throw last_system_error( "utf8::file: cannot map file" );
+        }
+        data = static_cast<uint8_t *>(addr);
+        madvise( addr, size, MADV_SEQUENTIAL );
+    }
+
+    void unmap( ) noexcept
+    {
+        if (data != nullptr)
+        {
+            munmap( data, length );
+            data = nullptr;
+        }
+    }
+
+    void close_handle( ) noexcept
+    {
+        if (handle != -1)
+        {
+            ::close( handle );
+            handle = -1;
+        }
+    }
+
+    void will_need( const uint8_t *it, const uint8_t *end ) const noexcept
+    {
+        advise_pages( it, end, MADV_WILLNEED );
+    }
+
+    void release( const uint8_t *it, const uint8_t *end ) const noexcept
+    {
+        // the pages of a shared mapping are kept in the page cache (and
+        // written back if dirty), they only leave the working set
+        advise_pages( it, end, MADV_DONTNEED );
+    }
+#endif
+
+    uint8_t *data;
+    std::size_t length;
+#if defined(_WIN32)
+    HANDLE handle;
+#else
+    int handle;
+#endif
+};
+} // namespace detail
+
+// A read-only mapping of a whole file.
+class file : public detail::mapped_file
+{
+public:
+    // throws std::system_error if the file cannot be opened or mapped
+    explicit file( const std::string &path )
+    {
+        open( path, false );
+        map( file_size( ), false );
+    }
+
+    file( file && ) = default;
+
+    file &operator =( file &&other ) noexcept
+    {
+        swap( other );
+        return *this;
+    }
+
+    const uint8_t *begin( ) const noexcept
+    {
+        return data;
+    }
+
+    const uint8_t *end( ) const noexcept
+    {
+        return data + length;
+    }
+
+    // Hints that [it, end) will be read soon, i.e. the system can read it
+    // in while the calling thread works on the data in front of it.
+    void prefetch( const uint8_t *it, const uint8_t *end ) const noexcept
+    {
+        will_need( it, end );
+    }
+
+    // Hints that [it, end) won't be read again and can be dropped from
+    // the working set.
+    void done( const uint8_t *it, const uint8_t *end ) const noexcept
+    {
+        release( it, end );
+    }
+};
+
+// A writable mapping of a file which is created (or truncated) with the
+// given size, e.g. the output length computed in advance.
+class output_file : public detail::mapped_file
+{
+public:
+    // throws std::system_error if the file cannot be created or mapped
+    output_file( const std::string &path, std::size_t size )
+    {
+        open( path, true );
+        resize( size );
+        map( size, true );
+    }
+
+    output_file( output_file && ) = default;
+
+    output_file &operator =( output_file &&other ) noexcept
+    {
+        swap( other );
+        return *this;
+    }
+
+    uint8_t *begin( ) noexcept
+    {
+        return data;
+    }
+
+    uint8_t *end( ) noexcept
+    {
+        return data + length;
+    }
+
+    // Hints that [it, end) has been written completely, the system writes
+    // it back and drops it from the working set.
+    void done( const uint8_t *it, const uint8_t *end ) const noexcept
+    {
+        release( it, end );
+    }
+
+    // Unmaps and closes the file after truncating it to size octets, the
+    // size must not exceed the one the file has been created with.
+    void close( std::size_t size )
+    {
+        unmap( );
+        resize( size );
+        close_handle( );
+        length = 0;
+    }
+};
+
+namespace detail
+{
+// Calls f( window_begin, window_end ) for consecutive windows of [it, end),
+// each of which starts at a sequence boundary (see split_chunks in
+// parallel.h), so it is validated and decoded like the whole input. f
+// returns false in order to stop, the windows behind aren't read then.
+template< typename function >
+void for_each_window( const file &input, const uint8_t *it, const uint8_t *end, function f )
+{
+    while (it != end)
+    {
+        const uint8_t *window_end = end;
+        if (static_cast<std::size_t>(end - it) > file_window_size)
+        {
+            window_end = align_to_boundary( it, it + file_window_size );
+        }
+        input.prefetch( window_end, window_end + std::min<std::size_t>( end - window_end, file_window_size ) );
+        const bool proceed = f( it, window_end );
+        input.done( it, window_end );
+        if (!proceed)
+        {
+            return;
+        }
+        it = window_end;
+    }
+}
+
+// the input must be valid UTF-8
+template< typename unit_type >
+void transcode_file( const file &input, const std::string &output_path, std::size_t output_length )
+{
+    output_file output( output_path, output_length * sizeof( unit_type ) );
+    unit_type *result = reinterpret_cast<unit_type *>(output.begin( ));
+    for_each_window( input, input.begin( ), input.end( ), [&]( const uint8_t *it, const uint8_t *window_end )
+    {
+        unit_type *const window_result = result;
+        result = utf8_decode_valid( it, window_end, result );
+        output.done( reinterpret_cast<const uint8_t *>(window_result), reinterpret_cast<const uint8_t *>(result) );
+        return true;
+    } );
+    output.close( output_length * sizeof( unit_type ) );
+}
+
+// throws the exception next( ) throws for the sequence at it, the windows
+// don't cut sequences, so it is invalid within [it, end) as well
+inline void throw_invalid( const uint8_t *it, const uint8_t *end )
+{
+    utf8::next( it, end );
+    assert(false && "find_invalid stopped at a valid sequence");
+}
+} // namespace detail
+
+// Returns the offset of the first invalid sequence or the file size.
+inline std::size_t find_invalid( const file &input )
+{
+    const uint8_t *invalid = input.end( );
+    detail::for_each_window( input, input.begin( ), input.end( ), [&]( const uint8_t *it, const uint8_t *window_end )
+    {
+        const uint8_t *const window_invalid = detail::find_invalid( it, window_end );
+        if (window_invalid != window_end)
+        {
+            invalid = window_invalid;
+            return false;
+        }
+        return true;
+    } );
+    return static_cast<std::size_t>(invalid - input.begin( ));
+}
+
+inline bool is_valid( const file &input )
+{
+    return find_invalid( input ) == input.size( );
+}
+
+// Writes input with invalid sequences replaced like replace_invalid to a
+// file at output_path.
+inline void replace_invalid( const file &input, const std::string &output_path, char32_t replacement = 0xFFFD )
+{
+    // the output is as long as the input up to the first invalid sequence,
+    // behind it each octet is replaced at most once
+    const std::size_t valid = find_invalid( input );
+    const std::size_t replacement_size = detail::encoded_utf8_size<std::size_t>( replacement );
+    output_file output( output_path, valid + (input.size( ) - valid) * std::max<std::size_t>( replacement_size, 1 ) );
+
+    uint8_t *result = output.begin( );
+    detail::for_each_window( input, input.begin( ), input.end( ), [&]( const uint8_t *it, const uint8_t *window_end )
+    {
+        uint8_t *const window_result = result;
+        result = utf8::replace_invalid( it, window_end, result, replacement );
+        output.done( window_result, result );
+        return true;
+    } );
+    output.close( static_cast<std::size_t>(result - output.begin( )) );
+}
+
+// Write input as UTF-16/UTF-32 in the native byte order without BOM to a file
+// at output_path. An invalid input throws the exception utf8to16/utf8to32
+// would throw before the output file is created.
+inline void utf8to16( const file &input, const std::string &output_path )
+{
+    std::size_t length = 0;
+    detail::for_each_window( input, input.begin( ), input.end( ), [&]( const uint8_t *it, const uint8_t *window_end )
+    {
+        const uint8_t *const invalid = detail::find_invalid( it, window_end );
+        if (invalid != window_end)
+        {
+            detail::throw_invalid( invalid, input.end( ) );
+        }
+        length += utf16_length_from_utf8( it, window_end );
+        return true;
+    } );
+    detail::transcode_file<char16_t>( input, output_path, length );
+}
+
+inline void utf8to32( const file &input, const std::string &output_path )
+{
+    std::size_t length = 0;
+    detail::for_each_window( input, input.begin( ), input.end( ), [&]( const uint8_t *it, const uint8_t *window_end )
+    {
+        const uint8_t *const invalid = detail::find_invalid( it, window_end );
+        if (invalid != window_end)
+        {
+            detail::throw_invalid( invalid, input.end( ) );
+        }
+        length += utf32_length_from_utf8( it, window_end );
+        return true;
+    } );
+    detail::transcode_file<char32_t>( input, output_path, length );
+}
+}
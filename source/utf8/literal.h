@@ -0,0 +1,253 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "core.h"
+
+namespace utf8
+{
+namespace detail
+{
+// Compile time validation and transcoding of UTF-8 literals. The functions
+// are C++11 constexpr and recurse on halves of [b, e) instead of one octet
+// after another, so the recursion depth only grows logarithmically with the
+// length of the literal. s points to the size octets of the literal.
+
+const std::size_t literal_npos = static_cast<std::size_t>(-1);
+
+template< typename char_type >
+constexpr uint8_t literal_octet( const char_type *s, std::size_t i ) noexcept
+{
+    return static_cast<uint8_t>(s[i]);
+}
+
+// whether the octets (i, i + length) exist and are continuations
+template< typename char_type >
+constexpr bool literal_trails( const char_type *s, std::size_t size, std::size_t i, std::size_t length ) noexcept
+{
+    return length <= 1
+        || (i + 1 < size && is_trail( literal_octet( s, i + 1 ) ) && literal_trails( s, size, i + 1, length - 1 ));
+}
+
+template< typename char_type >
+constexpr char32_t literal_decode( const char_type *s, std::size_t i, std::size_t length ) noexcept
+{
+    return length == 1 ? literal_octet( s, i )
+        : length == 2 ? (literal_octet( s, i ) & 0x1Fu) << 6 | (literal_octet( s, i + 1 ) & 0x3Fu)
+        : length == 3 ? (literal_octet( s, i ) & 0x0Fu) << 12 | (literal_octet( s, i + 1 ) & 0x3Fu) << 6
+            | (literal_octet( s, i + 2 ) & 0x3Fu)
+        : (literal_octet( s, i ) & 0x07u) << 18 | (literal_octet( s, i + 1 ) & 0x3Fu) << 12
+            | (literal_octet( s, i + 2 ) & 0x3Fu) << 6 | (literal_octet( s, i + 3 ) & 0x3Fu);
+}
+
+template< typename char_type >
+constexpr char32_t literal_code_point( const char_type *s, std::size_t i ) noexcept
+{
+    return literal_decode( s, i, sequence_length<std::size_t>( literal_octet( s, i ) ) );
+}
+
+// a lead followed by its continuations which encodes a valid code point in
+// the shortest possible form
+template< typename char_type >
+constexpr bool literal_valid_sequence( const char_type *s, std::size_t size, std::size_t i, std::size_t length ) noexcept
+{
+    return length != 0 && literal_trails( s, size, i, length )
+        && is_code_point_valid( literal_decode( s, i, length ) )
+        && encoded_utf8_size<std::size_t>( literal_decode( s, i, length ) ) == length;
+}
+
+// A continuation is valid if the closest lead in front of it is at most 3
+// octets away and long enough, the lead is validated on its own.
+template< typename char_type >
+constexpr bool literal_covered( const char_type *s, std::size_t i, std::size_t distance ) noexcept
+{
+    return distance <= 3 && i >= distance
+        && (is_trail( literal_octet( s, i - distance ) )
+            ? literal_covered( s, i, distance + 1 )
+            : sequence_length<std::size_t>( literal_octet( s, i - distance ) ) > distance);
+}
+
+template< typename char_type >
+constexpr bool literal_valid_at( const char_type *s, std::size_t size, std::size_t i ) noexcept
+{
+    return is_trail( literal_octet( s, i ) )
+        ? literal_covered( s, i, 1 )
+        : literal_valid_sequence( s, size, i, sequence_length<std::size_t>( literal_octet( s, i ) ) );
+}
+
+template< typename char_type >
+constexpr std::size_t literal_find_invalid( const char_type *s, std::size_t size, std::size_t b, std::size_t e ) noexcept;
+
+template< typename char_type >
+constexpr std::size_t literal_find_invalid_right( const char_type *s, std::size_t size, std::size_t left,
+    std::size_t b, std::size_t e ) noexcept
+{
+    return left != literal_npos ? left : literal_find_invalid( s, size, b, e );
+}
+
+// the position of the first invalid octet in [b, e) or literal_npos
+template< typename char_type >
+constexpr std::size_t literal_find_invalid( const char_type *s, std::size_t size, std::size_t b, std::size_t e ) noexcept
+{
+    return e - b == 0 ? literal_npos
+        : e - b == 1 ? (literal_valid_at( s, size, b ) ? literal_npos : b)
+        : literal_find_invalid_right( s, size, literal_find_invalid( s, size, b, b + (e - b) / 2 ), b + (e - b) / 2, e );
+}
+
+// the number of code units the sequences starting in [b, e) decode to
+template< typename char_type >
+constexpr std::size_t literal_units( const char_type *s, std::size_t b, std::size_t e, utf16_tag ) noexcept
+{
+    return e - b == 0 ? 0
+        : e - b == 1 ? decoded_utf16_size( literal_octet( s, b ) )
+        : literal_units( s, b, b + (e - b) / 2, utf16_tag( ) ) + literal_units( s, b + (e - b) / 2, e, utf16_tag( ) );
+}
+
+template< typename char_type >
+constexpr std::size_t literal_units( const char_type *s, std::size_t b, std::size_t e, utf32_tag ) noexcept
+{
+    return e - b == 0 ? 0
+        : e - b == 1 ? static_cast<std::size_t>(!is_trail( literal_octet( s, b ) ))
+        : literal_units( s, b, b + (e - b) / 2, utf32_tag( ) ) + literal_units( s, b + (e - b) / 2, e, utf32_tag( ) );
+}
+
+template< typename char_type, typename unit_size >
+constexpr std::size_t literal_length( const char_type *s, std::size_t size, std::size_t invalid, unit_size )
+{
+    return invalid == literal_npos ? literal_units( s, 0, size, unit_size( ) )
+        : throw invalid_utf8( literal_octet( s, invalid ) );
+}
+
+// the lead of the sequence which decodes to code unit n and the index of
+// the unit within the sequence
+struct literal_position
+{
+    std::size_t octet;
+    std::size_t unit;
+};
+
+template< typename char_type, typename unit_size >
+constexpr literal_position literal_find_unit( const char_type *s, std::size_t b, std::size_t e, std::size_t n, unit_size );
+
+template< typename char_type, typename unit_size >
+constexpr literal_position literal_find_unit_in( const char_type *s, std::size_t b, std::size_t e, std::size_t n,
+    std::size_t left_units, unit_size )
+{
+    return n < left_units
+        ? literal_find_unit( s, b, b + (e - b) / 2, n, unit_size( ) )
+        : literal_find_unit( s, b + (e - b) / 2, e, n - left_units, unit_size( ) );
+}
+
+template< typename char_type, typename unit_size >
+constexpr literal_position literal_find_unit( const char_type *s, std::size_t b, std::size_t e, std::size_t n, unit_size )
+{
+    return e - b == 1 ? literal_position{ b, n }
+        : literal_find_unit_in( s, b, e, n, literal_units( s, b, b + (e - b) / 2, unit_size( ) ), unit_size( ) );
+}
+
+constexpr char16_t literal_utf16_unit( char32_t cp, std::size_t unit ) noexcept
+{
+    return static_cast<char16_t>(cp < 0x10000 ? cp
+        : unit == 0 ? (cp >> 10) + LEAD_OFFSET
+        : (cp & 0x3FF) + TRAIL_SURROGATE_MIN);
+}
+
+template< typename char_type >
+constexpr char16_t literal_unit( const char_type *s, literal_position p, utf16_tag ) noexcept
+{
+    return literal_utf16_unit( literal_code_point( s, p.octet ), p.unit );
+}
+
+template< typename char_type >
+constexpr char32_t literal_unit( const char_type *s, literal_position p, utf32_tag ) noexcept
+{
+    return literal_code_point( s, p.octet );
+}
+
+template< typename unit_type, typename char_type, std::size_t... i >
+constexpr std::array<unit_type, sizeof...(i)> literal_transcode( const char_type *s, std::size_t size, indices<i...> )
+{
+    return { { literal_unit( s, literal_find_unit( s, 0, size, i, std::integral_constant<std::size_t, sizeof( unit_type )>( ) ),
+        std::integral_constant<std::size_t, sizeof( unit_type )>( ) )... } };
+}
+
+template< typename unit_type, std::size_t length, typename char_type >
+constexpr std::array<unit_type, length> literal_transcode( const char_type *s, std::size_t size )
+{
+    return literal_length( s, size, literal_find_invalid( s, size, 0, size ),
+            std::integral_constant<std::size_t, sizeof( unit_type )>( ) ) == length
+        ? literal_transcode<unit_type>( s, size, typename make_indices<length>::type( ) )
+        : throw std::invalid_argument( "The length doesn't match the utf-8 literal" );
+}
+} // namespace utf8::detail
+
+// The number of code units a UTF-8 literal decodes to. An invalid literal
+// throws invalid_utf8, which turns a constant expression into a compile
+// error.
+template< typename char_type, std::size_t n >
+constexpr std::size_t static_utf16_length( const char_type( &literal )[n] )
+{
+    return detail::literal_length( literal, n - 1, detail::literal_find_invalid( literal, n - 1, 0, n - 1 ),
+        detail::utf16_tag( ) );
+}
+
+template< typename char_type, std::size_t n >
+constexpr std::size_t static_utf32_length( const char_type( &literal )[n] )
+{
+    return detail::literal_length( literal, n - 1, detail::literal_find_invalid( literal, n - 1, 0, n - 1 ),
+        detail::utf32_tag( ) );
+}
+
+// Transcode a UTF-8 literal at compile time, length has to be the one
+// returned by the functions above. The arrays aren't null terminated. Use
+// the macros below or, with C++20, utf8::static_u16<"..."> in order to
+// avoid spelling the literal twice.
+template< std::size_t length, typename char_type, std::size_t n >
+constexpr std::array<char16_t, length> static_utf8to16( const char_type( &literal )[n] )
+{
+    return detail::literal_transcode<char16_t, length>( literal, n - 1 );
+}
+
+template< std::size_t length, typename char_type, std::size_t n >
+constexpr std::array<char32_t, length> static_utf8to32( const char_type( &literal )[n] )
+{
+    return detail::literal_transcode<char32_t, length>( literal, n - 1 );
+}
+
+#define UTF8_STATIC_U16( literal ) ::utf8::static_utf8to16< ::utf8::static_utf16_length( literal )>( literal )
+#define UTF8_STATIC_U32( literal ) ::utf8::static_utf8to32< ::utf8::static_utf32_length( literal )>( literal )
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+namespace detail
+{
+// a literal as a template argument
+template< typename char_type, std::size_t n >
+struct literal_string
+{
+    constexpr literal_string( const char_type( &literal )[n] ) noexcept
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            value[i] = literal[i];
+    }
+
+    char_type value[n] = { };
+};
+} // namespace utf8::detail
+
+template< detail::literal_string literal >
+constexpr std::array<char16_t, static_utf16_length( literal.value )> static_u16 =
+    static_utf8to16<static_utf16_length( literal.value )>( literal.value );
+
+template< detail::literal_string literal >
+constexpr std::array<char32_t, static_utf32_length( literal.value )> static_u32 =
+    static_utf8to32<static_utf32_length( literal.value )>( literal.value );
+#endif
+}
@@ -0,0 +1,343 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "checked.h"
+#include "unchecked.h"
+
+namespace utf8
+{
+namespace detail
+{
+// Appends the offset of every interval-th code point to samples and returns
+// the number of code points.
+template< typename octet_iterator >
+std::size_t build_offset_index( octet_iterator start, octet_iterator end, std::size_t interval,
+    std::vector<std::size_t> &samples, std::false_type )
+{
+    std::size_t count = 0;
+    std::size_t next = 0;
+    for (std::size_t offset = 0; start != end; ++start, ++offset)
+    {
+        if (!is_trail( *start ) && count++ == next)
+        {
+            samples.push_back( offset );
+            next += interval;
+        }
+    }
+    return count;
+}
+
+// Moves it, which points to a lead, over n code points and returns the
+// number of code points which didn't fit into [it, end).
+inline std::size_t skip_code_points( const uint8_t *&it, const uint8_t *const end, std::size_t n ) noexcept
+{
+    // The next n octets contain at most n leads, i.e. the lead of the target
+    // isn't among them.
+    while (n > 64 && it != end)
+    {
+        const std::size_t length = std::min<std::size_t>( n, end - it );
+        n -= simd::count_utf8<false>( it, it + length );
+        it += length;
+    }
+    for (; end - it >= 8; it += 8)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        // the most significant bit of every continuation octet
+        const uint64_t trails = w & ~(w << 1) & 0x8080808080808080u;
+        const std::size_t leads = 8 - static_cast<std::size_t>(((trails >> 7) * 0x0101010101010101u) >> 56);
+        if (leads > n)
+        {
+            break;
+        }
+        n -= leads;
+    }
+    for (; it != end; ++it)
+    {
+        if (!is_trail( *it ))
+        {
+            if (n == 0)
+            {
+                return 0;
+            }
+            --n;
+        }
+    }
+    return n;
+}
+
+inline std::size_t build_offset_index( const uint8_t *const first, const uint8_t *const last, std::size_t interval,
+    std::vector<std::size_t> &samples )
+{
+    const uint8_t *pos = first;
+    std::size_t missing = 0;
+    while (pos != last)
+    {
+        samples.push_back( static_cast<std::size_t>(pos - first) );
+        missing = skip_code_points( pos, last, interval );
+    }
+    return samples.size( ) * interval - missing;
+}
+
+template< typename octet_iterator >
+std::size_t build_offset_index( octet_iterator start, octet_iterator end, std::size_t interval,
+    std::vector<std::size_t> &samples, std::true_type )
+{
+    if (start == end)
+    {
+        return 0;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    return build_offset_index( first, first + (end - start), interval, samples );
+}
+
+// moves it over n code points, there are available octets behind it
+template< typename octet_iterator >
+void skip_indexed( octet_iterator &it, std::size_t n, std::size_t, std::false_type )
+{
+    utf8::unchecked::advance( it, n );
+}
+
+template< typename octet_iterator >
+void skip_indexed( octet_iterator &it, std::size_t n, std::size_t available, std::true_type )
+{
+    if (n == 0)
+    {
+        return;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( it );
+    const uint8_t *pos = first;
+    skip_code_points( pos, first + available, n );
+    it += pos - first;
+}
+
+// LEB128, i.e. 7 bits per octet starting with the least significant ones
+template< typename octet_iterator >
+octet_iterator write_varint( std::uint64_t value, octet_iterator out )
+{
+    for (; value >= 0x80; value >>= 7)
+    {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+template< typename octet_iterator >
+std::uint64_t read_varint( octet_iterator &it, octet_iterator end )
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; it != end && shift < 64; shift += 7)
+    {
+        const uint8_t octet = static_cast<uint8_t>(*it++);
+        value |= static_cast<std::uint64_t>(octet & 0x7f) << shift;
+        if (octet < 0x80)
+        {
+            return value;
+        }
+    }
+    throw std::invalid_argument( "Invalid utf-8 offset index data" );
+}
+} // namespace utf8::detail
+
+// Maps code point indices to octet offsets and back for one immutable UTF-8
+// buffer. The offset of every interval-th code point is sampled, so a lookup
+// is a table access or binary search followed by a scan over less than
+// interval code points. The index doesn't reference the buffer, the same
+// buffer has to be passed to the queries.
+class offset_index
+{
+public:
+    static const std::size_t default_interval = 64;
+
+    offset_index( )
+        : sample_interval( default_interval )
+        , num_octets( 0 )
+        , num_code_points( 0 )
+    {
+    }
+
+    // Builds the index in one pass, throws invalid_utf8 for invalid input.
+    template< typename octet_iterator >
+    offset_index( octet_iterator start, octet_iterator end, std::size_t interval = default_interval )
+        : sample_interval( interval )
+        , num_octets( static_cast<std::size_t>(std::distance( start, end )) )
+        , num_code_points( 0 )
+    {
+        if (interval == 0)
+            throw std::invalid_argument( "The utf-8 offset index interval must not be 0" );
+
+        const octet_iterator invalid = utf8::find_invalid( start, end );
+        if (invalid != end)
+            throw invalid_utf8( static_cast<uint8_t>(*invalid) );
+
+        samples.reserve( num_octets / interval + 1 );
+        num_code_points = detail::build_offset_index( start, end, interval, samples,
+            detail::is_contiguous<octet_iterator, 1>( ) );
+    }
+
+    std::size_t interval( ) const noexcept
+    {
+        return sample_interval;
+    }
+
+    // the size of the indexed buffer
+    std::size_t octets( ) const noexcept
+    {
+        return num_octets;
+    }
+
+    std::size_t code_points( ) const noexcept
+    {
+        return num_code_points;
+    }
+
+    // the offset of code point n, code_points( ) maps to octets( )
+    template< typename octet_iterator >
+    std::size_t offset( octet_iterator start, std::size_t n ) const
+    {
+        return static_cast<std::size_t>(std::distance( start, advance( start, n ) ));
+    }
+
+    // the index of the code point starting at offset (or containing it)
+    template< typename octet_iterator >
+    std::size_t index( octet_iterator start, std::size_t offset ) const
+    {
+        if (offset > num_octets)
+            throw std::out_of_range( "Invalid utf-8 octet offset" );
+        if (offset == num_octets)
+            return num_code_points;
+
+        const std::size_t k = static_cast<std::size_t>(
+            std::upper_bound( samples.begin( ), samples.end( ), offset ) - samples.begin( )) - 1;
+        std::advance( start, samples[k] );
+        octet_iterator pos = start;
+        std::advance( pos, offset - samples[k] );
+        // a position within a sequence belongs to the preceding lead
+        return k * sample_interval + static_cast<std::size_t>(utf8::unchecked::distance( start, pos ))
+            - (detail::is_trail( *pos ) ? 1 : 0);
+    }
+
+    // moves start, the beginning of the indexed buffer, to code point n
+    template< typename octet_iterator >
+    octet_iterator advance( octet_iterator start, std::size_t n ) const
+    {
+        if (n > num_code_points)
+            throw std::out_of_range( "Invalid utf-8 code point index" );
+        if (n == num_code_points)
+        {
+            std::advance( start, num_octets );
+            return start;
+        }
+        const std::size_t sample = samples[n / sample_interval];
+        std::advance( start, sample );
+        detail::skip_indexed( start, n % sample_interval, num_octets - sample,
+            detail::is_contiguous<octet_iterator, 1>( ) );
+        return start;
+    }
+
+    // the number of code points in front of pos
+    template< typename octet_iterator >
+    std::size_t distance( octet_iterator start, octet_iterator pos ) const
+    {
+        return index( start, static_cast<std::size_t>(std::distance( start, pos )) );
+    }
+
+    // the code points [pos, pos + count) of str, which has been indexed
+    template< typename string_type >
+    string_type substr( const string_type &str, std::size_t pos, std::size_t count = string_type::npos ) const
+    {
+        const auto first = advance( str.begin( ), pos );
+        const auto last = count < num_code_points - pos ? advance( str.begin( ), pos + count ) : str.end( );
+        return string_type( first, last );
+    }
+
+    // Writes the index as a sequence of octets: a 4 octet signature followed
+    // by the interval, the size of the buffer, the number of code points and
+    // the differences between successive samples as LEB128 numbers.
+    template< typename octet_iterator >
+    octet_iterator serialize( octet_iterator out ) const
+    {
+        out = std::copy( signature( ), signature( ) + 4, out );
+        out = detail::write_varint( sample_interval, out );
+        out = detail::write_varint( num_octets, out );
+        out = detail::write_varint( num_code_points, out );
+        std::size_t previous = 0;
+        for (std::size_t sample : samples)
+        {
+            out = detail::write_varint( sample - previous, out );
+            previous = sample;
+        }
+        return out;
+    }
+
+    // Reads a serialized index, throws std::invalid_argument for malformed
+    // data.
+    template< typename octet_iterator >
+    static offset_index deserialize( octet_iterator start, octet_iterator end )
+    {
+        for (const uint8_t *octet = signature( ); octet != signature( ) + 4; ++octet)
+        {
+            if (start == end || static_cast<uint8_t>(*start++) != *octet)
+                throw std::invalid_argument( "Invalid utf-8 offset index data" );
+        }
+
+        offset_index index;
+        index.sample_interval = static_cast<std::size_t>(detail::read_varint( start, end ));
+        index.num_octets = static_cast<std::size_t>(detail::read_varint( start, end ));
+        index.num_code_points = static_cast<std::size_t>(detail::read_varint( start, end ));
+        if (index.sample_interval == 0 || index.num_code_points > index.num_octets)
+            throw std::invalid_argument( "Invalid utf-8 offset index data" );
+
+        const std::size_t num_samples = (index.num_code_points + index.sample_interval - 1) / index.sample_interval;
+        index.samples.reserve( num_samples );
+        std::size_t sample = 0;
+        for (std::size_t i = 0; i < num_samples; ++i)
+        {
+            sample += static_cast<std::size_t>(detail::read_varint( start, end ));
+            if (sample >= index.num_octets || (i != 0 && sample <= index.samples.back( )))
+                throw std::invalid_argument( "Invalid utf-8 offset index data" );
+            index.samples.push_back( sample );
+        }
+        if (start != end)
+            throw std::invalid_argument( "Invalid utf-8 offset index data" );
+        return index;
+    }
+
+    bool operator ==( const offset_index &rhs ) const
+    {
+        return sample_interval == rhs.sample_interval && num_octets == rhs.num_octets
+            && num_code_points == rhs.num_code_points && samples == rhs.samples;
+    }
+
+    bool operator !=( const offset_index &rhs ) const
+    {
+        return !(operator ==( rhs ));
+    }
+
+private:
+    // "U8X" followed by the format version
+    static const uint8_t *signature( ) noexcept
+    {
+        static const uint8_t octets[] = { 'U', '8', 'X', 1 };
+        return octets;
+    }
+
+    std::size_t sample_interval;
+    std::size_t num_octets;
+    std::size_t num_code_points;
+    // the offset of the code points 0, interval, 2 * interval, ...
+    std::vector<std::size_t> samples;
+};
+}
@@ -0,0 +1,281 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "checked.h"
+
+// Multi-threaded variants of the checked algorithms for very large buffers.
+// This header isn't included by utf8.h, because it requires linking against
+// the platform's thread library (-pthread).
+namespace utf8
+{
+namespace detail
+{
+// The input is split into chunks of about this many octets which are handed
+// out to the threads one by one, so that every thread keeps busy until the
+// end. Smaller inputs are processed by the calling thread.
+const std::size_t parallel_chunk_size = std::size_t( 1 ) << 20;
+
+struct parallel_chunk
+{
+    const uint8_t *begin;
+    const uint8_t *end;
+    // the first invalid sequence or end
+    const uint8_t *invalid;
+    // the output length if the chunk is valid
+    std::size_t length;
+};
+
+// Every chunk starts at a sequence boundary, so it is validated and decoded
+// exactly like the whole input.
+inline std::vector<parallel_chunk> split_chunks( const uint8_t *it, const uint8_t *end )
+{
+    std::vector<parallel_chunk> chunks;
+    chunks.reserve( static_cast<std::size_t>(end - it) / parallel_chunk_size + 1 );
+    while (it != end)
+    {
+        const uint8_t *chunk_end = end;
+        if (static_cast<std::size_t>(end - it) >= 2 * parallel_chunk_size)
+        {
+            chunk_end = align_to_boundary( it, it + parallel_chunk_size );
+        }
+        chunks.push_back( { it, chunk_end, chunk_end, 0 } );
+        it = chunk_end;
+    }
+    return chunks;
+}
+
+inline unsigned parallel_threads( unsigned threads )
+{
+    return threads != 0 ? threads : std::max( std::thread::hardware_concurrency( ), 1u );
+}
+
+// Calls f( i ) for every i in [0, count), the threads pull the next index
+// from a shared counter. f must not throw.
+template< typename function >
+void parallel_for( std::size_t count, unsigned threads, function f )
+{
+    std::atomic<std::size_t> next( 0 );
+    auto work = [&]( )
+    {
+        for (std::size_t i; (i = next.fetch_add( 1, std::memory_order_relaxed )) < count; )
+        {
+            f( i );
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads && i < count; ++i)
+    {
+        try
+        {
+            workers.emplace_back( work );
+        }
+        catch (const std::system_error &)
+        {
+            // the threads started so far pick up the remaining work
+            break;
+        }
+    }
+    work( );
+    for (std::thread &worker : workers)
+    {
+        worker.join( );
+    }
+}
+
+// Validates the chunks and computes the output length of the valid ones.
+// Returns the index of the first invalid chunk or chunks.size( ), chunks
+// behind an invalid one may be skipped.
+template< typename counter >
+std::size_t parallel_validate( std::vector<parallel_chunk> &chunks, unsigned threads, counter count )
+{
+    std::atomic<std::size_t> first_invalid( chunks.size( ) );
+    parallel_for( chunks.size( ), threads, [&]( std::size_t i )
+    {
+        if (i > first_invalid.load( std::memory_order_relaxed ))
+        {
+            return;
+        }
+        parallel_chunk &chunk = chunks[i];
+        chunk.invalid = find_invalid( chunk.begin, chunk.end );
+        if (chunk.invalid == chunk.end)
+        {
+            chunk.length = count( chunk.begin, chunk.end );
+            return;
+        }
+        std::size_t current = first_invalid.load( std::memory_order_relaxed );
+        while (i < current && !first_invalid.compare_exchange_weak( current, i ))
+        {
+        }
+    } );
+    return first_invalid.load( );
+}
+
+struct no_count
+{
+    std::size_t operator ()( const uint8_t *, const uint8_t * ) const noexcept
+    {
+        return 0;
+    }
+};
+
+template< bool with_four_octet_leads >
+struct count_units
+{
+    std::size_t operator ()( const uint8_t *it, const uint8_t *end ) const noexcept
+    {
+        return simd::count_utf8<with_four_octet_leads>( it, end );
+    }
+};
+
+template< typename octet_iterator >
+octet_iterator parallel_find_invalid( octet_iterator start, octet_iterator end, unsigned, std::false_type )
+{
+    return utf8::find_invalid( start, end );
+}
+
+template< typename octet_iterator >
+octet_iterator parallel_find_invalid( octet_iterator start, octet_iterator end, unsigned threads, std::true_type )
+{
+    if (static_cast<std::size_t>(end - start) < 2 * parallel_chunk_size)
+    {
+        return utf8::find_invalid( start, end );
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    std::vector<parallel_chunk> chunks = split_chunks( first, first + (end - start) );
+    const std::size_t invalid = parallel_validate( chunks, threads, no_count( ) );
+    return invalid == chunks.size( ) ? end : start + (chunks[invalid].invalid - first);
+}
+
+template< typename octet_iterator >
+typename std::iterator_traits<octet_iterator>::difference_type parallel_distance( octet_iterator first, octet_iterator last, unsigned, std::false_type )
+{
+    return utf8::distance( first, last );
+}
+
+template< typename octet_iterator >
+typename std::iterator_traits<octet_iterator>::difference_type parallel_distance( octet_iterator first, octet_iterator last, unsigned threads, std::true_type )
+{
+    typedef typename std::iterator_traits<octet_iterator>::difference_type diff_t;
+    if (!(first < last) || static_cast<std::size_t>(last - first) < 2 * parallel_chunk_size)
+    {
+        return utf8::distance( first, last );
+    }
+    const uint8_t *const begin = to_pointer<const uint8_t>( first );
+    std::vector<parallel_chunk> chunks = split_chunks( begin, begin + (last - first) );
+    const std::size_t invalid = parallel_validate( chunks, threads, count_units<false>( ) );
+
+    diff_t dist = 0;
+    for (std::size_t i = 0; i < invalid; ++i)
+    {
+        dist += static_cast<diff_t>(chunks[i].length);
+    }
+    if (invalid != chunks.size( ))
+    {
+        // throws the same exception as the serial version
+        dist += utf8::distance( first + (chunks[invalid].begin - begin), last );
+    }
+    return dist;
+}
+
+// Transcoding in parallel requires the output offset of each chunk, i.e. a
+// random access output iterator.
+template< typename octet_iterator, typename unit_iterator >
+struct parallel_transcodable
+    : std::integral_constant<bool, is_contiguous<octet_iterator, 1>::value
+        && std::is_base_of<std::random_access_iterator_tag,
+            typename std::iterator_traits<unit_iterator>::iterator_category>::value>
+{
+};
+
+template< typename unit_iterator, typename unit_size, typename octet_iterator >
+unit_iterator parallel_utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size, unsigned, std::false_type )
+{
+    return utf8_decode( start, end, result, unit_size( ), is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename unit_iterator, typename unit_size, typename octet_iterator >
+unit_iterator parallel_utf8_decode( octet_iterator start, octet_iterator end, unit_iterator result, unit_size, unsigned threads, std::true_type )
+{
+    if (static_cast<std::size_t>(end - start) < 2 * parallel_chunk_size)
+    {
+        return utf8_decode( start, end, result, unit_size( ), std::true_type( ) );
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    std::vector<parallel_chunk> chunks = split_chunks( first, first + (end - start) );
+    const std::size_t invalid = parallel_validate( chunks, threads, count_units<unit_size::value == 2>( ) );
+
+    // the chunks in front of the first invalid one are written side by side
+    std::vector<std::size_t> offsets( invalid + 1, 0 );
+    for (std::size_t i = 0; i < invalid; ++i)
+    {
+        offsets[i + 1] = offsets[i] + chunks[i].length;
+    }
+    parallel_for( invalid, threads, [&]( std::size_t i )
+    {
+        utf8_decode_valid( chunks[i].begin, chunks[i].end, result + offsets[i], unit_size( ) );
+    } );
+
+    result += offsets[invalid];
+    if (invalid != chunks.size( ))
+    {
+        // writes the valid prefix and throws the same exception as the
+        // serial version
+        result = utf8_decode( start + (chunks[invalid].begin - first), end, result, unit_size( ), std::true_type( ) );
+    }
+    return result;
+}
+} // namespace detail
+
+// The algorithms below return the same results and throw the same exceptions
+// as their serial counterparts. Contiguous input (and for the conversions a
+// random access output iterator) is processed by up to threads threads, zero
+// selects std::thread::hardware_concurrency( ). Other input is processed by
+// the calling thread.
+namespace parallel
+{
+template< typename octet_iterator >
+octet_iterator find_invalid( octet_iterator start, octet_iterator end, unsigned threads = 0 )
+{
+    return detail::parallel_find_invalid( start, end, detail::parallel_threads( threads ),
+        detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename octet_iterator >
+bool is_valid( octet_iterator start, octet_iterator end, unsigned threads = 0 )
+{
+    return parallel::find_invalid( start, end, threads ) == end;
+}
+
+template< typename octet_iterator >
+typename std::iterator_traits<octet_iterator>::difference_type distance( octet_iterator first, octet_iterator last, unsigned threads = 0 )
+{
+    return detail::parallel_distance( first, last, detail::parallel_threads( threads ),
+        detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+template< typename u16bit_iterator, typename octet_iterator >
+u16bit_iterator utf8to16( octet_iterator start, octet_iterator end, u16bit_iterator result, unsigned threads = 0 )
+{
+    return detail::parallel_utf8_decode( start, end, result, detail::utf16_tag( ),
+        detail::parallel_threads( threads ), detail::parallel_transcodable<octet_iterator, u16bit_iterator>( ) );
+}
+
+template< typename octet_iterator, typename u32bit_iterator >
+u32bit_iterator utf8to32( octet_iterator start, octet_iterator end, u32bit_iterator result, unsigned threads = 0 )
+{
+    return detail::parallel_utf8_decode( start, end, result, detail::utf32_tag( ),
+        detail::parallel_threads( threads ), detail::parallel_transcodable<octet_iterator, u32bit_iterator>( ) );
+}
+} // namespace parallel
+}
@@ -0,0 +1,1731 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// The instruction set is selected at compile time, i.e. you need to compile
+// with -mavx2 / -msse4.2 (or /arch:AVX2 on MSVC) in order to use the vectorized
+// code paths. Define UTF8_NO_SIMD in order to force the portable fallback.
+#if !defined(UTF8_NO_SIMD)
+#if defined(__AVX2__)
+#define UTF8_SIMD
+#define UTF8_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#define UTF8_SIMD
+#define UTF8_SIMD_SSE42
+#include <nmmintrin.h>
+#endif
+#if defined(UTF8_SIMD) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace utf8
+{
+namespace detail
+{
+// Kernels working on raw contiguous buffers - they neither know about
+// iterators nor about error reporting. The algorithms use them to skip over
+// the parts of the input which are trivially valid and fall back to the
+// scalar code for everything else.
+namespace simd
+{
+// Portable fallback which processes 8 octets at once in a general purpose
+// register (SWAR). It can only recognize ASCII.
+struct swar
+{
+    typedef uint64_t word;
+    static const std::ptrdiff_t width = sizeof( word );
+
+    static word load( const uint8_t *p ) noexcept
+    {
+        word w;
+        std::memcpy( &w, p, sizeof( w ) );
+        return w;
+    }
+
+    static bool is_ascii( word w ) noexcept
+    {
+        return (w & 0x8080808080808080u) == 0;
+    }
+};
+
+#if defined(UTF8_SIMD_SSE42)
+struct sse42
+{
+    typedef __m128i vector;
+    static const std::ptrdiff_t width = sizeof( vector );
+
+    static vector load( const uint8_t *p ) noexcept
+    {
+        return _mm_loadu_si128( reinterpret_cast<const __m128i *>(p) );
+    }
+
+    static vector table( const uint8_t( &t )[16] ) noexcept
+    {
+        return load( t );
+    }
+
+    static vector splat( uint8_t v ) noexcept
+    {
+        return _mm_set1_epi8( static_cast<char>(v) );
+    }
+
+    static vector zero( ) noexcept
+    {
+        return _mm_setzero_si128( );
+    }
+
+    static vector bit_or( vector l, vector r ) noexcept
+    {
+        return _mm_or_si128( l, r );
+    }
+
+    static vector bit_and( vector l, vector r ) noexcept
+    {
+        return _mm_and_si128( l, r );
+    }
+
+    static vector bit_xor( vector l, vector r ) noexcept
+    {
+        return _mm_xor_si128( l, r );
+    }
+
+    static vector sub_sat( vector l, vector r ) noexcept
+    {
+        return _mm_subs_epu8( l, r );
+    }
+
+    static vector high_nibbles( vector v ) noexcept
+    {
+        return _mm_and_si128( _mm_srli_epi16( v, 4 ), splat( 0x0F ) );
+    }
+
+    static vector low_nibbles( vector v ) noexcept
+    {
+        return _mm_and_si128( v, splat( 0x0F ) );
+    }
+
+    // the indices must be within [0, 16)
+    static vector lookup( vector tbl, vector indices ) noexcept
+    {
+        return _mm_shuffle_epi8( tbl, indices );
+    }
+
+    // shifts the last n octets of prev_input in front of input
+    template< int n >
+    static vector prev( vector input, vector prev_input ) noexcept
+    {
+        return _mm_alignr_epi8( input, prev_input, 16 - n );
+    }
+
+    static bool is_ascii( vector v ) noexcept
+    {
+        return _mm_movemask_epi8( v ) == 0;
+    }
+
+    static bool any( vector v ) noexcept
+    {
+        return _mm_testz_si128( v, v ) == 0;
+    }
+
+    // bit i is set if octet i of l and r are equal
+    static uint32_t equal( vector l, vector r ) noexcept
+    {
+        return static_cast<uint32_t>(_mm_movemask_epi8( _mm_cmpeq_epi8( l, r ) ));
+    }
+};
+#endif
+
+#if defined(UTF8_SIMD_AVX2)
+struct avx2
+{
+    typedef __m256i vector;
+    static const std::ptrdiff_t width = sizeof( vector );
+
+    static vector load( const uint8_t *p ) noexcept
+    {
+        return _mm256_loadu_si256( reinterpret_cast<const __m256i *>(p) );
+    }
+
+    static vector table( const uint8_t( &t )[16] ) noexcept
+    {
+        return _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i *>(t) ) );
+    }
+
+    static vector splat( uint8_t v ) noexcept
+    {
+        return _mm256_set1_epi8( static_cast<char>(v) );
+    }
+
+    static vector zero( ) noexcept
+    {
+        return _mm256_setzero_si256( );
+    }
+
+    static vector bit_or( vector l, vector r ) noexcept
+    {
+        return _mm256_or_si256( l, r );
+    }
+
+    static vector bit_and( vector l, vector r ) noexcept
+    {
+        return _mm256_and_si256( l, r );
+    }
+
+    static vector bit_xor( vector l, vector r ) noexcept
+    {
+        return _mm256_xor_si256( l, r );
+    }
+
+    static vector sub_sat( vector l, vector r ) noexcept
+    {
+        return _mm256_subs_epu8( l, r );
+    }
+
+    static vector high_nibbles( vector v ) noexcept
+    {
+        return _mm256_and_si256( _mm256_srli_epi16( v, 4 ), splat( 0x0F ) );
+    }
+
+    static vector low_nibbles( vector v ) noexcept
+    {
+        return _mm256_and_si256( v, splat( 0x0F ) );
+    }
+
+    // the indices must be within [0, 16), the table is duplicated per lane
+    static vector lookup( vector tbl, vector indices ) noexcept
+    {
+        return _mm256_shuffle_epi8( tbl, indices );
+    }
+
+    // shifts the last n octets of prev_input in front of input
+    template< int n >
+    static vector prev( vector input, vector prev_input ) noexcept
+    {
+        return _mm256_alignr_epi8( input, _mm256_permute2x128_si256( prev_input, input, 0x21 ), 16 - n );
+    }
+
+    static bool is_ascii( vector v ) noexcept
+    {
+        return _mm256_movemask_epi8( v ) == 0;
+    }
+
+    static bool any( vector v ) noexcept
+    {
+        return _mm256_testz_si256( v, v ) == 0;
+    }
+
+    // bit i is set if octet i of l and r are equal
+    static uint32_t equal( vector l, vector r ) noexcept
+    {
+        return static_cast<uint32_t>(_mm256_movemask_epi8( _mm256_cmpeq_epi8( l, r ) ));
+    }
+};
+#endif
+
+#if defined(UTF8_SIMD_AVX2)
+typedef avx2 native;
+#elif defined(UTF8_SIMD_SSE42)
+typedef sse42 native;
+#else
+typedef swar native;
+#endif
+
+// The number of octets processed per step by the native kernels
+const std::ptrdiff_t block_size = native::width;
+
+// Lookup based validation algorithm as described by John Keiser and Daniel
+// Lemire in "Validating UTF-8 In Less Than One Instruction Per Byte".
+// Each octet is classified together with its predecessor by three 16 entry
+// tables, the results are and'ed and every bit left marks an error.
+template< typename isa >
+class utf8_checker
+{
+    typedef typename isa::vector vector;
+
+    // 11______ 0_______ or 11______ 11______
+    static const uint8_t too_short = 1 << 0;
+    // 0_______ 10______
+    static const uint8_t too_long = 1 << 1;
+    // 11100000 100_____
+    static const uint8_t overlong_3 = 1 << 2;
+    // 11110100 1001____ .. 11111___ 101_____
+    static const uint8_t too_large = 1 << 3;
+    // 11101101 101_____
+    static const uint8_t surrogate = 1 << 4;
+    // 1100000_ 10______
+    static const uint8_t overlong_2 = 1 << 5;
+    // 11110101 1000____ .. 11111___ 1000____
+    static const uint8_t too_large_1000 = 1 << 6;
+    // 11110000 1000____
+    static const uint8_t overlong_4 = 1 << 6;
+    // 10______ 10______
+    static const uint8_t two_conts = 1 << 7;
+    // the errors which don't depend on the low nibble of the first octet
+    static const uint8_t carry = too_short | too_long | two_conts;
+
+    static vector special_cases( vector input, vector prev1 ) noexcept
+    {
+        static const uint8_t byte_1_high[16] = {
+            // 0_______ ________ <ASCII in byte 1>
+            too_long, too_long, too_long, too_long,
+            too_long, too_long, too_long, too_long,
+            // 10______ ________ <continuation in byte 1>
+            two_conts, two_conts, two_conts, two_conts,
+            // 1100____ ________ <two byte lead in byte 1>
+            too_short | overlong_2,
+            // 1101____ ________ <two byte lead in byte 1>
+            too_short,
+            // 1110____ ________ <three byte lead in byte 1>
+            too_short | overlong_3 | surrogate,
+            // 1111____ ________ <four+ byte lead in byte 1>
+            too_short | too_large | too_large_1000 | overlong_4,
+        };
+        static const uint8_t byte_1_low[16] = {
+            // ____0000 ________
+            carry | overlong_3 | overlong_2 | overlong_4,
+            // ____0001 ________
+            carry | overlong_2,
+            // ____001_ ________
+            carry,
+            carry,
+            // ____0100 ________
+            carry | too_large,
+            // ____0101 ________
+            carry | too_large | too_large_1000,
+            // ____011_ ________
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            // ____1___ ________
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            // ____1101 ________
+            carry | too_large | too_large_1000 | surrogate,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+        };
+        static const uint8_t byte_2_high[16] = {
+            // ________ 0_______ <ASCII in byte 2>
+            too_short, too_short, too_short, too_short,
+            too_short, too_short, too_short, too_short,
+            // ________ 1000____
+            too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+            // ________ 1001____
+            too_long | overlong_2 | two_conts | overlong_3 | too_large,
+            // ________ 101_____
+            too_long | overlong_2 | two_conts | surrogate | too_large,
+            too_long | overlong_2 | two_conts | surrogate | too_large,
+            // ________ 11______
+            too_short, too_short, too_short, too_short,
+        };
+
+        return isa::bit_and( isa::bit_and(
+            isa::lookup( isa::table( byte_1_high ), isa::high_nibbles( prev1 ) ),
+            isa::lookup( isa::table( byte_1_low ), isa::low_nibbles( prev1 ) ) ),
+            isa::lookup( isa::table( byte_2_high ), isa::high_nibbles( input ) ) );
+    }
+
+    // the special cases flag every continuation following another
+    // continuation, this cancels them out for the 3rd and 4th octet
+    static vector multibyte_lengths( vector input, vector prev_input, vector sc ) noexcept
+    {
+        const vector prev2 = isa::template prev<2>( input, prev_input );
+        const vector prev3 = isa::template prev<3>( input, prev_input );
+        // only 111_____ will be >= 0x80
+        const vector is_third_byte = isa::sub_sat( prev2, isa::splat( 0xE0 - 0x80 ) );
+        // only 1111____ will be >= 0x80
+        const vector is_fourth_byte = isa::sub_sat( prev3, isa::splat( 0xF0 - 0x80 ) );
+        const vector must23 = isa::bit_and( isa::bit_or( is_third_byte, is_fourth_byte ), isa::splat( 0x80 ) );
+        return isa::bit_xor( must23, sc );
+    }
+
+    // flags a block ending in the middle of a multibyte sequence
+    static vector incomplete( vector input ) noexcept
+    {
+        static const uint8_t max_array[32] = {
+            255, 255, 255, 255, 255, 255, 255, 255,
+            255, 255, 255, 255, 255, 255, 255, 255,
+            255, 255, 255, 255, 255, 255, 255, 255,
+            255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+        };
+        return isa::sub_sat( input, isa::load( max_array + 32 - isa::width ) );
+    }
+
+public:
+    utf8_checker( ) noexcept
+        : error( isa::zero( ) )
+        , prev_input( isa::zero( ) )
+        , prev_incomplete( isa::zero( ) )
+    {
+    }
+
+    void check_block( vector input ) noexcept
+    {
+        if (isa::is_ascii( input ))
+        {
+            error = isa::bit_or( error, prev_incomplete );
+            prev_incomplete = isa::zero( );
+        }
+        else
+        {
+            check_multibyte( input );
+        }
+        prev_input = input;
+    }
+
+    // Checks two consecutive blocks with a single branch on their contents,
+    // which is well predicted for text mixing ASCII with other scripts.
+    void check_blocks( vector first, vector second ) noexcept
+    {
+        if (isa::is_ascii( isa::bit_or( first, second ) ))
+        {
+            error = isa::bit_or( error, prev_incomplete );
+            prev_incomplete = isa::zero( );
+        }
+        else
+        {
+            check_multibyte( first );
+            prev_input = first;
+            check_multibyte( second );
+        }
+        prev_input = second;
+    }
+
+    // note that a sequence crossing the end of the last block isn't an error
+    bool has_error( ) const noexcept
+    {
+        return isa::any( error );
+    }
+
+private:
+    void check_multibyte( vector input ) noexcept
+    {
+        const vector prev1 = isa::template prev<1>( input, prev_input );
+        const vector sc = special_cases( input, prev1 );
+        error = isa::bit_or( error, multibyte_lengths( input, prev_input, sc ) );
+        prev_incomplete = incomplete( input );
+    }
+
+    vector error;
+    vector prev_input;
+    vector prev_incomplete;
+};
+
+// Steps back to the lead octet of a sequence which has been cut off by pos.
+// [first, pos) must be well formed except for its last sequence.
+inline const uint8_t *sequence_start( const uint8_t *first, const uint8_t *pos ) noexcept
+{
+    for (std::ptrdiff_t i = 1; i <= 3 && i <= pos - first; ++i)
+    {
+        const uint8_t oc = pos[-i];
+        if (oc < 0x80)
+        {
+            break;
+        }
+        if (oc >= 0xC0)
+        {
+            const std::ptrdiff_t length = oc >= 0xF0 ? 4 : oc >= 0xE0 ? 3 : 2;
+            return length > i ? pos - i : pos;
+        }
+    }
+    return pos;
+}
+
+// Returns the end of the longest prefix of [it, end) which the kernel could
+// prove to be valid UTF-8. The result is always a code point boundary, but
+// the caller still needs to check the rest of the range.
+inline const uint8_t *valid_prefix( const uint8_t *it, const uint8_t *end ) noexcept
+{
+#if defined(UTF8_SIMD)
+    const uint8_t *const first = it;
+    utf8_checker<native> checker;
+    // an error stops the loop in front of the pair of blocks containing it
+    for (; end - it >= 2 * native::width; it += 2 * native::width)
+    {
+        checker.check_blocks( native::load( it ), native::load( it + native::width ) );
+        if (checker.has_error( ))
+        {
+            return sequence_start( first, it );
+        }
+    }
+    for (; end - it >= native::width; it += native::width)
+    {
+        checker.check_block( native::load( it ) );
+        if (checker.has_error( ))
+        {
+            break;
+        }
+    }
+    return sequence_start( first, it );
+#else
+    while (end - it >= native::width && native::is_ascii( native::load( it ) ))
+    {
+        it += native::width;
+    }
+    return it;
+#endif
+}
+
+#if defined(UTF8_SIMD)
+// Shuffle masks which decode the complete sequences of up to three octets
+// within an 8 octet window into 16bit code units. They are indexed by the mask of the
+// octets ending a sequence, the window advances to behind the last of them.
+class utf8_decode_table
+{
+public:
+    struct entry
+    {
+        // moves the last octet of each sequence into the low and the one in
+        // front of it into the high byte of its lane
+        uint8_t tail[16];
+        // moves the lead octet of a three octet sequence into the high byte
+        uint8_t lead[16];
+        uint8_t units;
+    };
+
+    // indexed by the mask of sequence ends
+    static const entry *get( ) noexcept
+    {
+        static const utf8_decode_table instance;
+        return instance.entries;
+    }
+
+private:
+    utf8_decode_table( ) noexcept
+    {
+        for (unsigned mask = 0; mask < 256; ++mask)
+        {
+            entry &e = entries[mask];
+            std::memset( &e, 0x80, sizeof( e ) );
+            unsigned start = 0, units = 0;
+            for (unsigned i = 0; i < 8; ++i)
+            {
+                if (mask & 1u << i)
+                {
+                    // longer sequences are excluded by the caller
+                    const unsigned length = i - start + 1;
+                    e.tail[2 * units] = static_cast<uint8_t>(i);
+                    if (length > 1)
+                        e.tail[2 * units + 1] = static_cast<uint8_t>(i - 1);
+                    if (length > 2)
+                        e.lead[2 * units + 1] = static_cast<uint8_t>(i - 2);
+                    ++units;
+                    start = i + 1;
+                }
+            }
+            e.units = static_cast<uint8_t>(units);
+        }
+    }
+
+    entry entries[256];
+};
+#endif
+
+#if defined(UTF8_SIMD)
+// the number of bits required to represent v
+inline unsigned bit_width( uint32_t v ) noexcept
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    return _BitScanReverse( &index, v ) ? index + 1 : 0;
+#else
+    return v ? 32 - __builtin_clz( v ) : 0;
+#endif
+}
+
+// the index of the least significant set bit of v, v must not be 0
+inline unsigned count_trailing_zeros( uint32_t v ) noexcept
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward( &index, v );
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz( v ));
+#endif
+}
+
+// returns a mask with the bit i set if octet i of the 64 octets at p is a
+// continuation or a four octet lead respectively
+inline void classify_64( const uint8_t *p, uint64_t &continuations, uint64_t &four_octet_leads ) noexcept
+{
+    continuations = four_octet_leads = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(p + 16 * i) );
+        const __m128i is_continuation = _mm_cmpeq_epi8(
+            _mm_and_si128( input, _mm_set1_epi8( static_cast<char>(0xC0) ) ),
+            _mm_set1_epi8( static_cast<char>(0x80) ) );
+        const __m128i is_four_octet_lead = _mm_cmpeq_epi8(
+            _mm_max_epu8( input, _mm_set1_epi8( static_cast<char>(0xF0) ) ), input );
+        continuations |= static_cast<uint64_t>(_mm_movemask_epi8( is_continuation ) & 0xFFFF) << 16 * i;
+        four_octet_leads |= static_cast<uint64_t>(_mm_movemask_epi8( is_four_octet_lead ) & 0xFFFF) << 16 * i;
+    }
+}
+#endif
+
+#if defined(UTF8_SIMD)
+// stores the 8 16bit code units of units as UTF-16 or UTF-32
+template< typename unit_type >
+inline void store_8( unit_type *out, __m128i units, std::integral_constant<std::size_t, 2> ) noexcept
+{
+    _mm_storeu_si128( reinterpret_cast<__m128i *>(out), units );
+}
+
+template< typename unit_type >
+inline void store_8( unit_type *out, __m128i units, std::integral_constant<std::size_t, 4> ) noexcept
+{
+    _mm_storeu_si128( reinterpret_cast<__m128i *>(out), _mm_cvtepu16_epi32( units ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i *>(out + 4), _mm_cvtepu16_epi32( _mm_srli_si128( units, 8 ) ) );
+}
+
+// decodes the four octet sequence at p
+inline uint32_t decode_supplementary( const uint8_t *p ) noexcept
+{
+    return (p[0] & 0x07u) << 18 | (p[1] & 0x3Fu) << 12 | (p[2] & 0x3Fu) << 6 | (p[3] & 0x3Fu);
+}
+
+template< typename unit_type >
+inline unit_type *store_supplementary( unit_type *out, const uint8_t *p, std::integral_constant<std::size_t, 2> ) noexcept
+{
+    const uint32_t cp = decode_supplementary( p );
+    out[0] = static_cast<unit_type>(0xD7C0u + (cp >> 10));
+    out[1] = static_cast<unit_type>(0xDC00u | (cp & 0x3FFu));
+    return out + 2;
+}
+
+template< typename unit_type >
+inline unit_type *store_supplementary( unit_type *out, const uint8_t *p, std::integral_constant<std::size_t, 4> ) noexcept
+{
+    *out = static_cast<unit_type>(decode_supplementary( p ));
+    return out + 1;
+}
+#endif
+
+// Decodes the leading part of [it, end) to UTF-16 or UTF-32 (depending on
+// the size of unit_type) and advances both iterators past the processed
+// octets / written code units. It stops shortly before end, so the caller
+// needs to finish the range with the scalar code. [it, end) must be valid UTF-8 because the kernel writes eight
+// code units per window and relies on the following ones to overwrite the
+// surplus.
+template< typename unit_type >
+inline void utf8_decode( const uint8_t *&it, const uint8_t *end, unit_type *&out ) noexcept
+{
+    static_assert(sizeof( unit_type ) == 2 || sizeof( unit_type ) == 4,
+        "the output must consist of 16bit or 32bit code units");
+#if defined(UTF8_SIMD)
+    typedef std::integral_constant<std::size_t, sizeof( unit_type )> unit_size;
+    const utf8_decode_table::entry *const table = utf8_decode_table::get( );
+    // A block of 64 octets is decoded in windows of up to 8 octets which
+    // start at sequence boundaries. The last window may write 8 units past
+    // the end of the block, the 32 octets behind it yield at least 8 units.
+    while (end - it >= 64 + 32)
+    {
+        uint64_t continuations, four_octet_leads;
+        classify_64( it, continuations, four_octet_leads );
+        // octet i ends a sequence if octet i + 1 isn't a continuation
+        const uint64_t sequence_ends = ~(continuations >> 1
+            | static_cast<uint64_t>((it[64] & 0xC0) == 0x80) << 63);
+
+        std::ptrdiff_t pos = 0;
+        while (pos <= 64 - 8)
+        {
+            const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + pos) );
+            if (_mm_movemask_epi8( input ) == 0)
+            {
+                const __m128i zero = _mm_setzero_si128( );
+                store_8( out, _mm_unpacklo_epi8( input, zero ), unit_size( ) );
+                store_8( out + 8, _mm_unpackhi_epi8( input, zero ), unit_size( ) );
+                pos += 16;
+                out += 16;
+                continue;
+            }
+
+            unsigned window = static_cast<unsigned>(sequence_ends >> pos) & 0xFF;
+            const unsigned leads = static_cast<unsigned>(four_octet_leads >> pos) & 0xFF;
+            if (leads & 1)
+            {
+                out = store_supplementary( out, it + pos, unit_size( ) );
+                pos += 4;
+                continue;
+            }
+            // the table only covers the sequences in front of a four octet one
+            window &= (leads & (0u - leads)) - 1u;
+            if (window == 0)
+            {
+                it += pos;
+                return;
+            }
+            const utf8_decode_table::entry &e = table[window];
+            const __m128i tail = _mm_shuffle_epi8( input, _mm_loadu_si128( reinterpret_cast<const __m128i *>(e.tail) ) );
+            const __m128i lead = _mm_shuffle_epi8( input, _mm_loadu_si128( reinterpret_cast<const __m128i *>(e.lead) ) );
+            // ASCII:       0xxxxxxx 00000000
+            // two octets:  10xxxxxx 110yyyyy
+            // three octets 10xxxxxx 10yyyyyy | 00000000 1110zzzz
+            const __m128i units = _mm_or_si128( _mm_or_si128(
+                _mm_and_si128( tail, _mm_set1_epi16( 0x007F ) ),
+                _mm_srli_epi16( _mm_and_si128( tail, _mm_set1_epi16( 0x3F00 ) ), 2 ) ),
+                _mm_slli_epi16( _mm_and_si128( lead, _mm_set1_epi16( 0x0F00 ) ), 4 ) );
+            store_8( out, units, unit_size( ) );
+            // computing the advance instead of loading it from the table
+            // keeps the memory latency out of the loop carried dependency
+            pos += bit_width( window );
+            out += e.units;
+        }
+        it += pos;
+    }
+#else
+    while (end - it >= native::width && native::is_ascii( native::load( it ) ))
+    {
+        for (std::ptrdiff_t i = 0; i < native::width; ++i)
+        {
+            out[i] = static_cast<unit_type>(it[i]);
+        }
+        it += native::width;
+        out += native::width;
+    }
+#endif
+}
+
+#if !defined(UTF8_SIMD)
+// checks 4 code units at once, a lane is zero after the xor iff it contains
+// a surrogate
+inline bool has_surrogate_4( const void *p ) noexcept
+{
+    uint64_t w;
+    std::memcpy( &w, p, sizeof( w ) );
+    w = (w & 0xF800F800F800F800u) ^ 0xD800D800D800D800u;
+    return ((w - 0x0001000100010001u) & ~w & 0x8000800080008000u) != 0;
+}
+#endif
+
+// Returns the end of the longest prefix of [it, end) without unpaired
+// surrogates. The result never splits a surrogate pair.
+template< typename u16_type >
+inline const u16_type *valid_utf16_prefix( const u16_type *it, const u16_type *end ) noexcept
+{
+    static_assert(sizeof( u16_type ) == 2, "the input must consist of 16bit code units");
+#if defined(UTF8_SIMD)
+    // set if the previous block ended with a lead surrogate
+    unsigned carry = 0;
+    for (; end - it >= 8; it += 8)
+    {
+        const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+        const __m128i high_bits = _mm_and_si128( input, _mm_set1_epi16( static_cast<short>(0xFC00) ) );
+        const __m128i leads = _mm_cmpeq_epi16( high_bits, _mm_set1_epi16( static_cast<short>(0xD800) ) );
+        const __m128i trails = _mm_cmpeq_epi16( high_bits, _mm_set1_epi16( static_cast<short>(0xDC00) ) );
+        // the leads in the low, the trails in the high byte
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8( _mm_packs_epi16( leads, trails ) ));
+        if (mask == 0 && carry == 0)
+        {
+            continue;
+        }
+        // every trail surrogate must follow a lead surrogate and vice versa
+        if ((mask >> 8) != ((mask << 1 | carry) & 0xFF))
+        {
+            break;
+        }
+        carry = mask >> 7 & 1;
+    }
+    return it - carry;
+#else
+    for (; it != end; ++it)
+    {
+        while (end - it >= 4 && !has_surrogate_4( it ))
+        {
+            it += 4;
+        }
+        if (it == end)
+        {
+            break;
+        }
+        const unsigned high_bits = static_cast<uint16_t>(*it) & 0xFC00u;
+        if (high_bits == 0xD800u)
+        {
+            if (end - it < 2 || (static_cast<uint16_t>(it[1]) & 0xFC00u) != 0xDC00u)
+            {
+                break;
+            }
+            ++it;
+        }
+        else if (high_bits == 0xDC00u)
+        {
+            break;
+        }
+    }
+    return it;
+#endif
+}
+
+#if defined(UTF8_SIMD)
+// Shuffle masks which compress 8 code units below U+0800 laid out as
+// [lead, trail] pairs, indexed by the mask of the two octet ones.
+class utf16to8_2_table
+{
+public:
+    struct entry
+    {
+        uint8_t shuffle[16];
+        uint8_t octets;
+    };
+
+    static const entry *get( ) noexcept
+    {
+        static const utf16to8_2_table instance;
+        return instance.entries;
+    }
+
+private:
+    utf16to8_2_table( ) noexcept
+    {
+        for (unsigned mask = 0; mask < 256; ++mask)
+        {
+            entry &e = entries[mask];
+            std::memset( &e, 0x80, sizeof( e ) );
+            unsigned octets = 0;
+            for (unsigned i = 0; i < 8; ++i)
+            {
+                e.shuffle[octets++] = static_cast<uint8_t>(2 * i);
+                if (mask & 1u << i)
+                    e.shuffle[octets++] = static_cast<uint8_t>(2 * i + 1);
+            }
+            e.octets = static_cast<uint8_t>(octets);
+        }
+    }
+
+    entry entries[256];
+};
+
+// Shuffle masks which compress 4 BMP code units encoded into the first three
+// octets of their 32bit lanes. Bit i of the index is set if unit i needs at
+// least two octets and bit i + 4 if it needs three.
+class utf16to8_3_table
+{
+public:
+    struct entry
+    {
+        uint8_t shuffle[16];
+        uint8_t octets;
+    };
+
+    static const entry *get( ) noexcept
+    {
+        static const utf16to8_3_table instance;
+        return instance.entries;
+    }
+
+private:
+    utf16to8_3_table( ) noexcept
+    {
+        for (unsigned mask = 0; mask < 256; ++mask)
+        {
+            entry &e = entries[mask];
+            std::memset( &e, 0x80, sizeof( e ) );
+            unsigned octets = 0;
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                const unsigned length = 1 + (mask >> i & 1) + (mask >> (i + 4) & 1);
+                for (unsigned j = 0; j < length; ++j)
+                    e.shuffle[octets++] = static_cast<uint8_t>(4 * i + j);
+            }
+            e.octets = static_cast<uint8_t>(octets);
+        }
+    }
+
+    entry entries[256];
+};
+
+// encodes the 4 BMP code units in the 32bit lanes of units to UTF-8
+template< typename octet_type >
+inline void utf16to8_bmp4( __m128i units, octet_type *&out, const utf16to8_3_table::entry *table ) noexcept
+{
+    const __m128i mask_3f = _mm_set1_epi32( 0x3F );
+    // 1110zzzz 10yyyyyy 10xxxxxx
+    const __m128i three = _mm_or_si128( _mm_or_si128(
+        _mm_or_si128( _mm_srli_epi32( units, 12 ), _mm_set1_epi32( 0x8080E0 ) ),
+        _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( units, 6 ), mask_3f ), 8 ) ),
+        _mm_slli_epi32( _mm_and_si128( units, mask_3f ), 16 ) );
+    // 110yyyyy 10xxxxxx
+    const __m128i two = _mm_or_si128( _mm_or_si128(
+        _mm_srli_epi32( units, 6 ), _mm_set1_epi32( 0x80C0 ) ),
+        _mm_slli_epi32( _mm_and_si128( units, mask_3f ), 8 ) );
+    const __m128i needs_two = _mm_cmpgt_epi32( units, _mm_set1_epi32( 0x7F ) );
+    const __m128i needs_three = _mm_cmpgt_epi32( units, _mm_set1_epi32( 0x7FF ) );
+    const __m128i encoded = _mm_blendv_epi8( _mm_blendv_epi8( units, two, needs_two ), three, needs_three );
+
+    const unsigned index = static_cast<unsigned>(_mm_movemask_ps( _mm_castsi128_ps( needs_two ) )
+        | _mm_movemask_ps( _mm_castsi128_ps( needs_three ) ) << 4);
+    const utf16to8_3_table::entry &e = table[index];
+    _mm_storeu_si128( reinterpret_cast<__m128i *>(out),
+        _mm_shuffle_epi8( encoded, _mm_loadu_si128( reinterpret_cast<const __m128i *>(e.shuffle) ) ) );
+    out += e.octets;
+}
+#endif
+
+// Transcodes the leading part of [it, end) to UTF-8 and advances both
+// iterators past the processed code units / written octets. It stops in
+// front of surrogate pairs and shortly before end, so the caller needs to
+// finish the range with the scalar code. [it, end) must be valid UTF-16
+// because the kernel writes 16 octets per step and relies on the following
+// ones to overwrite the surplus.
+template< typename u16_type, typename octet_type >
+inline void utf16to8( const u16_type *&it, const u16_type *end, octet_type *&out ) noexcept
+{
+    static_assert(sizeof( u16_type ) == 2, "the input must consist of 16bit code units");
+    static_assert(sizeof( octet_type ) == 1, "the output must consist of octets");
+#if defined(UTF8_SIMD)
+    const utf16to8_2_table::entry *const table2 = utf16to8_2_table::get( );
+    const utf16to8_3_table::entry *const table3 = utf16to8_3_table::get( );
+    // a step writes at most 12 octets of surplus which are overwritten by
+    // the following 16 code units
+    while (end - it >= 8 + 16)
+    {
+        const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+        const __m128i zero = _mm_setzero_si128( );
+        const __m128i ascii = _mm_cmpeq_epi16( _mm_and_si128( input, _mm_set1_epi16( static_cast<short>(0xFF80) ) ), zero );
+        if (_mm_movemask_epi8( ascii ) == 0xFFFF)
+        {
+            _mm_storel_epi64( reinterpret_cast<__m128i *>(out), _mm_packus_epi16( input, input ) );
+            it += 8;
+            out += 8;
+            continue;
+        }
+
+        const __m128i two_octets = _mm_cmpeq_epi16( _mm_and_si128( input, _mm_set1_epi16( static_cast<short>(0xF800) ) ), zero );
+        if (_mm_movemask_epi8( two_octets ) == 0xFFFF)
+        {
+            // 110yyyyy 10xxxxxx
+            const __m128i encoded = _mm_or_si128( _mm_or_si128(
+                _mm_srli_epi16( input, 6 ), _mm_set1_epi16( static_cast<short>(0x80C0) ) ),
+                _mm_slli_epi16( _mm_and_si128( input, _mm_set1_epi16( 0x3F ) ), 8 ) );
+            const __m128i units = _mm_blendv_epi8( encoded, input, ascii );
+            const unsigned index = static_cast<unsigned>(_mm_movemask_epi8( _mm_packs_epi16( ascii, zero ) )) ^ 0xFF;
+            const utf16to8_2_table::entry &e = table2[index];
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out),
+                _mm_shuffle_epi8( units, _mm_loadu_si128( reinterpret_cast<const __m128i *>(e.shuffle) ) ) );
+            it += 8;
+            out += e.octets;
+            continue;
+        }
+
+        const __m128i surrogates = _mm_cmpeq_epi16(
+            _mm_and_si128( input, _mm_set1_epi16( static_cast<short>(0xF800) ) ),
+            _mm_set1_epi16( static_cast<short>(0xD800) ) );
+        if (_mm_movemask_epi8( surrogates ) != 0)
+        {
+            break;
+        }
+        utf16to8_bmp4( _mm_unpacklo_epi16( input, zero ), out, table3 );
+        utf16to8_bmp4( _mm_unpackhi_epi16( input, zero ), out, table3 );
+        it += 8;
+    }
+#else
+    // 4 ASCII code units per step
+    while (end - it >= 4)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        if ((w & 0xFF80FF80FF80FF80u) != 0)
+        {
+            break;
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            out[i] = static_cast<octet_type>(it[i]);
+        }
+        it += 4;
+        out += 4;
+    }
+#endif
+}
+
+// Returns the end of the longest prefix of [it, end) which consists of
+// valid code points, i.e. neither surrogates nor values above U+10FFFF.
+template< typename u32_type >
+inline const u32_type *valid_utf32_prefix( const u32_type *it, const u32_type *end ) noexcept
+{
+    static_assert(sizeof( u32_type ) == 4, "the input must consist of 32bit code units");
+#if defined(UTF8_SIMD)
+    for (; end - it >= 16; it += 16)
+    {
+        __m128i errors = _mm_setzero_si128( );
+        for (int i = 0; i < 16; i += 4)
+        {
+            const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + i) );
+            const __m128i too_large = _mm_cmpgt_epi32( _mm_srli_epi32( input, 16 ), _mm_set1_epi32( 0x10 ) );
+            const __m128i surrogates = _mm_cmpeq_epi32(
+                _mm_and_si128( input, _mm_set1_epi32( static_cast<int>(0xFFFFF800) ) ), _mm_set1_epi32( 0xD800 ) );
+            errors = _mm_or_si128( errors, _mm_or_si128( too_large, surrogates ) );
+        }
+        if (_mm_movemask_epi8( errors ) != 0)
+        {
+            break;
+        }
+    }
+#else
+    // skips pairs of ASCII code points
+    for (; end - it >= 2; it += 2)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        if ((w & 0xFFFFFF80FFFFFF80u) != 0)
+        {
+            break;
+        }
+    }
+#endif
+    for (; it != end; ++it)
+    {
+        const uint32_t cp = static_cast<uint32_t>(*it);
+        if (cp > 0x10FFFFu || (cp & 0xFFFFF800u) == 0xD800u)
+        {
+            break;
+        }
+    }
+    return it;
+}
+
+// Transcodes the leading part of [it, end) to UTF-8 and advances both
+// iterators past the processed code points / written octets. It stops in
+// front of code points above the BMP and shortly before end, so the caller
+// needs to finish the range with the scalar code. [it, end) must be valid
+// UTF-32 because the kernel writes 16 octets per step and relies on the
+// following ones to overwrite the surplus.
+template< typename u32_type, typename octet_type >
+inline void utf32to8( const u32_type *&it, const u32_type *end, octet_type *&out ) noexcept
+{
+    static_assert(sizeof( u32_type ) == 4, "the input must consist of 32bit code units");
+    static_assert(sizeof( octet_type ) == 1, "the output must consist of octets");
+#if defined(UTF8_SIMD)
+    const utf16to8_3_table::entry *const table3 = utf16to8_3_table::get( );
+    // a step writes at most 12 octets of surplus which are overwritten by
+    // the following 12 code points
+    while (end - it >= 4 + 12)
+    {
+        const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+        const __m128i zero = _mm_setzero_si128( );
+        const __m128i not_ascii = _mm_set1_epi32( static_cast<int>(0xFFFFFF80) );
+        if (end - it >= 16 + 12)
+        {
+            const __m128i a = input;
+            const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 4) );
+            const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 8) );
+            const __m128i d = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 12) );
+            const __m128i all = _mm_or_si128( _mm_or_si128( a, b ), _mm_or_si128( c, d ) );
+            if (_mm_testz_si128( all, not_ascii ))
+            {
+                _mm_storeu_si128( reinterpret_cast<__m128i *>(out),
+                    _mm_packus_epi16( _mm_packs_epi32( a, b ), _mm_packs_epi32( c, d ) ) );
+                it += 16;
+                out += 16;
+                continue;
+            }
+        }
+        const __m128i ascii = _mm_cmpeq_epi32( _mm_and_si128( input, not_ascii ), zero );
+        if (_mm_movemask_epi8( ascii ) == 0xFFFF)
+        {
+            const __m128i packed = _mm_packus_epi16( _mm_packs_epi32( input, input ), zero );
+            const uint32_t octets = static_cast<uint32_t>(_mm_cvtsi128_si32( packed ));
+            std::memcpy( out, &octets, sizeof( octets ) );
+            it += 4;
+            out += 4;
+            continue;
+        }
+
+        const __m128i bmp = _mm_cmpeq_epi32( _mm_and_si128( input, _mm_set1_epi32( static_cast<int>(0xFFFF0000) ) ), zero );
+        if (_mm_movemask_epi8( bmp ) != 0xFFFF)
+        {
+            break;
+        }
+        utf16to8_bmp4( input, out, table3 );
+        it += 4;
+    }
+#else
+    // 2 ASCII code points per step
+    while (end - it >= 2)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        if ((w & 0xFFFFFF80FFFFFF80u) != 0)
+        {
+            break;
+        }
+        out[0] = static_cast<octet_type>(it[0]);
+        out[1] = static_cast<octet_type>(it[1]);
+        it += 2;
+        out += 2;
+    }
+#endif
+}
+
+#if defined(UTF8_SIMD)
+// Shuffle masks for 4 code units in 32bit lanes, indexed by a lane mask:
+// compress drops the lanes in the mask (trail surrogates), expand keeps the
+// low 16 bits of every lane and the high ones of the lanes in the mask
+// (surrogate pairs).
+class surrogate_table
+{
+public:
+    struct entry
+    {
+        uint8_t compress[16];
+        uint8_t expand[16];
+    };
+
+    static const entry *get( ) noexcept
+    {
+        static const surrogate_table instance;
+        return instance.entries;
+    }
+
+private:
+    surrogate_table( ) noexcept
+    {
+        for (unsigned mask = 0; mask < 16; ++mask)
+        {
+            entry &e = entries[mask];
+            std::memset( &e, 0x80, sizeof( e ) );
+            unsigned kept = 0, units = 0;
+            for (unsigned i = 0; i < 4; ++i)
+            {
+                const unsigned pair = mask >> i & 1;
+                for (unsigned j = 0; j < 4 && !pair; ++j)
+                    e.compress[4 * kept + j] = static_cast<uint8_t>(4 * i + j);
+                kept += 1 - pair;
+                for (unsigned j = 0; j < 2 + 2 * pair; ++j)
+                    e.expand[2 * units + j] = static_cast<uint8_t>(4 * i + j);
+                units += 1 + pair;
+            }
+        }
+    }
+
+    entry entries[16];
+};
+
+// the number of bits set in the 4 bit mask, computing it instead of loading
+// it from the table keeps the memory latency out of the output pointer chain
+inline unsigned bit_count_4( unsigned mask ) noexcept
+{
+    return static_cast<unsigned>(0x4332322132212110u >> (4 * mask)) & 0xF;
+}
+
+// decodes the 4 code units in the 32bit lanes of units, next holds the
+// respective following code units and trails marks the trail surrogates
+template< typename u32_type >
+inline void utf16to32_4( __m128i units, __m128i next, __m128i leads, __m128i trails, u32_type *&out,
+    const surrogate_table::entry *table ) noexcept
+{
+    const __m128i pairs = _mm_add_epi32( _mm_add_epi32( _mm_slli_epi32( units, 10 ), next ),
+        _mm_set1_epi32( static_cast<int>(0x10000u - (0xD800u << 10) - 0xDC00u) ) );
+    const __m128i decoded = _mm_blendv_epi8( units, pairs, leads );
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_ps( _mm_castsi128_ps( trails ) ));
+    _mm_storeu_si128( reinterpret_cast<__m128i *>(out),
+        _mm_shuffle_epi8( decoded, _mm_loadu_si128( reinterpret_cast<const __m128i *>(table[mask].compress) ) ) );
+    out += 4 - bit_count_4( mask );
+}
+#endif
+
+// Decodes the leading part of [it, end) to UTF-32 and advances both
+// iterators past the processed / written code units. It stops shortly
+// before end, so the caller needs to finish the range with the scalar code.
+// [it, end) must be valid UTF-16 because the kernel writes 4 code points per
+// step and relies on the following ones to overwrite the surplus.
+template< typename u16_type, typename u32_type >
+inline void utf16to32( const u16_type *&it, const u16_type *end, u32_type *&out ) noexcept
+{
+    static_assert(sizeof( u16_type ) == 2, "the input must consist of 16bit code units");
+    static_assert(sizeof( u32_type ) == 4, "the output must consist of 32bit code units");
+#if defined(UTF8_SIMD)
+    const surrogate_table::entry *const table = surrogate_table::get( );
+    const u16_type *const first = it;
+    // the surrogate path reads one code unit behind the 8 it processes
+    while (end - it >= 16 + 1)
+    {
+        const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+        const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 8) );
+        const __m128i high_bits = _mm_set1_epi16( static_cast<short>(0xF800) );
+        const __m128i surrogates = _mm_set1_epi16( static_cast<short>(0xD800) );
+        const __m128i found = _mm_or_si128(
+            _mm_cmpeq_epi16( _mm_and_si128( a, high_bits ), surrogates ),
+            _mm_cmpeq_epi16( _mm_and_si128( b, high_bits ), surrogates ) );
+        if (_mm_movemask_epi8( found ) == 0)
+        {
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out), _mm_cvtepu16_epi32( a ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out + 4), _mm_cvtepu16_epi32( _mm_srli_si128( a, 8 ) ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out + 8), _mm_cvtepu16_epi32( b ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out + 12), _mm_cvtepu16_epi32( _mm_srli_si128( b, 8 ) ) );
+            it += 16;
+            out += 16;
+            continue;
+        }
+
+        // Decodes the first 8 code units. A pair which starts with the last
+        // one is decoded completely and its trail surrogate is dropped by
+        // the next step like all other trail surrogates.
+        const __m128i next = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 1) );
+        const __m128i kind = _mm_and_si128( a, _mm_set1_epi16( static_cast<short>(0xFC00) ) );
+        const __m128i leads = _mm_cmpeq_epi16( kind, surrogates );
+        const __m128i trails = _mm_cmpeq_epi16( kind, _mm_set1_epi16( static_cast<short>(0xDC00) ) );
+        utf16to32_4( _mm_cvtepu16_epi32( a ), _mm_cvtepu16_epi32( next ),
+            _mm_cvtepi16_epi32( leads ), _mm_cvtepi16_epi32( trails ), out, table );
+        utf16to32_4( _mm_cvtepu16_epi32( _mm_srli_si128( a, 8 ) ), _mm_cvtepu16_epi32( _mm_srli_si128( next, 8 ) ),
+            _mm_cvtepi16_epi32( _mm_srli_si128( leads, 8 ) ), _mm_cvtepi16_epi32( _mm_srli_si128( trails, 8 ) ), out, table );
+        it += 8;
+    }
+    // skips the trail surrogate of a pair decoded by the last step
+    if (it != first && (static_cast<uint16_t>(it[-1]) & 0xFC00u) == 0xD800u)
+    {
+        ++it;
+    }
+#else
+    for (; end - it >= 4 && !has_surrogate_4( it ); it += 4, out += 4)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out[i] = static_cast<u32_type>(static_cast<uint16_t>(it[i]));
+        }
+    }
+#endif
+}
+
+// Encodes the leading part of [it, end) to UTF-16 and advances both
+// iterators past the processed / written code units. It stops shortly
+// before end, so the caller needs to finish the range with the scalar code.
+// [it, end) must be valid UTF-32 because the kernel writes 8 code units per
+// step and relies on the following ones to overwrite the surplus.
+template< typename u32_type, typename u16_type >
+inline void utf32to16( const u32_type *&it, const u32_type *end, u16_type *&out ) noexcept
+{
+    static_assert(sizeof( u32_type ) == 4, "the input must consist of 32bit code units");
+    static_assert(sizeof( u16_type ) == 2, "the output must consist of 16bit code units");
+#if defined(UTF8_SIMD)
+    const surrogate_table::entry *const table = surrogate_table::get( );
+    while (end - it >= 16)
+    {
+        const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+        const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 4) );
+        const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 8) );
+        const __m128i d = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 12) );
+        const __m128i all = _mm_or_si128( _mm_or_si128( a, b ), _mm_or_si128( c, d ) );
+        if (_mm_testz_si128( all, _mm_set1_epi32( static_cast<int>(0xFFFF0000) ) ))
+        {
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out), _mm_packus_epi32( a, b ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out + 8), _mm_packus_epi32( c, d ) );
+            it += 16;
+            out += 16;
+            continue;
+        }
+
+        // encodes the first 4 code points, the ones above the BMP as
+        // [lead, trail] in their lanes; the step writes at most 4 code units
+        // of surplus which are overwritten by the following 12 code points
+        const __m128i pairs = _mm_or_si128(
+            _mm_add_epi32( _mm_srli_epi32( a, 10 ), _mm_set1_epi32( 0xD7C0 ) ),
+            _mm_slli_epi32( _mm_or_si128( _mm_and_si128( a, _mm_set1_epi32( 0x3FF ) ), _mm_set1_epi32( 0xDC00 ) ), 16 ) );
+        const __m128i supplementary = _mm_cmpgt_epi32( a, _mm_set1_epi32( 0xFFFF ) );
+        const __m128i units = _mm_blendv_epi8( a, pairs, supplementary );
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_ps( _mm_castsi128_ps( supplementary ) ));
+        _mm_storeu_si128( reinterpret_cast<__m128i *>(out),
+            _mm_shuffle_epi8( units, _mm_loadu_si128( reinterpret_cast<const __m128i *>(table[mask].expand) ) ) );
+        it += 4;
+        out += 4 + bit_count_4( mask );
+    }
+#else
+    for (; end - it >= 2; it += 2, out += 2)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        if ((w & 0xFFFF0000FFFF0000u) != 0)
+        {
+            break;
+        }
+        out[0] = static_cast<u16_type>(it[0]);
+        out[1] = static_cast<u16_type>(it[1]);
+    }
+#endif
+}
+
+#if defined(UTF8_SIMD)
+// encodes the 8 Latin-1 characters in the 16bit lanes of units to UTF-8,
+// bit i of non_ascii is set if unit i needs two octets
+template< typename octet_type >
+inline void latin1to8_8( __m128i units, unsigned non_ascii, octet_type *&out, const utf16to8_2_table::entry *table ) noexcept
+{
+    // 110000yy 10xxxxxx
+    const __m128i encoded = _mm_or_si128( _mm_or_si128(
+        _mm_srli_epi16( units, 6 ), _mm_set1_epi16( static_cast<short>(0x80C0) ) ),
+        _mm_slli_epi16( _mm_and_si128( units, _mm_set1_epi16( 0x3F ) ), 8 ) );
+    const __m128i two_octets = _mm_cmpgt_epi16( units, _mm_set1_epi16( 0x7F ) );
+    const utf16to8_2_table::entry &e = table[non_ascii];
+    _mm_storeu_si128( reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8( _mm_blendv_epi8( units, encoded, two_octets ),
+        _mm_loadu_si128( reinterpret_cast<const __m128i *>(e.shuffle) ) ) );
+    out += e.octets;
+}
+
+// Shuffle masks which drop the octets in the index from 8 octets.
+class compress_8_table
+{
+public:
+    struct entry
+    {
+        uint8_t shuffle[8];
+        uint8_t octets;
+    };
+
+    static const entry *get( ) noexcept
+    {
+        static const compress_8_table instance;
+        return instance.entries;
+    }
+
+private:
+    compress_8_table( ) noexcept
+    {
+        for (unsigned mask = 0; mask < 256; ++mask)
+        {
+            entry &e = entries[mask];
+            std::memset( &e, 0x80, sizeof( e ) );
+            unsigned octets = 0;
+            for (unsigned i = 0; i < 8; ++i)
+            {
+                if (!(mask & 1u << i))
+                    e.shuffle[octets++] = static_cast<uint8_t>(i);
+            }
+            e.octets = static_cast<uint8_t>(octets);
+        }
+    }
+
+    entry entries[256];
+};
+#endif
+
+// Transcodes the leading part of the Latin-1 [it, end) to UTF-8 and advances
+// both iterators past the processed / written octets. It stops shortly
+// before end, so the caller needs to finish the range with the scalar code.
+// The kernel writes 16 octets per step and relies on the following ones to
+// overwrite the surplus.
+template< typename octet_type >
+inline void latin1to8( const uint8_t *&it, const uint8_t *end, octet_type *&out ) noexcept
+{
+    static_assert(sizeof( octet_type ) == 1, "the output must consist of octets");
+#if defined(UTF8_SIMD)
+    const utf16to8_2_table::entry *const table = utf16to8_2_table::get( );
+    // a step writes at most 8 octets of surplus which are overwritten by the
+    // following 8 characters
+    while (end - it >= 16 + 8)
+    {
+        const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+        const unsigned non_ascii = static_cast<unsigned>(_mm_movemask_epi8( input ));
+        if (non_ascii == 0)
+        {
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out), input );
+            it += 16;
+            out += 16;
+            continue;
+        }
+        latin1to8_8( _mm_cvtepu8_epi16( input ), non_ascii & 0xFF, out, table );
+        latin1to8_8( _mm_cvtepu8_epi16( _mm_srli_si128( input, 8 ) ), non_ascii >> 8, out, table );
+        it += 16;
+    }
+#else
+    // 8 ASCII characters per step
+    for (; end - it >= 8; it += 8, out += 8)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        if ((w & 0x8080808080808080u) != 0)
+        {
+            break;
+        }
+        std::memcpy( out, &w, sizeof( w ) );
+    }
+#endif
+}
+
+// Transcodes the leading part of the valid UTF-8 [it, end) to Latin-1 and
+// advances both iterators past the processed / written octets. It stops in
+// front of code points above U+00FF and shortly before end, so the caller
+// needs to finish the range with the scalar code. The kernel writes 8
+// octets per store and relies on the following ones to overwrite the
+// surplus.
+template< typename octet_type >
+inline void utf8tolatin1( const uint8_t *&it, const uint8_t *end, octet_type *&out ) noexcept
+{
+    static_assert(sizeof( octet_type ) == 1, "the output must consist of octets");
+#if defined(UTF8_SIMD)
+    const compress_8_table::entry *const table = compress_8_table::get( );
+    const uint8_t *const first = it;
+    // A step reads one octet behind the 16 it processes. 8 octets of valid
+    // input hold at least 4 characters, so a store writes at most 4 octets
+    // of surplus which are overwritten by the following 16 octets. Hence the
+    // kernel stops 16 octets in front of code points above U+00FF.
+    while (end - it >= 16 + 16)
+    {
+        const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+        if (_mm_movemask_epi8( input ) == 0)
+        {
+            _mm_storeu_si128( reinterpret_cast<__m128i *>(out), input );
+            it += 16;
+            out += 16;
+            continue;
+        }
+        // the leads of the code points above U+00FF
+        const __m128i both = _mm_max_epu8( input, _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 16) ) );
+        const __m128i beyond = _mm_cmpeq_epi8( _mm_max_epu8( both, _mm_set1_epi8( static_cast<char>(0xC4) ) ), both );
+        if (_mm_movemask_epi8( beyond ) != 0)
+        {
+            break;
+        }
+
+        // Decodes every two octet sequence at its lead, including one which
+        // starts with the last octet, and drops all continuations.
+        const __m128i next = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it + 1) );
+        // 110000yy 10xxxxxx
+        const __m128i decoded = _mm_or_si128( _mm_slli_epi16( _mm_and_si128( input, _mm_set1_epi8( 0x03 ) ), 6 ),
+            _mm_and_si128( next, _mm_set1_epi8( 0x3F ) ) );
+        const __m128i latin1 = _mm_blendv_epi8( input, decoded, input );
+        // continuations are the signed values below -64
+        const unsigned continuations = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_cmplt_epi8( input, _mm_set1_epi8( -64 ) ) ));
+        const compress_8_table::entry &low = table[continuations & 0xFF];
+        _mm_storel_epi64( reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8( latin1,
+            _mm_loadl_epi64( reinterpret_cast<const __m128i *>(low.shuffle) ) ) );
+        out += low.octets;
+        const compress_8_table::entry &high = table[continuations >> 8];
+        _mm_storel_epi64( reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8( _mm_srli_si128( latin1, 8 ),
+            _mm_loadl_epi64( reinterpret_cast<const __m128i *>(high.shuffle) ) ) );
+        out += high.octets;
+        it += 16;
+    }
+    // skips the continuation of a sequence decoded by the last step
+    if (it != first && it[-1] >= 0xC0)
+    {
+        ++it;
+    }
+#else
+    // 8 ASCII octets per step
+    for (; end - it >= 8; it += 8, out += 8)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        if ((w & 0x8080808080808080u) != 0)
+        {
+            break;
+        }
+        std::memcpy( out, &w, sizeof( w ) );
+    }
+#endif
+}
+
+#if defined(UTF8_SIMD)
+// horizontal sum of the octets in v
+inline std::size_t sum_octets( __m128i v ) noexcept
+{
+    const __m128i sums = _mm_sad_epu8( v, _mm_setzero_si128( ) );
+    return static_cast<std::size_t>(_mm_cvtsi128_si32( sums )) + static_cast<std::size_t>(_mm_extract_epi32( sums, 2 ));
+}
+
+// horizontal sum of the 32bit lanes in v
+inline std::size_t sum_lanes( __m128i v ) noexcept
+{
+    return static_cast<std::size_t>(static_cast<uint32_t>(_mm_cvtsi128_si32( v )))
+        + static_cast<uint32_t>(_mm_extract_epi32( v, 1 ))
+        + static_cast<uint32_t>(_mm_extract_epi32( v, 2 ))
+        + static_cast<uint32_t>(_mm_extract_epi32( v, 3 ));
+}
+#else
+// the number of set most significant bits of the octets in w
+inline std::size_t count_msbs( uint64_t w ) noexcept
+{
+    return static_cast<std::size_t>(((w >> 7 & 0x0101010101010101u) * 0x0101010101010101u) >> 56);
+}
+#endif
+
+// Counts the octets of [it, end) which aren't continuations and, if
+// with_four_octet_leads, adds the number of four octet leads.
+template< bool with_four_octet_leads >
+inline std::size_t count_utf8( const uint8_t *it, const uint8_t *end ) noexcept
+{
+    std::size_t count = 0;
+#if defined(UTF8_SIMD)
+    while (end - it >= 16)
+    {
+        // the octet counters saturate after 255 iterations, each of them
+        // adds at most 1 to either accumulator
+        const std::ptrdiff_t blocks = (end - it) / 16 < 255 ? (end - it) / 16 : 255;
+        const uint8_t *const stop = it + blocks * 16;
+        __m128i acc = _mm_setzero_si128( );
+        __m128i four_octet_leads = _mm_setzero_si128( );
+        for (; it != stop; it += 16)
+        {
+            const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+            // continuations are the signed values below -64
+            acc = _mm_sub_epi8( acc, _mm_cmpgt_epi8( input, _mm_set1_epi8( -65 ) ) );
+            if (with_four_octet_leads)
+            {
+                const __m128i leads = _mm_set1_epi8( static_cast<char>(0xF0) );
+                four_octet_leads = _mm_sub_epi8( four_octet_leads, _mm_cmpeq_epi8( _mm_max_epu8( input, leads ), input ) );
+            }
+        }
+        count += sum_octets( acc );
+        if (with_four_octet_leads)
+        {
+            count += sum_octets( four_octet_leads );
+        }
+    }
+#else
+    for (; end - it >= 8; it += 8)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        count += 8 - count_msbs( w & ~(w << 1) );
+        if (with_four_octet_leads)
+        {
+            count += count_msbs( w & w << 1 & w << 2 & w << 3 );
+        }
+    }
+#endif
+    for (; it != end; ++it)
+    {
+        count += (*it & 0xC0) != 0x80;
+        if (with_four_octet_leads)
+        {
+            count += *it >= 0xF0;
+        }
+    }
+    return count;
+}
+
+// The counts of count_utf8 and whether [it, end) is ASCII, gathered in one
+// pass.
+struct utf8_counts
+{
+    // the octets which aren't continuations
+    std::size_t leads;
+    std::size_t four_octet_leads;
+    bool ascii;
+};
+
+inline utf8_counts measure_utf8( const uint8_t *it, const uint8_t *end ) noexcept
+{
+    utf8_counts counts = { 0, 0, true };
+#if defined(UTF8_SIMD)
+    __m128i any = _mm_setzero_si128( );
+    while (end - it >= 16)
+    {
+        // the octet counters saturate after 255 iterations
+        const std::ptrdiff_t blocks = (end - it) / 16 < 255 ? (end - it) / 16 : 255;
+        const uint8_t *const stop = it + blocks * 16;
+        __m128i leads = _mm_setzero_si128( );
+        __m128i four_octet_leads = _mm_setzero_si128( );
+        for (; it != stop; it += 16)
+        {
+            const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+            leads = _mm_sub_epi8( leads, _mm_cmpgt_epi8( input, _mm_set1_epi8( -65 ) ) );
+            four_octet_leads = _mm_sub_epi8( four_octet_leads,
+                _mm_cmpeq_epi8( _mm_max_epu8( input, _mm_set1_epi8( static_cast<char>(0xF0) ) ), input ) );
+            any = _mm_or_si128( any, input );
+        }
+        counts.leads += sum_octets( leads );
+        counts.four_octet_leads += sum_octets( four_octet_leads );
+    }
+    counts.ascii = _mm_movemask_epi8( any ) == 0;
+#else
+    uint64_t any = 0;
+    for (; end - it >= 8; it += 8)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        counts.leads += 8 - count_msbs( w & ~(w << 1) );
+        counts.four_octet_leads += count_msbs( w & w << 1 & w << 2 & w << 3 );
+        any |= w;
+    }
+    counts.ascii = (any & 0x8080808080808080u) == 0;
+#endif
+    for (; it != end; ++it)
+    {
+        counts.leads += (*it & 0xC0) != 0x80;
+        counts.four_octet_leads += *it >= 0xF0;
+        counts.ascii = counts.ascii && *it < 0x80;
+    }
+    return counts;
+}
+
+// Octet wise substring search, returns the first occurrence of the needle
+// of size (> 0) octets for which visit returns true or end. The vectorized
+// loop compares the first and the last octet of the needle with a block of
+// candidate positions at once and only compares the remaining octets of the
+// candidates matching both. The fallback and the tail search the first
+// octet with memchr.
+template< typename visitor >
+inline const uint8_t *search_octets( const uint8_t *it, const uint8_t *end, const uint8_t *needle, std::size_t size,
+    visitor visit ) noexcept
+{
+    const std::ptrdiff_t last = static_cast<std::ptrdiff_t>(size) - 1;
+#if defined(UTF8_SIMD)
+    const native::vector first_octet = native::splat( needle[0] );
+    const native::vector last_octet = native::splat( needle[last] );
+    for (; end - it >= last + native::width; it += native::width)
+    {
+        uint32_t candidates = native::equal( native::load( it ), first_octet )
+            & native::equal( native::load( it + last ), last_octet );
+        for (; candidates != 0; candidates &= candidates - 1)
+        {
+            const uint8_t *const candidate = it + count_trailing_zeros( candidates );
+            if (std::memcmp( candidate + 1, needle + 1, static_cast<std::size_t>(last) ) == 0 && visit( candidate ))
+            {
+                return candidate;
+            }
+        }
+    }
+#endif
+    for (; end - it > last; ++it)
+    {
+        it = static_cast<const uint8_t *>(std::memchr( it, needle[0], static_cast<std::size_t>((end - it) - last) ));
+        if (it == nullptr)
+        {
+            return end;
+        }
+        if (std::memcmp( it + 1, needle + 1, static_cast<std::size_t>(last) ) == 0 && visit( it ))
+        {
+            return it;
+        }
+    }
+    return end;
+}
+
+struct count_matches
+{
+    std::size_t &count;
+
+    bool operator ()( const uint8_t * ) const noexcept
+    {
+        ++count;
+        return false;
+    }
+};
+
+// The number of positions in [it, end) at which the needle of size octets
+// starts, overlapping occurrences are counted as well.
+inline std::size_t count_octets( const uint8_t *it, const uint8_t *end, const uint8_t *needle, std::size_t size ) noexcept
+{
+    std::size_t count = 0;
+    if (size != 0)
+    {
+        search_octets( it, end, needle, size, count_matches{ count } );
+    }
+    return count;
+}
+
+// Returns the length of the UTF-8 encoding of the valid UTF-16 [it, end).
+template< typename u16_type >
+inline std::size_t utf8_length_from_utf16( const u16_type *it, const u16_type *end ) noexcept
+{
+    static_assert(sizeof( u16_type ) == 2, "the input must consist of 16bit code units");
+    std::size_t count = static_cast<std::size_t>(end - it);
+#if defined(UTF8_SIMD)
+    while (end - it >= 8)
+    {
+        // each iteration adds at most 2 to the 16bit counters
+        const std::ptrdiff_t blocks = (end - it) / 8 < 8192 ? (end - it) / 8 : 8192;
+        const u16_type *const stop = it + blocks * 8;
+        __m128i acc = _mm_setzero_si128( );
+        for (; it != stop; it += 8)
+        {
+            const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+            const __m128i two_octets = _mm_cmpeq_epi16( _mm_max_epu16( input, _mm_set1_epi16( 0x80 ) ), input );
+            const __m128i three_octets = _mm_cmpeq_epi16( _mm_max_epu16( input, _mm_set1_epi16( 0x800 ) ), input );
+            // each half of a surrogate pair accounts for two octets
+            const __m128i surrogates = _mm_cmpeq_epi16( _mm_and_si128( input, _mm_set1_epi16( static_cast<short>(0xF800) ) ),
+                _mm_set1_epi16( static_cast<short>(0xD800) ) );
+            acc = _mm_add_epi16( _mm_sub_epi16( _mm_sub_epi16( acc, two_octets ), three_octets ), surrogates );
+        }
+        count += sum_lanes( _mm_madd_epi16( acc, _mm_set1_epi16( 1 ) ) );
+    }
+#endif
+    for (; it != end; ++it)
+    {
+        const uint16_t cu = static_cast<uint16_t>(*it);
+        count += (cu >= 0x80) + (cu >= 0x800) - ((cu & 0xF800) == 0xD800);
+    }
+    return count;
+}
+
+// Returns the length of the UTF-8 encoding of the valid UTF-32 [it, end).
+template< typename u32_type >
+inline std::size_t utf8_length_from_utf32( const u32_type *it, const u32_type *end ) noexcept
+{
+    static_assert(sizeof( u32_type ) == 4, "the input must consist of 32bit code units");
+    std::size_t count = static_cast<std::size_t>(end - it);
+#if defined(UTF8_SIMD)
+    while (end - it >= 4)
+    {
+        // each iteration adds at most 3 to the 32bit counters
+        const std::ptrdiff_t blocks = (end - it) / 4 < (1 << 24) ? (end - it) / 4 : (1 << 24);
+        const u32_type *const stop = it + blocks * 4;
+        __m128i acc = _mm_setzero_si128( );
+        for (; it != stop; it += 4)
+        {
+            const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+            acc = _mm_sub_epi32( acc, _mm_cmpgt_epi32( input, _mm_set1_epi32( 0x7F ) ) );
+            acc = _mm_sub_epi32( acc, _mm_cmpgt_epi32( input, _mm_set1_epi32( 0x7FF ) ) );
+            acc = _mm_sub_epi32( acc, _mm_cmpgt_epi32( input, _mm_set1_epi32( 0xFFFF ) ) );
+        }
+        count += sum_lanes( acc );
+    }
+#endif
+    for (; it != end; ++it)
+    {
+        const uint32_t cp = static_cast<uint32_t>(*it);
+        count += (cp >= 0x80) + (cp >= 0x800) + (cp >= 0x10000);
+    }
+    return count;
+}
+
+// Returns the length of the UTF-8 encoding of the Latin-1 [it, end).
+inline std::size_t utf8_length_from_latin1( const uint8_t *it, const uint8_t *end ) noexcept
+{
+    std::size_t count = static_cast<std::size_t>(end - it);
+#if defined(UTF8_SIMD)
+    while (end - it >= 16)
+    {
+        // the octet counters saturate after 255 iterations
+        const std::ptrdiff_t blocks = (end - it) / 16 < 255 ? (end - it) / 16 : 255;
+        const uint8_t *const stop = it + blocks * 16;
+        __m128i acc = _mm_setzero_si128( );
+        for (; it != stop; it += 16)
+        {
+            const __m128i input = _mm_loadu_si128( reinterpret_cast<const __m128i *>(it) );
+            acc = _mm_sub_epi8( acc, _mm_cmplt_epi8( input, _mm_setzero_si128( ) ) );
+        }
+        count += sum_octets( acc );
+    }
+#else
+    for (; end - it >= 8; it += 8)
+    {
+        uint64_t w;
+        std::memcpy( &w, it, sizeof( w ) );
+        count += count_msbs( w );
+    }
+#endif
+    for (; it != end; ++it)
+    {
+        count += *it >= 0x80;
+    }
+    return count;
+}
+} // namespace utf8::detail::simd
+} // namespace utf8::detail
+} // namespace utf8
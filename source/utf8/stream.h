@@ -0,0 +1,116 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+
+#include "checked.h"
+
+namespace utf8
+{
+// Transcodes UTF-8 which arrives in chunks of arbitrary size, e.g. from
+// successive socket reads, to UTF-16 (unit_type char16_t) or UTF-32
+// (char32_t). A sequence split between two chunks is kept in the object (at
+// most 3 octets) and completed by the next call, everything else is
+// transcoded straight from the chunk like try_utf8to16/try_utf8to32 do.
+template< typename unit_type >
+class stream_transcoder
+{
+    static_assert(sizeof( unit_type ) == 2 || sizeof( unit_type ) == 4,
+        "stream_transcoder writes either UTF-16 or UTF-32 code units");
+
+    typedef std::integral_constant<std::size_t, sizeof( unit_type )> unit_size;
+
+public:
+    stream_transcoder( ) noexcept
+        : pending_size( 0 )
+    {
+    }
+
+    // Transcodes the next chunk. On success the whole chunk has been consumed
+    // and in equals end, a trailing partial sequence is kept for the next
+    // call. Otherwise in points to the invalid sequence, or behind its octets
+    // if it started in a previous chunk, and the pending octets are dropped.
+    template< typename octet_iterator, typename u_iterator >
+    conversion_result<octet_iterator, u_iterator> decode( octet_iterator start, octet_iterator end, u_iterator result )
+    {
+        if (pending_size != 0)
+        {
+            // sequence_length( ) never exceeds 4, the min( ) only tells the
+            // compiler that the copy below stays within pending
+            const std::size_t length = std::min( detail::sequence_length<std::size_t>( pending[0] ), sizeof( pending ) );
+            assert(pending_size < length);
+            for (; pending_size < length && start != end; ++start)
+            {
+                const uint8_t octet = static_cast<uint8_t>(*start);
+                if (!detail::is_trail( octet ))
+                {
+                    break;
+                }
+                pending[pending_size++] = octet;
+            }
+            if (pending_size < length && start == end)
+            {
+                return { error_code::ok, start, result };
+            }
+
+            uint8_t *it = pending;
+            char32_t cp = 0;
+            const error_code error = pending_size < length
+                ? error_code::invalid_utf8
+                : detail::try_decode( it, pending + pending_size, cp );
+            pending_size = 0;
+            if (error != error_code::ok)
+            {
+                return { error, start, result };
+            }
+            result = detail::encode_units( cp, result, unit_size( ) );
+        }
+
+        conversion_result<octet_iterator, u_iterator> r = detail::try_utf8_decode( start, end,
+            result, unit_size( ), detail::is_contiguous<octet_iterator, 1>( ) );
+        if (r.error == error_code::not_enough_room)
+        {
+            // only the last sequence can be truncated, i.e. less than 4 octets
+            for (; r.in != end; ++r.in)
+            {
+                assert(pending_size < sizeof( pending ) - 1);
+                pending[pending_size++] = static_cast<uint8_t>(*r.in);
+            }
+            r.error = error_code::ok;
+        }
+        return r;
+    }
+
+    // Ends the stream, reports not_enough_room if it ended within a sequence.
+    // The object can be reused for the next stream afterwards.
+    error_code finish( ) noexcept
+    {
+        const bool truncated = pending_size != 0;
+        pending_size = 0;
+        return truncated ? error_code::not_enough_room : error_code::ok;
+    }
+
+    // the number of octets of an incomplete sequence carried over
+    std::size_t pending_octets( ) const noexcept
+    {
+        return pending_size;
+    }
+
+    void reset( ) noexcept
+    {
+        pending_size = 0;
+    }
+
+private:
+    uint8_t pending[4];
+    std::size_t pending_size;
+};
+
+// decodes chunked UTF-8 to code points
+typedef stream_transcoder<char32_t> stream_decoder;
+}
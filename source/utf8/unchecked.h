@@ -10,6 +10,189 @@
 
 namespace utf8
 {
+namespace detail
+{
+template< typename octet_iterator, typename u32bit_iterator >
+octet_iterator unchecked_utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result, std::false_type )
+{
+    while (start != end)
+        result = encode( *start++, result );
+
+    return result;
+}
+
+template< typename octet_iterator, typename u32bit_iterator >
+octet_iterator unchecked_utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return result;
+    }
+    typedef typename std::iterator_traits<u32bit_iterator>::value_type u32_type;
+    const u32_type *const first = to_pointer<const u32_type>( start );
+    return utf32to8_valid( first, first + (end - start), result );
+}
+
+template< typename octet_iterator, typename u32bit_iterator >
+u32bit_iterator unchecked_utf8to32( octet_iterator start, octet_iterator end, u32bit_iterator result, std::false_type )
+{
+    while (start < end)
+        *result++ = decode<err_handler::none>( start, end );
+
+    return result;
+}
+
+template< typename octet_iterator, typename u32bit_iterator >
+u32bit_iterator unchecked_utf8to32( octet_iterator start, octet_iterator end, u32bit_iterator result, std::true_type )
+{
+    if (!(start < end))
+    {
+        return result;
+    }
+    const uint8_t *const first = to_pointer<const uint8_t>( start );
+    return utf8_decode_valid( first, first + (end - start), result, utf32_tag( ) );
+}
+
+template< typename u16bit_iterator, typename u32bit_iterator >
+u32bit_iterator unchecked_utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result, std::false_type )
+{
+    while (start != end)
+        *result++ = decode_utf16<err_handler::none>( start, end );
+
+    return result;
+}
+
+template< typename u16bit_iterator, typename u32bit_iterator >
+u32bit_iterator unchecked_utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return result;
+    }
+    typedef typename std::iterator_traits<u16bit_iterator>::value_type u16_type;
+    const u16_type *const first = to_pointer<const u16_type>( start );
+    return utf16to32_valid( first, first + (end - start), result );
+}
+
+template< typename u32bit_iterator, typename u16bit_iterator >
+u16bit_iterator unchecked_utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result, std::false_type )
+{
+    while (start != end)
+        result = encode_utf16( static_cast<char32_t>(*start++), result );
+
+    return result;
+}
+
+template< typename u32bit_iterator, typename u16bit_iterator >
+u16bit_iterator unchecked_utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result, std::true_type )
+{
+    if (start == end)
+    {
+        return result;
+    }
+    typedef typename std::iterator_traits<u32bit_iterator>::value_type u32_type;
+    const u32_type *const first = to_pointer<const u32_type>( start );
+    return utf32to16_valid( first, first + (end - start), result );
+}
+
+template< typename octet_iterator, typename latin1_iterator >
+latin1_iterator unchecked_utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result, std::false_type )
+{
+    while (start < end)
+        *result++ = static_cast<uint8_t>(decode<err_handler::none>( start, end ));
+
+    return result;
+}
+
+template< typename octet_iterator, typename latin1_iterator >
+latin1_iterator unchecked_utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result, std::true_type )
+{
+    if (!(start < end))
+    {
+        return result;
+    }
+    const uint8_t *it = to_pointer<const uint8_t>( start );
+    return utf8tolatin1_valid( it, it + (end - start), result );
+}
+
+template< typename octet_iterator, typename distance_type >
+void unchecked_advance( octet_iterator &it, distance_type n, std::false_type )
+{
+    for (distance_type i = 0; i < n; ++i)
+        decode<err_handler::none>( it, octet_iterator( ) );
+}
+
+template< typename octet_iterator, typename distance_type >
+void unchecked_advance( octet_iterator &it, distance_type n, std::true_type )
+{
+    if (!(n > 0))
+    {
+        return;
+    }
+    std::size_t count = static_cast<std::size_t>(n);
+    const uint8_t *const first = to_pointer<const uint8_t>( it );
+    const uint8_t *pos = first;
+    // Every code point takes at least one octet, so the next count - 1 octets
+    // lie in front of the target and it suffices to count their leads.
+    // Neither this nor the rest reads beyond the target.
+    while (count > 64)
+    {
+        const std::size_t length = count - 1;
+        count -= simd::count_utf8<false>( pos, pos + length );
+        pos += length;
+    }
+    // pos may point into a sequence whose lead has been counted already
+    while (is_trail( *pos ))
+    {
+        ++pos;
+    }
+    for (; count > 0; --count)
+    {
+        pos += sequence_length<std::ptrdiff_t>( *pos );
+    }
+    it += pos - first;
+}
+
+template< typename octet_iterator, typename distance_type >
+void unchecked_retreat( octet_iterator &it, distance_type n, std::false_type )
+{
+    for (distance_type i = 0; i < n; ++i)
+    {
+        while (is_trail( *--it ))
+        {
+        }
+    }
+}
+
+template< typename octet_iterator, typename distance_type >
+void unchecked_retreat( octet_iterator &it, distance_type n, std::true_type )
+{
+    if (!(n > 0))
+    {
+        return;
+    }
+    std::size_t count = static_cast<std::size_t>(n);
+    const uint8_t *const first = to_pointer<const uint8_t>( it );
+    const uint8_t *pos = first;
+    // The count code points in front of pos take at least count octets, so
+    // it suffices to count the leads of the last count octets. pos may end
+    // up inside a sequence whose lead hasn't been counted yet.
+    while (count > 64)
+    {
+        const std::size_t length = count;
+        count -= simd::count_utf8<false>( pos - length, pos );
+        pos -= length;
+    }
+    for (; count > 0; --count)
+    {
+        while (is_trail( *--pos ))
+        {
+        }
+    }
+    it -= first - pos;
+}
+} // namespace utf8::detail
+
 namespace unchecked
 {
 template< typename octet_iterator >
@@ -23,7 +206,7 @@ inline char32_t next( octet_iterator &it )
 {
     typedef octet_iterator iterator_t;
     using namespace utf8::detail;
-    switch (sequence_length<int>( *it ))
+    switch (dispatch_length<int>( *it ))
     {
     case 1:
         return get_sequence<1, err_handler::none>( it, iterator_t( ) );
@@ -53,20 +236,31 @@ inline uint32_t previous( octet_iterator &it )
     return peek_next( it );
 }
 
+// Contiguous input is skipped by counting the leads instead of decoding.
 template< typename octet_iterator, typename distance_type >
 void advance( octet_iterator &it, distance_type n )
 {
-    for (distance_type i = 0; i < n; ++i)
-        utf8::unchecked::next( it );
+    detail::unchecked_advance( it, n, detail::is_contiguous<octet_iterator, 1>( ) );
+}
+
+// Steps back by n code points, contiguous input is counted backwards like
+// advance counts forwards.
+template< typename octet_iterator, typename distance_type >
+void retreat( octet_iterator &it, distance_type n )
+{
+    detail::unchecked_retreat( it, n, detail::is_contiguous<octet_iterator, 1>( ) );
 }
 
+// Counts the octets which aren't continuations instead of decoding.
 template< typename octet_iterator >
 typename std::iterator_traits<octet_iterator>::difference_type distance( octet_iterator first, octet_iterator last )
 {
-    typename std::iterator_traits<octet_iterator>::difference_type dist;
-    for (dist = 0; first < last; ++dist)
-        utf8::unchecked::next( first );
-    return dist;
+    typedef typename std::iterator_traits<octet_iterator>::difference_type diff_t;
+    if (!(first < last))
+    {
+        return 0;
+    }
+    return static_cast<diff_t>(utf8::utf32_length_from_utf8( first, last ));
 }
 
 template< typename u16bit_iterator, typename octet_iterator >
@@ -104,22 +298,45 @@ u16bit_iterator utf8to16( octet_iterator start, octet_iterator end, u16bit_itera
     return result;
 }
 
+// Contiguous input is transcoded by the kernels from simd.h.
 template< typename octet_iterator, typename u32bit_iterator >
 octet_iterator utf32to8( u32bit_iterator start, u32bit_iterator end, octet_iterator result )
 {
-    while (start != end)
-        result = append( *start++, result );
-
-    return result;
+    return detail::unchecked_utf32to8( start, end, result, detail::is_contiguous<u32bit_iterator, 4>( ) );
 }
 
+// Contiguous input is transcoded by the kernels from simd.h.
 template< typename octet_iterator, typename u32bit_iterator >
 u32bit_iterator utf8to32( octet_iterator start, octet_iterator end, u32bit_iterator result )
 {
-    while (start < end)
-        *result++ = utf8::unchecked::next( start );
+    return detail::unchecked_utf8to32( start, end, result, detail::is_contiguous<octet_iterator, 1>( ) );
+}
 
-    return result;
+// Contiguous input is transcoded by the kernels from simd.h.
+template< typename u16bit_iterator, typename u32bit_iterator >
+u32bit_iterator utf16to32( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result )
+{
+    return detail::unchecked_utf16to32( start, end, result, detail::is_contiguous<u16bit_iterator, 2>( ) );
+}
+
+// Contiguous input is transcoded by the kernels from simd.h.
+template< typename u32bit_iterator, typename u16bit_iterator >
+u16bit_iterator utf32to16( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result )
+{
+    return detail::unchecked_utf32to16( start, end, result, detail::is_contiguous<u32bit_iterator, 4>( ) );
+}
+
+template< typename latin1_iterator, typename octet_iterator >
+octet_iterator latin1to8( latin1_iterator start, latin1_iterator end, octet_iterator result )
+{
+    return detail::latin1to8( start, end, result, detail::is_contiguous<latin1_iterator, 1>( ) );
+}
+
+// The input must not contain code points above U+00FF.
+template< typename octet_iterator, typename latin1_iterator >
+latin1_iterator utf8tolatin1( octet_iterator start, octet_iterator end, latin1_iterator result )
+{
+    return detail::unchecked_utf8tolatin1( start, end, result, detail::is_contiguous<octet_iterator, 1>( ) );
 }
 
 // The iterator class
@@ -127,6 +344,24 @@ template< typename octet_iterator >
 class iterator : public std::iterator<std::bidirectional_iterator_tag, uint32_t>
 {
     octet_iterator it;
+    // the code point at it and its encoded length, decoded by operator *
+    // and reused by operator ++; a length of 0 marks an empty cache
+    mutable uint32_t cp = 0;
+    mutable uint8_t length = 0;
+
+    void decode( ) const
+    {
+        octet_iterator temp = it;
+        cp = utf8::unchecked::next( temp );
+        length = detail::sequence_length<uint8_t>( *it );
+    }
+
+    void increment( )
+    {
+        ::std::advance( it, length != 0 ? length : detail::sequence_length<difference_type>( *it ) );
+        length = 0;
+    }
+
 public:
     iterator( )
     {
@@ -144,7 +379,11 @@ public:
 
     uint32_t operator *( ) const
     {
-        return peek_next( it );
+        if (length == 0)
+        {
+            decode( );
+        }
+        return cp;
     }
 
     bool operator ==( const iterator &rhs ) const
@@ -159,20 +398,37 @@ public:
 
     iterator & operator ++( )
     {
-        ::std::advance( it, detail::sequence_length<difference_type>( *it ) );
+        increment( );
         return *this;
     }
 
     iterator operator ++( int )
     {
         iterator temp = *this;
-        ::std::advance( it, detail::sequence_length<difference_type>( *it ) );
+        increment( );
         return temp;
     }
 
+    // moves by n code points, contiguous sequences are skipped in bulk in
+    // both directions
+    iterator & operator +=( difference_type n )
+    {
+        if (n >= 0)
+        {
+            utf8::unchecked::advance( it, n );
+        }
+        else
+        {
+            utf8::unchecked::retreat( it, -n );
+        }
+        length = 0;
+        return *this;
+    }
+
     iterator & operator --( )
     {
         previous( it );
+        length = 0;
         return *this;
     }
 
@@ -180,6 +436,7 @@ public:
     {
         iterator temp = *this;
         previous( it );
+        length = 0;
         return temp;
     }
 }; // class iterator
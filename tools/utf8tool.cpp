@@ -0,0 +1,89 @@
+// Copyright 2015 Henrik S. Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+// Validates, sanitizes and transcodes (large) files through memory mappings.
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <utf8.h>
+#include <utf8/file.h>
+
+namespace
+{
+const int exit_invalid = 1;
+const int exit_usage = 2;
+const int exit_failure = 3;
+
+int usage( )
+{
+    std::cerr << "usage: utf8tool validate <input>\n"
+                 "       utf8tool sanitize <input> <output>\n"
+                 "       utf8tool to16 <input> <output>\n"
+                 "       utf8tool to32 <input> <output>\n"
+                 "\n"
+                 "validate reports the offset of the first invalid sequence, sanitize\n"
+                 "replaces invalid sequences with U+FFFD, to16 and to32 write UTF-16/UTF-32\n"
+                 "in the native byte order without BOM.\n";
+    return exit_usage;
+}
+}
+
+int main( int argc, char **argv )
+{
+    if (argc < 3)
+    {
+        return usage( );
+    }
+    const std::string command = argv[1];
+    const bool has_output = command != "validate";
+    if (argc != (has_output ? 4 : 3))
+    {
+        return usage( );
+    }
+
+    try
+    {
+        const utf8::file input( argv[2] );
+        if (command == "validate")
+        {
+            const std::size_t invalid = utf8::find_invalid( input );
+            if (invalid != input.size( ))
+            {
+                std::cout << argv[2] << ": invalid UTF-8 at offset " << invalid << '\n';
+                return exit_invalid;
+            }
+        }
+        else if (command == "sanitize")
+        {
+            utf8::replace_invalid( input, argv[3] );
+        }
+        else if (command == "to16")
+        {
+            utf8::utf8to16( input, argv[3] );
+        }
+        else if (command == "to32")
+        {
+            utf8::utf8to32( input, argv[3] );
+        }
+        else
+        {
+            return usage( );
+        }
+    }
+    catch (const utf8::exception &)
+    {
+        std::cerr << argv[2] << ": invalid UTF-8 at offset "
+            << utf8::find_invalid( utf8::file( argv[2] ) ) << '\n';
+        return exit_invalid;
+    }
+    catch (const std::system_error &exc)
+    {
+        std::cerr << "utf8tool: " << exc.what( ) << '\n';
+        return exit_failure;
+    }
+    return 0;
+}
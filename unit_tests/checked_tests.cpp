@@ -3,7 +3,13 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
 ////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
 #include <cstdint>
+#include <deque>
+#include <iterator>
+#include <string>
+#include <typeinfo>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 
@@ -13,6 +19,42 @@
 
 BOOST_AUTO_TEST_SUITE( utf8ut_checked )
 
+// Runs the conversion on a contiguous buffer and on a std::deque, which
+// takes the scalar path, and requires both to write the same output and to
+// throw the same exception.
+template< typename output_type, typename input_type, typename conversion >
+static void require_same_as_scalar( const std::basic_string<input_type> &str, conversion convert )
+{
+    const std::deque<input_type> scalar_input( str.cbegin( ), str.cend( ) );
+    std::vector<output_type> output( 3 * str.size( ) + 1, output_type( 0x5A ) );
+    std::vector<output_type> scalar_output( output );
+    std::string error, scalar_error;
+    std::ptrdiff_t written = -1, scalar_written = -1;
+
+    try
+    {
+        written = convert( str.cbegin( ), str.cend( ), output.begin( ) ) - output.begin( );
+    }
+    catch (const utf8::exception &exc)
+    {
+        error = typeid(exc).name( );
+    }
+    try
+    {
+        scalar_written = convert( scalar_input.cbegin( ), scalar_input.cend( ), scalar_output.begin( ) ) - scalar_output.begin( );
+    }
+    catch (const utf8::exception &exc)
+    {
+        scalar_error = typeid(exc).name( );
+    }
+
+    BOOST_REQUIRE_EQUAL( error, scalar_error );
+    BOOST_REQUIRE_EQUAL( written, scalar_written );
+    BOOST_REQUIRE( output == scalar_output );
+}
+
+struct mixed_fixture : fixtures::mixed_u8, fixtures::malformed_u8 {};
+
 struct append_fixture : fixtures::valid_u8_with_it, fixtures::valid_u32 {};
 
 BOOST_FIXTURE_TEST_CASE( append, append_fixture )
@@ -44,6 +86,32 @@ BOOST_FIXTURE_TEST_CASE( replace_invalid, fixtures::invalid_u8 )
     BOOST_CHECK( it == str.end( ) );
 }
 
+BOOST_FIXTURE_TEST_CASE( replace_invalid_matches_scalar, mixed_fixture )
+{
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text.size( ); ++pos)
+        {
+            std::string str = text;
+            str.insert( pos, invalid );
+            str.insert( str.size( ) - pos / 2, invalid );
+            BOOST_TEST_CHECKPOINT( "replace_invalid_matches_scalar pos=" << pos );
+
+            const std::deque<char> scalar_input( str.cbegin( ), str.cend( ) );
+            std::string expected;
+            utf8::replace_invalid( scalar_input.cbegin( ), scalar_input.cend( ), std::back_inserter( expected ), 0x2603 );
+
+            // bulk copies to the buffer, element wise to the back inserter
+            std::vector<char> output( 3 * str.size( ) );
+            output.erase( utf8::replace_invalid( str.cbegin( ), str.cend( ), output.begin( ), 0x2603 ), output.end( ) );
+            BOOST_REQUIRE_EQUAL_COLLECTIONS( output.cbegin( ), output.cend( ), expected.cbegin( ), expected.cend( ) );
+            std::string appended;
+            utf8::replace_invalid( str.cbegin( ), str.cend( ), std::back_inserter( appended ), 0x2603 );
+            BOOST_REQUIRE_EQUAL( appended, expected );
+        }
+    }
+}
+
 struct next_fixture : fixtures::valid_u8_with_it, fixtures::valid_u32 {};
 
 BOOST_FIXTURE_TEST_CASE( next, next_fixture )
@@ -60,7 +128,6 @@ BOOST_FIXTURE_TEST_CASE( next, next_fixture )
     }
 }
 
-BOOST_AUTO_TEST_CASE_EXPECTED_FAILURES( previous, 1 )
 struct previous_fixture : fixtures::valid_u8_with_it, fixtures::valid_u32 {};
 
 BOOST_FIXTURE_TEST_CASE( previous, previous_fixture )
@@ -81,10 +148,60 @@ BOOST_FIXTURE_TEST_CASE( previous, previous_fixture )
     BOOST_CHECK_THROW( utf8::previous( it_u8, enc_u8_beg ), utf8::not_enough_room );
     BOOST_CHECK( it_u8 == enc_u8_beg );
 
-    //TODO: provide stronger exception guarantee
     it_u8 = enc_u8_beg + 2;
     BOOST_CHECK_THROW( utf8::previous( it_u8, enc_u8_beg + 1 ), utf8::invalid_utf8 );
     BOOST_CHECK( it_u8 == enc_u8_beg + 2 );
+
+    // a stray continuation behind a complete sequence
+    const std::string stray = "a\xE6\x97\xA5\x80";
+    std::string::const_iterator it = stray.cend( );
+    BOOST_CHECK_THROW( utf8::previous( it, stray.cbegin( ) ), utf8::invalid_utf8 );
+    BOOST_CHECK( it == stray.cend( ) );
+}
+
+// retreats from the end by n and returns the resulting offset or the exception
+template< typename container >
+static std::string retreat_error( const container &str, std::ptrdiff_t n, std::ptrdiff_t &offset )
+{
+    typename container::const_iterator it = str.cend( );
+    std::string error;
+    try
+    {
+        utf8::retreat( it, n, str.cbegin( ) );
+    }
+    catch (const utf8::exception &exc)
+    {
+        error = typeid(exc).name( );
+    }
+    offset = it - str.cbegin( );
+    return error;
+}
+
+BOOST_FIXTURE_TEST_CASE( retreat_matches_scalar, mixed_fixture )
+{
+    const std::string text4 = text + text + text + text;
+    const std::ptrdiff_t num_cps = utf8::distance( text4.cbegin( ), text4.cend( ) );
+    std::vector<std::string> inputs( 1, text4 );
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text4.size( ); pos += 37)
+        {
+            inputs.push_back( text4 );
+            inputs.back( ).insert( pos, invalid );
+        }
+    }
+
+    for (const std::string &str : inputs)
+    {
+        const std::deque<char> scalar_str( str.cbegin( ), str.cend( ) );
+        for (std::ptrdiff_t n = 0; n <= num_cps + 2; n += n < 130 ? 1 : 7)
+        {
+            BOOST_TEST_CHECKPOINT( "retreat_matches_scalar n=" << n );
+            std::ptrdiff_t offset = -1, scalar_offset = -1;
+            BOOST_REQUIRE_EQUAL( retreat_error( str, n, offset ), retreat_error( scalar_str, n, scalar_offset ) );
+            BOOST_REQUIRE_EQUAL( offset, scalar_offset );
+        }
+    }
 }
 
 //BOOST_AUTO_TEST_CASE_EXPECTED_FAILURES( advance, 1 )
@@ -112,6 +229,90 @@ BOOST_FIXTURE_TEST_CASE( distance, fixtures::valid_u8_with_it )
     //BOOST_CHECK_THROW( utf8::distance( enc_u8_beg + 1, enc_u8_beg ), utf8::exception );
 }
 
+// the std::deque takes the scalar path
+static std::string distance_error( const std::string &str, std::ptrdiff_t &dist, bool contiguous )
+{
+    const std::deque<char> scalar_str( str.cbegin( ), str.cend( ) );
+    try
+    {
+        dist = contiguous
+            ? utf8::distance( str.cbegin( ), str.cend( ) )
+            : utf8::distance( scalar_str.cbegin( ), scalar_str.cend( ) );
+    }
+    catch (const utf8::exception &exc)
+    {
+        return typeid(exc).name( );
+    }
+    return std::string( );
+}
+
+BOOST_FIXTURE_TEST_CASE( distance_matches_scalar, mixed_fixture )
+{
+    std::string text4 = text + text + text + text;
+    std::ptrdiff_t dist = -1;
+    BOOST_REQUIRE_EQUAL( distance_error( text4, dist, true ), std::string( ) );
+    BOOST_REQUIRE_EQUAL( dist, static_cast<std::ptrdiff_t>(utf8::utf32_length_from_utf8( text4.cbegin( ), text4.cend( ) )) );
+
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text.size( ); ++pos)
+        {
+            std::string str = text;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "distance_matches_scalar pos=" << pos );
+            std::ptrdiff_t scalar_dist = -1;
+            dist = -1;
+            BOOST_REQUIRE_EQUAL( distance_error( str, dist, true ), distance_error( str, scalar_dist, false ) );
+            BOOST_REQUIRE_EQUAL( dist, scalar_dist );
+        }
+    }
+}
+
+// advances by n and returns the resulting offset or the exception
+template< typename container >
+static std::string advance_error( const container &str, std::ptrdiff_t n, std::ptrdiff_t &offset )
+{
+    typename container::const_iterator it = str.cbegin( );
+    std::string error;
+    try
+    {
+        utf8::advance( it, n, str.cend( ) );
+    }
+    catch (const utf8::exception &exc)
+    {
+        error = typeid(exc).name( );
+    }
+    offset = it - str.cbegin( );
+    return error;
+}
+
+BOOST_FIXTURE_TEST_CASE( advance_matches_scalar, mixed_fixture )
+{
+    const std::string text4 = text + text + text + text;
+    const std::ptrdiff_t num_cps = utf8::distance( text4.cbegin( ), text4.cend( ) );
+    std::vector<std::string> inputs( 1, text4 );
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text4.size( ); pos += 37)
+        {
+            inputs.push_back( text4 );
+            inputs.back( ).insert( pos, invalid );
+        }
+    }
+
+    for (const std::string &str : inputs)
+    {
+        const std::deque<char> scalar_str( str.cbegin( ), str.cend( ) );
+        for (std::ptrdiff_t n = 0; n <= num_cps + 2; n += n < 130 ? 1 : 7)
+        {
+            BOOST_TEST_CHECKPOINT( "advance_matches_scalar n=" << n );
+            std::ptrdiff_t offset = -1, scalar_offset = -1;
+            BOOST_REQUIRE_EQUAL( advance_error( str, n, offset ), advance_error( scalar_str, n, scalar_offset ) );
+            BOOST_REQUIRE_EQUAL( offset, scalar_offset );
+        }
+    }
+}
+
 struct utf32conv_fixture : fixtures::valid_u8_with_it, fixtures::valid_u32_with_it {};
 
 BOOST_FIXTURE_TEST_CASE( utf32to8, utf32conv_fixture )
@@ -158,6 +359,430 @@ BOOST_FIXTURE_TEST_CASE( utf8to16, utf16conv_fixture )
     BOOST_CHECK( it_u16 == str.end( ) );
 }
 
+struct utf8to16_conversion
+{
+    template< typename octet_iterator, typename u16bit_iterator >
+    u16bit_iterator operator ()( octet_iterator start, octet_iterator end, u16bit_iterator result ) const
+    {
+        return utf8::utf8to16( start, end, result );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( utf8to16_matches_scalar, mixed_fixture )
+{
+    std::string text4 = text + text + text + text;
+    require_same_as_scalar<char16_t>( text4, utf8to16_conversion( ) );
+
+    // non contiguous output
+    std::u16string str, scalar_str;
+    const std::deque<char> scalar_input( text4.cbegin( ), text4.cend( ) );
+    BOOST_REQUIRE_NO_THROW( utf8::utf8to16( text4.cbegin( ), text4.cend( ), std::back_inserter( str ) ) );
+    utf8::utf8to16( scalar_input.cbegin( ), scalar_input.cend( ), std::back_inserter( scalar_str ) );
+    BOOST_REQUIRE( str == scalar_str );
+
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text.size( ); ++pos)
+        {
+            std::string str = text;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "utf8to16_matches_scalar pos=" << pos );
+            require_same_as_scalar<char16_t>( str, utf8to16_conversion( ) );
+        }
+    }
+}
+
+struct utf16to8_conversion
+{
+    template< typename u16bit_iterator, typename octet_iterator >
+    octet_iterator operator ()( u16bit_iterator start, u16bit_iterator end, octet_iterator result ) const
+    {
+        return utf8::utf16to8( start, end, result );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( utf16to8_matches_scalar, fixtures::mixed_u8 )
+{
+    std::u16string text16;
+    utf8::utf8to16( text.cbegin( ), text.cend( ), std::back_inserter( text16 ) );
+    const std::u16string text64 = text16 + text16 + text16 + text16;
+    require_same_as_scalar<char>( text64, utf16to8_conversion( ) );
+
+    // non contiguous output
+    std::string str;
+    BOOST_REQUIRE_NO_THROW( utf8::utf16to8( text64.cbegin( ), text64.cend( ), std::back_inserter( str ) ) );
+    BOOST_REQUIRE( str == text + text + text + text );
+
+    const std::u16string malformed[] = {
+        std::u16string( 1, 0xD800 ), std::u16string( 1, 0xDBFF ), std::u16string( 1, 0xDC00 ),
+        std::u16string( 1, 0xDFFF ), std::u16string( 2, 0xD800 ), std::u16string( 2, 0xDC00 ),
+    };
+    for (const std::u16string &invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text16.size( ); ++pos)
+        {
+            std::u16string str = text16;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "utf16to8_matches_scalar pos=" << pos );
+            require_same_as_scalar<char>( str, utf16to8_conversion( ) );
+        }
+    }
+}
+
+struct utf8to32_conversion
+{
+    template< typename octet_iterator, typename u32bit_iterator >
+    u32bit_iterator operator ()( octet_iterator start, octet_iterator end, u32bit_iterator result ) const
+    {
+        return utf8::utf8to32( start, end, result );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( utf8to32_matches_scalar, mixed_fixture )
+{
+    std::string text4 = text + text + text + text;
+    require_same_as_scalar<char32_t>( text4, utf8to32_conversion( ) );
+
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text.size( ); ++pos)
+        {
+            std::string str = text;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "utf8to32_matches_scalar pos=" << pos );
+            require_same_as_scalar<char32_t>( str, utf8to32_conversion( ) );
+        }
+    }
+}
+
+struct utf32to8_conversion
+{
+    template< typename u32bit_iterator, typename octet_iterator >
+    octet_iterator operator ()( u32bit_iterator start, u32bit_iterator end, octet_iterator result ) const
+    {
+        return utf8::utf32to8( start, end, result );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( utf32to8_matches_scalar, fixtures::mixed_u8 )
+{
+    std::u32string text32;
+    utf8::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( text32 ) );
+    const std::u32string text128 = text32 + text32 + text32 + text32;
+    require_same_as_scalar<char>( text128, utf32to8_conversion( ) );
+
+    // non contiguous output
+    std::string str;
+    BOOST_REQUIRE_NO_THROW( utf8::utf32to8( text128.cbegin( ), text128.cend( ), std::back_inserter( str ) ) );
+    BOOST_REQUIRE( str == text + text + text + text );
+
+    for (char32_t invalid : { 0xD800u, 0xDBFFu, 0xDC00u, 0xDFFFu, 0x110000u, 0xFFFFFFFFu })
+    {
+        for (size_t pos = 0; pos <= text32.size( ); ++pos)
+        {
+            std::u32string str = text32;
+            str.insert( pos, 1, invalid );
+            BOOST_TEST_CHECKPOINT( "utf32to8_matches_scalar pos=" << pos );
+            require_same_as_scalar<char>( str, utf32to8_conversion( ) );
+        }
+    }
+}
+
+struct utf16to32_conversion
+{
+    template< typename u16bit_iterator, typename u32bit_iterator >
+    u32bit_iterator operator ()( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result ) const
+    {
+        return utf8::utf16to32( start, end, result );
+    }
+};
+
+struct utf32to16_conversion
+{
+    template< typename u32bit_iterator, typename u16bit_iterator >
+    u16bit_iterator operator ()( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result ) const
+    {
+        return utf8::utf32to16( start, end, result );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( utf16to32_matches_scalar, fixtures::mixed_u8 )
+{
+    std::u16string text16;
+    std::u32string text32;
+    utf8::utf8to16( text.cbegin( ), text.cend( ), std::back_inserter( text16 ) );
+    utf8::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( text32 ) );
+    const std::u16string text64 = text16 + text16 + text16 + text16;
+    const std::u32string text128 = text32 + text32 + text32 + text32;
+    require_same_as_scalar<char32_t>( text64, utf16to32_conversion( ) );
+    require_same_as_scalar<char16_t>( text128, utf32to16_conversion( ) );
+
+    // the same as the detour through UTF-8, also with non contiguous output
+    std::u32string str32;
+    std::u16string str16;
+    BOOST_REQUIRE_NO_THROW( utf8::utf16to32( text64.cbegin( ), text64.cend( ), std::back_inserter( str32 ) ) );
+    BOOST_REQUIRE_NO_THROW( utf8::utf32to16( text128.cbegin( ), text128.cend( ), std::back_inserter( str16 ) ) );
+    BOOST_REQUIRE( str32 == text128 );
+    BOOST_REQUIRE( str16 == text64 );
+
+    const std::u16string malformed[] = {
+        std::u16string( 1, 0xD800 ), std::u16string( 1, 0xDBFF ), std::u16string( 1, 0xDC00 ),
+        std::u16string( 1, 0xDFFF ), std::u16string( 2, 0xD800 ), std::u16string( 2, 0xDC00 ),
+    };
+    for (const std::u16string &invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text16.size( ); ++pos)
+        {
+            std::u16string str = text16;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "utf16to32_matches_scalar pos=" << pos );
+            require_same_as_scalar<char32_t>( str, utf16to32_conversion( ) );
+        }
+    }
+    for (char32_t invalid : { 0xD800u, 0xDBFFu, 0xDC00u, 0xDFFFu, 0x110000u, 0xFFFFFFFFu })
+    {
+        for (size_t pos = 0; pos <= text32.size( ); ++pos)
+        {
+            std::u32string str = text32;
+            str.insert( pos, 1, invalid );
+            BOOST_TEST_CHECKPOINT( "utf32to16_matches_scalar pos=" << pos );
+            require_same_as_scalar<char16_t>( str, utf32to16_conversion( ) );
+        }
+    }
+}
+
+// Requires the non-throwing conversion to report the error of the throwing
+// one, to write the same output and to agree between the contiguous and the
+// scalar path. The reported input position must end a valid prefix.
+template< typename output_type, typename input_type, typename conversion, typename try_conversion >
+static void require_same_as_throwing( const std::basic_string<input_type> &str, conversion convert, try_conversion try_convert )
+{
+    typedef typename std::basic_string<input_type>::const_iterator input_iterator;
+    typedef typename std::vector<output_type>::iterator output_iterator;
+    const std::deque<input_type> scalar_input( str.cbegin( ), str.cend( ) );
+    std::vector<output_type> expected( 3 * str.size( ) + 1, output_type( 0x5A ) );
+    std::vector<output_type> output( expected ), scalar_output( expected );
+
+    utf8::error_code expected_error = utf8::error_code::ok;
+    std::ptrdiff_t written = -1;
+    try
+    {
+        written = convert( str.cbegin( ), str.cend( ), expected.begin( ) ) - expected.begin( );
+    }
+    catch (const utf8::invalid_code_point &)
+    {
+        expected_error = utf8::error_code::invalid_code_point;
+    }
+    catch (const utf8::invalid_utf8 &)
+    {
+        expected_error = utf8::error_code::invalid_utf8;
+    }
+    catch (const utf8::invalid_utf16 &)
+    {
+        expected_error = utf8::error_code::invalid_utf16;
+    }
+    catch (const utf8::not_enough_room &)
+    {
+        expected_error = utf8::error_code::not_enough_room;
+    }
+
+    const utf8::conversion_result<input_iterator, output_iterator> r = try_convert( str.cbegin( ), str.cend( ), output.begin( ) );
+    const auto scalar_r = try_convert( scalar_input.cbegin( ), scalar_input.cend( ), scalar_output.begin( ) );
+    BOOST_REQUIRE( r.error == expected_error );
+    BOOST_REQUIRE( scalar_r.error == expected_error );
+    BOOST_REQUIRE_EQUAL( !r, expected_error != utf8::error_code::ok );
+    BOOST_REQUIRE( output == expected );
+    BOOST_REQUIRE( scalar_output == expected );
+    BOOST_REQUIRE_EQUAL( r.in - str.cbegin( ), scalar_r.in - scalar_input.cbegin( ) );
+    BOOST_REQUIRE_EQUAL( r.out - output.begin( ), scalar_r.out - scalar_output.begin( ) );
+    if (r)
+    {
+        BOOST_REQUIRE( r.in == str.cend( ) );
+        BOOST_REQUIRE_EQUAL( r.out - output.begin( ), written );
+    }
+    else
+    {
+        // converting the prefix in front of the error succeeds
+        std::vector<output_type> prefix_output( expected.size( ) );
+        BOOST_REQUIRE_EQUAL( convert( str.cbegin( ), r.in, prefix_output.begin( ) ) - prefix_output.begin( ),
+            r.out - output.begin( ) );
+    }
+}
+
+struct try_utf8to16_conversion
+{
+    template< typename octet_iterator, typename u16bit_iterator >
+    utf8::conversion_result<octet_iterator, u16bit_iterator> operator ()( octet_iterator start, octet_iterator end, u16bit_iterator result ) const
+    {
+        return utf8::try_utf8to16( start, end, result );
+    }
+};
+
+struct try_utf8to32_conversion
+{
+    template< typename octet_iterator, typename u32bit_iterator >
+    utf8::conversion_result<octet_iterator, u32bit_iterator> operator ()( octet_iterator start, octet_iterator end, u32bit_iterator result ) const
+    {
+        return utf8::try_utf8to32( start, end, result );
+    }
+};
+
+struct try_utf16to8_conversion
+{
+    template< typename u16bit_iterator, typename octet_iterator >
+    utf8::conversion_result<u16bit_iterator, octet_iterator> operator ()( u16bit_iterator start, u16bit_iterator end, octet_iterator result ) const
+    {
+        return utf8::try_utf16to8( start, end, result );
+    }
+};
+
+struct try_utf32to8_conversion
+{
+    template< typename u32bit_iterator, typename octet_iterator >
+    utf8::conversion_result<u32bit_iterator, octet_iterator> operator ()( u32bit_iterator start, u32bit_iterator end, octet_iterator result ) const
+    {
+        return utf8::try_utf32to8( start, end, result );
+    }
+};
+
+struct try_utf16to32_conversion
+{
+    template< typename u16bit_iterator, typename u32bit_iterator >
+    utf8::conversion_result<u16bit_iterator, u32bit_iterator> operator ()( u16bit_iterator start, u16bit_iterator end, u32bit_iterator result ) const
+    {
+        return utf8::try_utf16to32( start, end, result );
+    }
+};
+
+struct try_utf32to16_conversion
+{
+    template< typename u32bit_iterator, typename u16bit_iterator >
+    utf8::conversion_result<u32bit_iterator, u16bit_iterator> operator ()( u32bit_iterator start, u32bit_iterator end, u16bit_iterator result ) const
+    {
+        return utf8::try_utf32to16( start, end, result );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( try_conversions, mixed_fixture )
+{
+    std::u16string text16;
+    std::u32string text32;
+    utf8::utf8to16( text.cbegin( ), text.cend( ), std::back_inserter( text16 ) );
+    utf8::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( text32 ) );
+    require_same_as_throwing<char16_t>( text, utf8to16_conversion( ), try_utf8to16_conversion( ) );
+    require_same_as_throwing<char32_t>( text, utf8to32_conversion( ), try_utf8to32_conversion( ) );
+    require_same_as_throwing<char>( text16, utf16to8_conversion( ), try_utf16to8_conversion( ) );
+    require_same_as_throwing<char>( text32, utf32to8_conversion( ), try_utf32to8_conversion( ) );
+    require_same_as_throwing<char32_t>( text16, utf16to32_conversion( ), try_utf16to32_conversion( ) );
+    require_same_as_throwing<char16_t>( text32, utf32to16_conversion( ), try_utf32to16_conversion( ) );
+
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text.size( ); pos += 3)
+        {
+            std::string str = text;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "try_conversions pos=" << pos );
+            require_same_as_throwing<char16_t>( str, utf8to16_conversion( ), try_utf8to16_conversion( ) );
+            require_same_as_throwing<char32_t>( str, utf8to32_conversion( ), try_utf8to32_conversion( ) );
+        }
+    }
+    for (size_t pos = 0; pos <= text16.size( ); pos += 3)
+    {
+        std::u16string str = text16;
+        str.insert( pos, 1, 0xDC00 );
+        BOOST_TEST_CHECKPOINT( "try_conversions pos=" << pos );
+        require_same_as_throwing<char>( str, utf16to8_conversion( ), try_utf16to8_conversion( ) );
+        require_same_as_throwing<char32_t>( str, utf16to32_conversion( ), try_utf16to32_conversion( ) );
+        str.erase( pos, 1 );
+        str.insert( pos, 1, 0xD800 );
+        require_same_as_throwing<char>( str, utf16to8_conversion( ), try_utf16to8_conversion( ) );
+        require_same_as_throwing<char32_t>( str, utf16to32_conversion( ), try_utf16to32_conversion( ) );
+    }
+    for (size_t pos = 0; pos <= text32.size( ); pos += 3)
+    {
+        std::u32string str = text32;
+        str.insert( pos, 1, 0x110000 );
+        BOOST_TEST_CHECKPOINT( "try_conversions pos=" << pos );
+        require_same_as_throwing<char>( str, utf32to8_conversion( ), try_utf32to8_conversion( ) );
+        require_same_as_throwing<char16_t>( str, utf32to16_conversion( ), try_utf32to16_conversion( ) );
+    }
+}
+
+struct latin1to8_conversion
+{
+    template< typename latin1_iterator, typename octet_iterator >
+    octet_iterator operator ()( latin1_iterator start, latin1_iterator end, octet_iterator result ) const
+    {
+        return utf8::latin1to8( start, end, result );
+    }
+};
+
+struct utf8tolatin1_conversion
+{
+    template< typename octet_iterator, typename latin1_iterator >
+    latin1_iterator operator ()( octet_iterator start, octet_iterator end, latin1_iterator result ) const
+    {
+        return utf8::utf8tolatin1( start, end, result );
+    }
+};
+
+struct try_utf8tolatin1_conversion
+{
+    template< typename octet_iterator, typename latin1_iterator >
+    utf8::conversion_result<octet_iterator, latin1_iterator> operator ()( octet_iterator start, octet_iterator end, latin1_iterator result ) const
+    {
+        return utf8::try_utf8tolatin1( start, end, result );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( latin1_matches_scalar, mixed_fixture )
+{
+    // every character in runs of ASCII and of two octet sequences
+    std::string latin1;
+    for (unsigned i = 0; i < 1024; ++i)
+    {
+        latin1 += static_cast<char>(i % 3 == 0 ? 0x20 + i % 0x5F : (i * 37 + i / 8) & 0xFF);
+    }
+    std::string latin1_u8;
+    for (char c : latin1)
+    {
+        utf8::append( static_cast<uint8_t>(c), std::back_inserter( latin1_u8 ) );
+    }
+    require_same_as_scalar<char>( latin1, latin1to8_conversion( ) );
+    require_same_as_scalar<char>( latin1_u8, utf8tolatin1_conversion( ) );
+    require_same_as_throwing<char>( latin1_u8, utf8tolatin1_conversion( ), try_utf8tolatin1_conversion( ) );
+
+    std::string str8, str1;
+    BOOST_REQUIRE_NO_THROW( utf8::latin1to8( latin1.cbegin( ), latin1.cend( ), std::back_inserter( str8 ) ) );
+    BOOST_REQUIRE_NO_THROW( utf8::utf8tolatin1( latin1_u8.cbegin( ), latin1_u8.cend( ), std::back_inserter( str1 ) ) );
+    BOOST_REQUIRE( str8 == latin1_u8 );
+    BOOST_REQUIRE( str1 == latin1 );
+
+    // code points above U+00FF and malformed sequences
+    const std::string prefix = latin1_u8.substr( 0, 96 );
+    for (const char *invalid : { u8"\u0100", u8"\u20AC", u8"\U0001F600", "\xC3", "\x80", "\xED\xA0\x80" })
+    {
+        for (size_t pos = 0; pos <= prefix.size( ); ++pos)
+        {
+            std::string str = prefix + prefix;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "latin1_matches_scalar pos=" << pos );
+            require_same_as_scalar<char>( str, utf8tolatin1_conversion( ) );
+            require_same_as_throwing<char>( str, utf8tolatin1_conversion( ), try_utf8tolatin1_conversion( ) );
+        }
+    }
+    try
+    {
+        utf8::utf8tolatin1( text.cbegin( ), text.cend( ), std::back_inserter( str1 ) );
+        BOOST_FAIL( "utf8tolatin1 accepted code points above U+00FF" );
+    }
+    catch (const utf8::invalid_code_point &exc)
+    {
+        BOOST_REQUIRE_EQUAL( exc.code_point( ), 0x0421u );
+    }
+}
+
 struct iterator_fixture : fixtures::valid_u8_with_it, fixtures::valid_u32 {};
 
 BOOST_FIXTURE_TEST_CASE( iterator, iterator_fixture )
@@ -189,4 +814,238 @@ BOOST_FIXTURE_TEST_CASE( iterator, iterator_fixture )
     BOOST_REQUIRE_EQUAL( *it, dec[0] );
 }
 
+BOOST_FIXTURE_TEST_CASE( iterator_cached_code_point, fixtures::mixed_u8 )
+{
+    using iterator = utf8::iterator<std::string::const_iterator>;
+    std::u32string expected;
+    utf8::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( expected ) );
+
+    // dereference, copy and move in different orders
+    const iterator end( text.cend( ), text.cbegin( ), text.cend( ) );
+    iterator it( text.cbegin( ), text.cbegin( ), text.cend( ) );
+    for (size_t i = 0; i < expected.size( ); ++i)
+    {
+        BOOST_REQUIRE_EQUAL( *it, expected[i] );
+        BOOST_REQUIRE_EQUAL( *it, expected[i] );
+        if (i % 3 == 1)
+        {
+            iterator copy = it++;
+            BOOST_REQUIRE_EQUAL( *copy, expected[i] );
+        }
+        else if (i % 3 == 2 && i + 1 < expected.size( ))
+        {
+            BOOST_REQUIRE_EQUAL( *++it, expected[i + 1] );
+            BOOST_REQUIRE_EQUAL( *--it, expected[i] );
+            ++it;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    BOOST_REQUIRE( it == end );
+
+    // invalid sequences are reported by both operators
+    const std::string invalid = "a\xE6\x97";
+    iterator invalid_it( invalid.cbegin( ) + 1, invalid.cbegin( ), invalid.cend( ) );
+    BOOST_REQUIRE_THROW( *invalid_it, utf8::not_enough_room );
+    BOOST_REQUIRE_THROW( ++invalid_it, utf8::not_enough_room );
+}
+
+BOOST_FIXTURE_TEST_CASE( error_policies, fixtures::invalid_u8 )
+{
+    std::u16string expected;
+    utf8::utf8to16( exp_res.cbegin( ), exp_res.cend( ), std::back_inserter( expected ) );
+    std::u16string skipped;
+    std::remove_copy( expected.cbegin( ), expected.cend( ), std::back_inserter( skipped ), utf8::replacement_char );
+
+    std::u16string output( enc.size( ), u'\0' );
+    auto r = utf8::utf8to16<utf8::error_policy::replace>( enc.cbegin( ), enc.cend( ), output.begin( ) );
+    BOOST_REQUIRE( r.error == utf8::error_code::invalid_utf8 );
+    BOOST_REQUIRE( r.in == enc.cend( ) );
+    BOOST_REQUIRE( std::u16string( output.begin( ), r.out ) == expected );
+
+    r = utf8::utf8to16<utf8::error_policy::skip>( enc.cbegin( ), enc.cend( ), output.begin( ) );
+    BOOST_REQUIRE( r.error == utf8::error_code::invalid_utf8 );
+    BOOST_REQUIRE( std::u16string( output.begin( ), r.out ) == skipped );
+
+    r = utf8::utf8to16<utf8::error_policy::stop>( enc.cbegin( ), enc.cend( ), output.begin( ) );
+    BOOST_REQUIRE( r.error == utf8::error_code::invalid_utf8 );
+    BOOST_REQUIRE( r.in == enc.cbegin( ) + first_invalid_index );
+    BOOST_REQUIRE( std::u16string( output.begin( ), r.out ) == expected.substr( 0, 2 ) );
+
+    BOOST_REQUIRE_THROW( utf8::utf8to16<utf8::error_policy::throw_exception>( enc.cbegin( ), enc.cend( ), output.begin( ) ),
+        utf8::invalid_utf8 );
+    const auto valid = utf8::utf8to16<utf8::error_policy::throw_exception>( exp_res.cbegin( ), exp_res.cend( ), output.begin( ) );
+    BOOST_REQUIRE( valid && valid.in == exp_res.cend( ) );
+
+    // next decodes the same code points one after another
+    std::u32string expected32, replaced, skipped32;
+    utf8::utf8to32( exp_res.cbegin( ), exp_res.cend( ), std::back_inserter( expected32 ) );
+    for (auto it = enc.cbegin( ); it != enc.cend( ); )
+    {
+        replaced.push_back( utf8::next<utf8::error_policy::replace>( it, enc.cend( ) ) );
+    }
+    for (auto it = enc.cbegin( ); it != enc.cend( ); )
+    {
+        const char32_t cp = utf8::next<utf8::error_policy::skip>( it, enc.cend( ) );
+        if (cp != utf8::no_code_point)
+        {
+            skipped32.push_back( cp );
+        }
+    }
+    BOOST_REQUIRE( replaced == expected32 );
+    BOOST_REQUIRE( skipped32.size( ) == skipped.size( ) );
+    auto stop_it = enc.cbegin( ) + first_invalid_index;
+    BOOST_REQUIRE_EQUAL( utf8::next<utf8::error_policy::stop>( stop_it, enc.cend( ) ), utf8::no_code_point );
+    BOOST_REQUIRE( stop_it == enc.cbegin( ) + first_invalid_index );
+
+    // unpaired surrogates
+    const std::u16string text16 = { u'a', 0xD800, u'b', 0xDC00 };
+    std::string output8( 8, '\0' );
+    auto r8 = utf8::utf16to8<utf8::error_policy::replace>( text16.cbegin( ), text16.cend( ), output8.begin( ) );
+    BOOST_REQUIRE( r8.error == utf8::error_code::invalid_utf16 );
+    BOOST_REQUIRE_EQUAL( std::string( output8.begin( ), r8.out ), "a\xEF\xBF\xBD" "b\xEF\xBF\xBD" );
+    r8 = utf8::utf16to8<utf8::error_policy::skip>( text16.cbegin( ), text16.cend( ), output8.begin( ) );
+    BOOST_REQUIRE_EQUAL( std::string( output8.begin( ), r8.out ), "ab" );
+    r8 = utf8::utf16to8<utf8::error_policy::stop>( text16.cbegin( ), text16.cend( ), output8.begin( ) );
+    BOOST_REQUIRE( r8.in == text16.cbegin( ) + 1 );
+}
+
+// The replace policy has to replace the same sequences as replace_invalid,
+// on the vectorized and on the scalar path and in both directions of the
+// iterator.
+BOOST_FIXTURE_TEST_CASE( error_policies_match_replace_invalid, mixed_fixture )
+{
+    typedef utf8::iterator<std::string::const_iterator, utf8::error_policy::replace> replace_iterator;
+    typedef utf8::iterator<std::deque<char>::const_iterator, utf8::error_policy::skip> skip_iterator;
+    // not contained in the text
+    const char32_t marker = 0x2603;
+
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text.size( ); pos += 7)
+        {
+            std::string str = text;
+            str.insert( pos, invalid );
+            str.insert( std::min( pos + 40, str.size( ) ), invalid );
+            const std::deque<char> scalar_input( str.cbegin( ), str.cend( ) );
+            BOOST_TEST_CHECKPOINT( "error_policies_match_replace_invalid pos=" << pos );
+
+            std::string replaced_u8;
+            utf8::replace_invalid( str.cbegin( ), str.cend( ), std::back_inserter( replaced_u8 ), marker );
+            std::u32string expected, skipped;
+            utf8::utf8to32( replaced_u8.cbegin( ), replaced_u8.cend( ), std::back_inserter( expected ) );
+            std::remove_copy( expected.cbegin( ), expected.cend( ), std::back_inserter( skipped ), marker );
+            std::replace( expected.begin( ), expected.end( ), marker, utf8::replacement_char );
+
+            std::u32string output( str.size( ), U'\0' ), scalar_output;
+            const auto r = utf8::utf8to32<utf8::error_policy::replace>( str.cbegin( ), str.cend( ), output.begin( ) );
+            utf8::utf8to32<utf8::error_policy::replace>( scalar_input.cbegin( ), scalar_input.cend( ),
+                std::back_inserter( scalar_output ) );
+            BOOST_REQUIRE( !r && r.in == str.cend( ) );
+            BOOST_REQUIRE( std::u32string( output.begin( ), r.out ) == expected );
+            BOOST_REQUIRE( scalar_output == expected );
+
+            const auto skip_r = utf8::utf8to32<utf8::error_policy::skip>( str.cbegin( ), str.cend( ), output.begin( ) );
+            BOOST_REQUIRE( std::u32string( output.begin( ), skip_r.out ) == skipped );
+
+            std::u32string forward, backward;
+            const replace_iterator begin( str.cbegin( ), str.cbegin( ), str.cend( ) ), end( str.cend( ), str.cbegin( ), str.cend( ) );
+            std::copy( begin, end, std::back_inserter( forward ) );
+            for (replace_iterator it = end; it != begin; )
+            {
+                backward.push_back( *--it );
+            }
+            std::reverse( backward.begin( ), backward.end( ) );
+            BOOST_REQUIRE( forward == expected );
+            BOOST_REQUIRE( backward == expected );
+
+            forward.clear( );
+            backward.clear( );
+            const skip_iterator skip_begin( scalar_input.cbegin( ), scalar_input.cbegin( ), scalar_input.cend( ) );
+            const skip_iterator skip_end( scalar_input.cend( ), scalar_input.cbegin( ), scalar_input.cend( ) );
+            std::copy( skip_begin, skip_end, std::back_inserter( forward ) );
+            for (skip_iterator it = skip_end; it != skip_begin; )
+            {
+                backward.push_back( *--it );
+            }
+            std::reverse( backward.begin( ), backward.end( ) );
+            BOOST_REQUIRE( forward == skipped );
+            BOOST_REQUIRE( backward == skipped );
+        }
+    }
+}
+
+// the code point wise reference for find and count
+template< typename container >
+static std::ptrdiff_t find_by_iterator( const container &str, char32_t cp )
+{
+    typedef utf8::iterator<typename container::const_iterator> iterator;
+    const iterator begin( str.cbegin( ), str.cbegin( ), str.cend( ) ), end( str.cend( ), str.cbegin( ), str.cend( ) );
+    return std::find( begin, end, cp ).base( ) - str.cbegin( );
+}
+
+BOOST_FIXTURE_TEST_CASE( find_code_point, fixtures::mixed_u8 )
+{
+    std::string text4 = text + text + text + text;
+    const std::deque<char> scalar_text( text4.cbegin( ), text4.cend( ) );
+    std::u32string cps;
+    utf8::utf8to32( text4.cbegin( ), text4.cend( ), std::back_inserter( cps ) );
+    // absent ones, one of them with the same last octet as U+65E5
+    cps += U"\u00A5\u0100\u05E5\U0010FFFE";
+
+    for (char32_t cp : cps)
+    {
+        BOOST_TEST_CHECKPOINT( "find_code_point cp=U+" << std::hex << static_cast<uint32_t>(cp) );
+        const std::ptrdiff_t expected = find_by_iterator( text4, cp );
+        BOOST_REQUIRE_EQUAL( utf8::find( text4.cbegin( ), text4.cend( ), cp ) - text4.cbegin( ), expected );
+        BOOST_REQUIRE_EQUAL( utf8::find( scalar_text.cbegin( ), scalar_text.cend( ), cp ) - scalar_text.cbegin( ), expected );
+
+        const std::ptrdiff_t expected_count = std::count( cps.cbegin( ), cps.cend( ) - 4, cp );
+        BOOST_REQUIRE_EQUAL( utf8::count( text4.cbegin( ), text4.cend( ), cp ), expected_count );
+        BOOST_REQUIRE_EQUAL( utf8::count( scalar_text.cbegin( ), scalar_text.cend( ), cp ), expected_count );
+    }
+
+    BOOST_CHECK_THROW( utf8::find( text4.cbegin( ), text4.cend( ), 0xD800 ), utf8::invalid_code_point );
+    BOOST_CHECK_THROW( utf8::count( text4.cbegin( ), text4.cend( ), 0x110000 ), utf8::invalid_code_point );
+    BOOST_CHECK( utf8::find( text4.cend( ), text4.cend( ), U'a' ) == text4.cend( ) );
+    BOOST_CHECK_EQUAL( utf8::count( text4.cend( ), text4.cend( ), U'a' ), 0 );
+}
+
+BOOST_FIXTURE_TEST_CASE( find_needle, fixtures::mixed_u8 )
+{
+    const std::string text4 = text + text + text + text;
+    const std::deque<char> scalar_text( text4.cbegin( ), text4.cend( ) );
+    std::u32string text32;
+    utf8::utf8to32( text4.cbegin( ), text4.cend( ), std::back_inserter( text32 ) );
+
+    // needles taken from the text at every code point with up to 4 code points
+    for (std::size_t i = 0; i < text32.size( ); i += 3)
+    {
+        for (std::size_t length = 1; length <= 4 && i + length <= text32.size( ); ++length)
+        {
+            const std::u32string needle32 = text32.substr( i, length );
+            std::string needle;
+            utf8::utf32to8( needle32.cbegin( ), needle32.cend( ), std::back_inserter( needle ) );
+            const std::size_t index = text32.find( needle32 );
+            const std::ptrdiff_t expected = static_cast<std::ptrdiff_t>(
+                utf8::utf8_length_from_utf32( text32.cbegin( ), text32.cbegin( ) + index ));
+
+            BOOST_TEST_CHECKPOINT( "find_needle i=" << i << " length=" << length );
+            BOOST_REQUIRE_EQUAL( utf8::find( text4.cbegin( ), text4.cend( ), needle ) - text4.cbegin( ), expected );
+            const std::deque<char> scalar_needle( needle.cbegin( ), needle.cend( ) );
+            BOOST_REQUIRE_EQUAL( utf8::find( scalar_text.cbegin( ), scalar_text.cend( ), scalar_needle.cbegin( ), scalar_needle.cend( ) )
+                - scalar_text.cbegin( ), expected );
+        }
+    }
+
+    // matches have to start at a lead
+    const std::string trail = "\x97\xA5";
+    BOOST_CHECK( utf8::find( text4.cbegin( ), text4.cend( ), trail ) == text4.cend( ) );
+    BOOST_CHECK( utf8::find( scalar_text.cbegin( ), scalar_text.cend( ), trail.cbegin( ), trail.cend( ) ) == scalar_text.cend( ) );
+    BOOST_CHECK( utf8::find( text4.cbegin( ), text4.cend( ), std::string( ) ) == text4.cbegin( ) );
+    BOOST_CHECK( utf8::find( text4.cbegin( ), text4.cend( ), text4 + "a" ) == text4.cend( ) );
+}
+
 BOOST_AUTO_TEST_SUITE_END( )
@@ -0,0 +1,146 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <utf8.h>
+
+#include "fixtures.hpp"
+
+BOOST_AUTO_TEST_SUITE( utf8ut_chunk )
+
+// The chunks have to cover the text without gaps, start at code points and
+// report the lengths of their transcoded output.
+template< typename container >
+static void require_valid_chunks( const container &text, const std::vector<utf8::chunk<typename container::const_iterator>> &chunks )
+{
+    auto it = text.begin( );
+    for (const utf8::chunk<typename container::const_iterator> &c : chunks)
+    {
+        BOOST_REQUIRE( c.first == it );
+        BOOST_REQUIRE( c.first != c.last );
+        BOOST_REQUIRE( utf8::is_valid( c.first, c.last ) );
+        BOOST_REQUIRE_EQUAL( c.code_points, static_cast<std::size_t>(utf8::distance( c.first, c.last )) );
+        BOOST_REQUIRE_EQUAL( c.utf16_length, utf8::utf16_length_from_utf8( c.first, c.last ) );
+        BOOST_REQUIRE_EQUAL( c.ascii, std::all_of( c.first, c.last, []( char oc ) { return (oc & 0x80) == 0; } ) );
+        it = c.last;
+    }
+    BOOST_REQUIRE( it == text.end( ) );
+}
+
+struct chunk_fixture : fixtures::mixed_u8
+{
+    std::string str;
+
+    chunk_fixture( )
+    {
+        // starts with plenty of ASCII, so that some chunks are ASCII only
+        str = std::string( 300, 'a' );
+        for (int i = 0; i < 8; ++i)
+        {
+            str += text;
+        }
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( split_at_boundaries, chunk_fixture )
+{
+    const std::deque<char> str_deque( str.cbegin( ), str.cend( ) );
+    for (std::size_t n : { 1, 2, 3, 7, 16, 100, 1000, 5000 })
+    {
+        BOOST_TEST_CHECKPOINT( "split_at_boundaries n=" << n );
+        const std::vector<utf8::chunk<std::string::const_iterator>> chunks
+            = utf8::split_at_boundaries( str.cbegin( ), str.cend( ), n );
+        BOOST_REQUIRE( chunks.size( ) <= n );
+        require_valid_chunks( str, chunks );
+        if (n <= 16)
+        {
+            // no chunk is far off the ideal size
+            BOOST_REQUIRE_EQUAL( chunks.size( ), n );
+            for (const utf8::chunk<std::string::const_iterator> &c : chunks)
+            {
+                BOOST_REQUIRE( std::abs( (c.last - c.first) - static_cast<std::ptrdiff_t>(str.size( ) / n) ) <= 4 );
+            }
+        }
+
+        const std::vector<utf8::chunk<std::deque<char>::const_iterator>> deque_chunks
+            = utf8::split_at_boundaries( str_deque.cbegin( ), str_deque.cend( ), n );
+        require_valid_chunks( str_deque, deque_chunks );
+        BOOST_REQUIRE_EQUAL( deque_chunks.size( ), chunks.size( ) );
+        for (std::size_t i = 0; i < chunks.size( ); ++i)
+        {
+            BOOST_REQUIRE_EQUAL( deque_chunks[i].last - str_deque.cbegin( ), chunks[i].last - str.cbegin( ) );
+        }
+    }
+    BOOST_CHECK( utf8::split_at_boundaries( str.cend( ), str.cend( ), 4 ).empty( ) );
+    BOOST_CHECK_THROW( utf8::split_at_boundaries( str.cbegin( ), str.cend( ), 0 ), std::invalid_argument );
+}
+
+BOOST_FIXTURE_TEST_CASE( chunk_view, chunk_fixture )
+{
+    const std::deque<char> str_deque( str.cbegin( ), str.cend( ) );
+    for (std::size_t size : { 1, 2, 3, 4, 5, 64, 1000, 100000 })
+    {
+        BOOST_TEST_CHECKPOINT( "chunk_view size=" << size );
+        const utf8::chunk_view<std::string::const_iterator> view( str.cbegin( ), str.cend( ), size );
+        const std::vector<utf8::chunk<std::string::const_iterator>> chunks( view.begin( ), view.end( ) );
+        require_valid_chunks( str, chunks );
+        for (const utf8::chunk<std::string::const_iterator> &c : chunks)
+        {
+            // a chunk only exceeds the size if a single sequence does
+            BOOST_REQUIRE( static_cast<std::size_t>(c.last - c.first) <= std::max<std::size_t>( size, 4 ) );
+        }
+
+        const utf8::chunk_view<std::deque<char>::const_iterator> deque_view( str_deque.cbegin( ), str_deque.cend( ), size );
+        const std::vector<utf8::chunk<std::deque<char>::const_iterator>> deque_chunks( deque_view.begin( ), deque_view.end( ) );
+        require_valid_chunks( str_deque, deque_chunks );
+        BOOST_REQUIRE_EQUAL( deque_chunks.size( ), chunks.size( ) );
+    }
+    const utf8::chunk_view<std::string::const_iterator> empty( str.cend( ), str.cend( ), 16 );
+    BOOST_CHECK( empty.begin( ) == empty.end( ) );
+    BOOST_CHECK_THROW( utf8::chunk_view<std::string::const_iterator>( str.cbegin( ), str.cend( ), 0 ), std::invalid_argument );
+}
+
+// chunks of invalid input still start at sequence boundaries, i.e. they
+// are validated like the whole input
+BOOST_FIXTURE_TEST_CASE( invalid_input, fixtures::malformed_u8 )
+{
+    for (const char *invalid : malformed)
+    {
+        std::string str;
+        for (int i = 0; i < 20; ++i)
+        {
+            str += u8"ä日";
+            str += invalid;
+        }
+        const std::string::const_iterator first_invalid = utf8::find_invalid( str.cbegin( ), str.cend( ) );
+        for (std::size_t n = 1; n <= 40; ++n)
+        {
+            BOOST_TEST_CHECKPOINT( "invalid_input n=" << n );
+            for (const utf8::chunk<std::string::const_iterator> &c : utf8::split_at_boundaries( str.cbegin( ), str.cend( ), n ))
+            {
+                const std::string::const_iterator invalid = utf8::find_invalid( c.first, c.last );
+                if (c.last <= first_invalid)
+                {
+                    BOOST_REQUIRE( invalid == c.last );
+                }
+                else
+                {
+                    BOOST_REQUIRE( invalid == first_invalid );
+                    break;
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
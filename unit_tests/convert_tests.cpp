@@ -0,0 +1,136 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+#include <utf8.h>
+
+#include "fixtures.hpp"
+
+BOOST_AUTO_TEST_SUITE( utf8ut_convert )
+
+struct convert_fixture : fixtures::mixed_u8
+{
+    std::u16string text16;
+    std::u32string text32;
+
+    convert_fixture( )
+    {
+        utf8::utf8to16( text.cbegin( ), text.cend( ), std::back_inserter( text16 ) );
+        utf8::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( text32 ) );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( to_string, convert_fixture )
+{
+    BOOST_REQUIRE( utf8::to_u16string( text ) == text16 );
+    BOOST_REQUIRE( utf8::to_u32string( text ) == text32 );
+    BOOST_REQUIRE( utf8::to_u8string( text16 ) == text );
+    BOOST_REQUIRE( utf8::to_u32string( text16 ) == text32 );
+    BOOST_REQUIRE( utf8::to_u8string( text32 ) == text );
+    BOOST_REQUIRE( utf8::to_u16string( text32 ) == text16 );
+
+    // the std::deque takes the scalar path
+    const std::deque<char> scalar_text( text.cbegin( ), text.cend( ) );
+    const std::deque<char16_t> scalar_text16( text16.cbegin( ), text16.cend( ) );
+    BOOST_REQUIRE( utf8::to_u16string( scalar_text.cbegin( ), scalar_text.cend( ) ) == text16 );
+    BOOST_REQUIRE( utf8::to_u8string( scalar_text16.cbegin( ), scalar_text16.cend( ) ) == text );
+
+    // the encoding of wide strings depends on the size of wchar_t
+    std::wstring wide;
+    if (sizeof( wchar_t ) == 2)
+        wide.assign( text16.cbegin( ), text16.cend( ) );
+    else
+        wide.assign( text32.cbegin( ), text32.cend( ) );
+    BOOST_REQUIRE( utf8::to_u8string( wide ) == text );
+
+    BOOST_REQUIRE( utf8::to_u16string( std::string( ) ).empty( ) );
+    BOOST_REQUIRE( utf8::to_u8string( std::u32string( ) ).empty( ) );
+}
+
+// the length of the utf-16 string is counted by the simd kernel
+BOOST_AUTO_TEST_CASE( supplementary_input )
+{
+    std::string str;
+    std::u16string expected;
+    for (int i = 0; i < 3000; ++i)
+    {
+        str += u8"\U0001F600\U00010346";
+        expected += u"\U0001F600\U00010346";
+    }
+    BOOST_REQUIRE( utf8::to_u16string( str ) == expected );
+    BOOST_REQUIRE( utf8::to_u8string( expected ) == str );
+}
+
+static std::size_t allocations = 0;
+
+template< typename T >
+struct counting_allocator
+{
+    typedef T value_type;
+
+    counting_allocator( )
+    {
+    }
+
+    template< typename U >
+    counting_allocator( const counting_allocator<U> & )
+    {
+    }
+
+    T *allocate( std::size_t n )
+    {
+        ++allocations;
+        return std::allocator<T>( ).allocate( n );
+    }
+
+    void deallocate( T *p, std::size_t n )
+    {
+        std::allocator<T>( ).deallocate( p, n );
+    }
+
+    template< typename U >
+    bool operator ==( const counting_allocator<U> & ) const
+    {
+        return true;
+    }
+
+    template< typename U >
+    bool operator !=( const counting_allocator<U> & ) const
+    {
+        return false;
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( single_allocation, convert_fixture )
+{
+    const std::string text4 = text + text + text + text;
+    const std::u16string text16_4 = text16 + text16 + text16 + text16;
+
+    allocations = 0;
+    const auto u16 = utf8::to_u16string( text4, counting_allocator<char16_t>( ) );
+    BOOST_REQUIRE_EQUAL( allocations, 1u );
+    BOOST_REQUIRE( std::u16string( u16.cbegin( ), u16.cend( ) ) == text16_4 );
+
+    allocations = 0;
+    const auto u8 = utf8::to_u8string( text16_4.cbegin( ), text16_4.cend( ), counting_allocator<char>( ) );
+    BOOST_REQUIRE_EQUAL( allocations, 1u );
+    BOOST_REQUIRE( std::string( u8.cbegin( ), u8.cend( ) ) == text4 );
+}
+
+BOOST_FIXTURE_TEST_CASE( invalid_input, convert_fixture )
+{
+    BOOST_REQUIRE_THROW( utf8::to_u16string( text + "\xC0\xAF" + text ), utf8::invalid_utf8 );
+    BOOST_REQUIRE_THROW( utf8::to_u32string( text + "\xF0\x9F" ), utf8::not_enough_room );
+    BOOST_REQUIRE_THROW( utf8::to_u8string( text16 + char16_t( 0xD800 ) ), utf8::invalid_utf16 );
+    BOOST_REQUIRE_THROW( utf8::to_u16string( text32 + char32_t( 0x110000 ) + text32 ), utf8::invalid_code_point );
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
@@ -3,6 +3,12 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
 ////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <string>
+
 #include <boost/test/unit_test.hpp>
 
 #include <utf8.h>
@@ -19,6 +25,113 @@ BOOST_FIXTURE_TEST_CASE( find_invalid, fixtures::invalid_u8 )
     BOOST_CHECK( invalid == enc.cbegin( ) + first_invalid_index );
 }
 
+BOOST_FIXTURE_TEST_CASE( find_invalid_contiguous, fixtures::invalid_u8 )
+{
+    const char *const first = enc.data( );
+    BOOST_CHECK( utf8::find_invalid( first, first + enc.size( ) ) == first + first_invalid_index );
+    BOOST_CHECK( utf8::find_invalid( first, first + first_invalid_index ) == first + first_invalid_index );
+    BOOST_CHECK( utf8::find_invalid( first, first ) == first );
+}
+
+// std::deque iterators aren't contiguous and therefore take the scalar path
+static std::ptrdiff_t scalar_find_invalid( const std::string &str )
+{
+    const std::deque<char> buffer( str.cbegin( ), str.cend( ) );
+    return utf8::find_invalid( buffer.cbegin( ), buffer.cend( ) ) - buffer.cbegin( );
+}
+
+struct find_invalid_fixture : fixtures::mixed_u8, fixtures::malformed_u8 {};
+
+BOOST_FIXTURE_TEST_CASE( find_invalid_matches_scalar, find_invalid_fixture )
+{
+    BOOST_REQUIRE( utf8::is_valid( text.cbegin( ), text.cend( ) ) );
+
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text.size( ); ++pos)
+        {
+            std::string str = text;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "find_invalid_matches_scalar pos=" << pos );
+            BOOST_REQUIRE_EQUAL( utf8::find_invalid( str.cbegin( ), str.cend( ) ) - str.cbegin( ),
+                scalar_find_invalid( str ) );
+        }
+    }
+
+    // sequences cut off by the end of the range
+    for (size_t length = 0; length <= text.size( ); ++length)
+    {
+        const std::string str = text.substr( 0, length );
+        BOOST_TEST_CHECKPOINT( "find_invalid_matches_scalar length=" << length );
+        BOOST_REQUIRE_EQUAL( utf8::find_invalid( str.cbegin( ), str.cend( ) ) - str.cbegin( ),
+            scalar_find_invalid( str ) );
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( find_last_invalid_matches_scalar, find_invalid_fixture )
+{
+    // long enough for several windows
+    std::string text32;
+    for (int i = 0; i < 32; ++i)
+    {
+        text32 += text;
+    }
+    BOOST_CHECK( utf8::find_last_invalid( text32.cbegin( ), text32.cend( ) ) == text32.cend( ) );
+
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text32.size( ); pos += pos < 300 || pos > text32.size( ) - 300 ? 1 : 61)
+        {
+            std::string str = text32;
+            str.insert( pos, invalid );
+            if (pos % 2 == 0)
+            {
+                str.insert( pos / 2, "\xC0\xAF" );
+            }
+            const std::deque<char> scalar_str( str.cbegin( ), str.cend( ) );
+            BOOST_TEST_CHECKPOINT( "find_last_invalid_matches_scalar pos=" << pos );
+            BOOST_REQUIRE_EQUAL( utf8::find_last_invalid( str.cbegin( ), str.cend( ) ) - str.cbegin( ),
+                utf8::find_last_invalid( scalar_str.cbegin( ), scalar_str.cend( ) ) - scalar_str.cbegin( ) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( find_last_invalid )
+{
+    const std::string str = "a\xE6\x97\xA5\x80\xE6\x97\xA5\xE6\x97";
+    const std::deque<char> scalar_str( str.cbegin( ), str.cend( ) );
+    BOOST_CHECK( utf8::find_last_invalid( str.cbegin( ), str.cend( ) ) == str.cbegin( ) + 8 );
+    BOOST_CHECK( utf8::find_last_invalid( str.cbegin( ), str.cend( ) - 2 ) == str.cbegin( ) + 4 );
+    BOOST_CHECK( utf8::find_last_invalid( scalar_str.cbegin( ), scalar_str.cend( ) ) == scalar_str.cbegin( ) + 8 );
+    BOOST_CHECK( utf8::find_last_invalid( str.cbegin( ), str.cbegin( ) + 4 ) == str.cbegin( ) + 4 );
+}
+
+BOOST_FIXTURE_TEST_CASE( truncate_to_boundary, fixtures::mixed_u8 )
+{
+    for (size_t max = 0; max <= text.size( ) + 1; ++max)
+    {
+        std::string::const_iterator cut = utf8::truncate_to_boundary( text.cbegin( ), text.cend( ), max );
+        BOOST_TEST_CHECKPOINT( "truncate_to_boundary max=" << max );
+        BOOST_REQUIRE( static_cast<size_t>(cut - text.cbegin( )) <= max );
+        BOOST_REQUIRE( utf8::is_valid( text.cbegin( ), cut ) );
+        // the longest valid prefix
+        BOOST_REQUIRE( cut == text.cend( ) || static_cast<size_t>(cut - text.cbegin( ))
+            + utf8::detail::sequence_length<size_t>( static_cast<uint8_t>(*cut) ) > max );
+    }
+
+    // stray continuations aren't backed off over, a truncated sequence is cut
+    // off as a whole
+    const std::string stray = "ab\x80\x80\x80\x80";
+    BOOST_CHECK( utf8::truncate_to_boundary( stray.cbegin( ), stray.cend( ), 4 ) == stray.cbegin( ) + 4 );
+    const std::string truncated = "a\xE6\x97" "b";
+    BOOST_CHECK( utf8::truncate_to_boundary( truncated.cbegin( ), truncated.cend( ), 2 ) == truncated.cbegin( ) + 1 );
+    BOOST_CHECK( utf8::truncate_to_boundary( truncated.cbegin( ), truncated.cend( ), 3 ) == truncated.cbegin( ) + 1 );
+    BOOST_CHECK( utf8::truncate_to_boundary( truncated.cbegin( ), truncated.cend( ), 4 ) == truncated.cend( ) );
+    const std::deque<char> scalar_truncated( truncated.cbegin( ), truncated.cend( ) );
+    BOOST_CHECK( utf8::truncate_to_boundary( scalar_truncated.cbegin( ), scalar_truncated.cend( ), 2 )
+        == scalar_truncated.cbegin( ) + 1 );
+}
+
 BOOST_FIXTURE_TEST_CASE( starts_with_bom, fixtures::valid_u8_with_it )
 {
     unsigned char bom[] = { 0xef, 0xbb, 0xbf };
@@ -28,4 +141,99 @@ BOOST_FIXTURE_TEST_CASE( starts_with_bom, fixtures::valid_u8_with_it )
     BOOST_CHECK( !utf8::starts_with_bom( enc_u8_beg, enc_u8_end ) );
 }
 
+BOOST_FIXTURE_TEST_CASE( length_from, fixtures::mixed_u8 )
+{
+    // long enough to overflow the narrow counters of the kernels
+    std::string long_text;
+    while (long_text.size( ) < 300000)
+    {
+        long_text += text;
+    }
+
+    for (size_t length = 0; length <= text.size( ) + 1; ++length)
+    {
+        // the last length checks the long text
+        const std::string str = length <= text.size( ) ? text.substr( 0, length ) : long_text;
+        if (!utf8::is_valid( str.cbegin( ), str.cend( ) ))
+        {
+            continue;
+        }
+        BOOST_TEST_CHECKPOINT( "length_from length=" << length );
+        std::u16string u16;
+        std::u32string u32;
+        utf8::utf8to16( str.cbegin( ), str.cend( ), std::back_inserter( u16 ) );
+        utf8::utf8to32( str.cbegin( ), str.cend( ), std::back_inserter( u32 ) );
+        const std::deque<char> scalar_str( str.cbegin( ), str.cend( ) );
+        const std::deque<char16_t> scalar_u16( u16.cbegin( ), u16.cend( ) );
+        const std::deque<char32_t> scalar_u32( u32.cbegin( ), u32.cend( ) );
+
+        BOOST_REQUIRE_EQUAL( utf8::utf16_length_from_utf8( str.cbegin( ), str.cend( ) ), u16.size( ) );
+        BOOST_REQUIRE_EQUAL( utf8::utf16_length_from_utf8( scalar_str.cbegin( ), scalar_str.cend( ) ), u16.size( ) );
+        BOOST_REQUIRE_EQUAL( utf8::utf32_length_from_utf8( str.cbegin( ), str.cend( ) ), u32.size( ) );
+        BOOST_REQUIRE_EQUAL( utf8::utf32_length_from_utf8( scalar_str.cbegin( ), scalar_str.cend( ) ), u32.size( ) );
+        BOOST_REQUIRE_EQUAL( utf8::utf8_length_from_utf16( u16.cbegin( ), u16.cend( ) ), str.size( ) );
+        BOOST_REQUIRE_EQUAL( utf8::utf8_length_from_utf16( scalar_u16.cbegin( ), scalar_u16.cend( ) ), str.size( ) );
+        BOOST_REQUIRE_EQUAL( utf8::utf8_length_from_utf32( u32.cbegin( ), u32.cend( ) ), str.size( ) );
+        BOOST_REQUIRE_EQUAL( utf8::utf8_length_from_utf32( scalar_u32.cbegin( ), scalar_u32.cend( ) ), str.size( ) );
+        BOOST_REQUIRE_EQUAL( utf8::latin1_length_from_utf8( str.cbegin( ), str.cend( ) ), u32.size( ) );
+
+        // the low octets of the code points as Latin-1
+        std::string latin1;
+        std::size_t latin1_u8_size = 0;
+        for (char32_t cp : u32)
+        {
+            latin1 += static_cast<char>(cp & 0xFF);
+            latin1_u8_size += (cp & 0xFF) < 0x80 ? 1 : 2;
+        }
+        const std::deque<char> scalar_latin1( latin1.cbegin( ), latin1.cend( ) );
+        BOOST_REQUIRE_EQUAL( utf8::utf8_length_from_latin1( latin1.cbegin( ), latin1.cend( ) ), latin1_u8_size );
+        BOOST_REQUIRE_EQUAL( utf8::utf8_length_from_latin1( scalar_latin1.cbegin( ), scalar_latin1.cend( ) ), latin1_u8_size );
+    }
+}
+
+// Each four octet lead accounts for two UTF-16 code units, so texts of
+// supplementary code points exercise the counters of the kernels most.
+BOOST_AUTO_TEST_CASE( utf16_length_from_supplementary_utf8 )
+{
+    for (std::size_t count : { 1, 100, 1000, 2000, 4000 })
+    {
+        std::string str;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            str += i % 3 == 0 ? u8"\U0001F600" : i % 3 == 1 ? u8"\U00010346" : u8"\U0010FFFF";
+        }
+        const std::deque<char> scalar_str( str.cbegin( ), str.cend( ) );
+        BOOST_TEST_CHECKPOINT( "utf16_length_from_supplementary_utf8 count=" << count );
+        BOOST_REQUIRE_EQUAL( utf8::utf16_length_from_utf8( scalar_str.cbegin( ), scalar_str.cend( ) ), 2 * count );
+        BOOST_REQUIRE_EQUAL( utf8::utf16_length_from_utf8( str.cbegin( ), str.cend( ) ), 2 * count );
+        BOOST_REQUIRE_EQUAL( utf8::utf32_length_from_utf8( str.cbegin( ), str.cend( ) ), count );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( branchless_primitives )
+{
+    for (unsigned lead = 0; lead < 0x100; ++lead)
+    {
+        const int expected = lead < 0x80 ? 1 : lead < 0xC0 ? 0 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF8 ? 4 : 0;
+        BOOST_REQUIRE_EQUAL( utf8::detail::sequence_length<int>( static_cast<uint8_t>(lead) ), expected );
+        BOOST_REQUIRE_EQUAL( utf8::detail::dispatch_length<int>( static_cast<uint8_t>(lead) ), expected );
+    }
+
+    // the pointer overload of encode against the one for other iterators
+    for (char32_t cp = 0; cp <= utf8::detail::CODE_POINT_MAX; ++cp)
+    {
+        char octets[5] = { 'x', 'x', 'x', 'x', 'x' };
+        std::deque<char> expected;
+        utf8::detail::encode( cp, std::back_inserter( expected ) );
+        char *const end = utf8::detail::encode( cp, octets );
+        BOOST_REQUIRE_EQUAL( end - octets, utf8::detail::encoded_utf8_size<std::ptrdiff_t>( cp ) );
+        if (!std::equal( expected.cbegin( ), expected.cend( ), octets ) || *end != 'x')
+        {
+            BOOST_TEST_CHECKPOINT( "branchless_primitives cp=" << static_cast<uint32_t>(cp) );
+            BOOST_REQUIRE( false );
+        }
+    }
+    BOOST_REQUIRE_EQUAL( utf8::detail::encoded_utf8_size<int>( utf8::detail::CODE_POINT_MAX + 1 ), 0 );
+}
+
 BOOST_AUTO_TEST_SUITE_END( )
@@ -0,0 +1,124 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+#include <boost/test/unit_test.hpp>
+
+#include <utf8.h>
+#include <utf8/file.h>
+
+#include "fixtures.hpp"
+
+BOOST_AUTO_TEST_SUITE( utf8ut_file )
+
+// the files are created in the working directory and removed afterwards
+struct file_fixture : fixtures::mixed_u8
+{
+    const std::string input_path = "utf8ut_file_input.txt";
+    const std::string output_path = "utf8ut_file_output.bin";
+
+    ~file_fixture( )
+    {
+        std::remove( input_path.c_str( ) );
+        std::remove( output_path.c_str( ) );
+    }
+
+    void write_input( const std::string &content ) const
+    {
+        std::ofstream( input_path, std::ios::binary ) << content;
+    }
+
+    std::string read_output( ) const
+    {
+        std::ifstream stream( output_path, std::ios::binary );
+        return std::string( std::istreambuf_iterator<char>( stream ), std::istreambuf_iterator<char>( ) );
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE( transcode, file_fixture )
+{
+    write_input( text );
+    const utf8::file input( input_path );
+    BOOST_REQUIRE_EQUAL( input.size( ), text.size( ) );
+    BOOST_REQUIRE( utf8::is_valid( input ) );
+
+    std::u16string expected16;
+    utf8::utf8to16( text.cbegin( ), text.cend( ), std::back_inserter( expected16 ) );
+    utf8::utf8to16( input, output_path );
+    BOOST_REQUIRE( read_output( ) == std::string( reinterpret_cast<const char *>(expected16.data( )), 2 * expected16.size( ) ) );
+
+    std::u32string expected32;
+    utf8::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( expected32 ) );
+    utf8::utf8to32( input, output_path );
+    BOOST_REQUIRE( read_output( ) == std::string( reinterpret_cast<const char *>(expected32.data( )), 4 * expected32.size( ) ) );
+}
+
+// the output file is sized by the simd kernel which counts four octet leads
+BOOST_FIXTURE_TEST_CASE( supplementary_input, file_fixture )
+{
+    std::string str;
+    for (int i = 0; i < 4000; ++i)
+    {
+        str += u8"\U0001F600\U00010346";
+    }
+    write_input( str );
+    const utf8::file input( input_path );
+
+    std::u16string expected16;
+    utf8::utf8to16( str.cbegin( ), str.cend( ), std::back_inserter( expected16 ) );
+    utf8::utf8to16( input, output_path );
+    BOOST_REQUIRE( read_output( ) == std::string( reinterpret_cast<const char *>(expected16.data( )), 2 * expected16.size( ) ) );
+}
+
+BOOST_FIXTURE_TEST_CASE( invalid_input, file_fixture )
+{
+    const std::string str = text + "\xED\xA0\x80" + text + "\xE6\x97";
+    write_input( str );
+    const utf8::file input( input_path );
+    BOOST_REQUIRE_EQUAL( utf8::find_invalid( input ), text.size( ) );
+    BOOST_REQUIRE_THROW( utf8::utf8to16( input, output_path ), utf8::invalid_code_point );
+
+    std::string expected;
+    utf8::replace_invalid( str.cbegin( ), str.cend( ), std::back_inserter( expected ) );
+    utf8::replace_invalid( input, output_path );
+    BOOST_REQUIRE( read_output( ) == expected );
+}
+
+// the windows the file is processed in must not cut the valid sequence in
+// front of stray continuations which straddle a window boundary
+BOOST_FIXTURE_TEST_CASE( invalid_input_at_window_boundary, file_fixture )
+{
+    const std::string str = std::string( utf8::detail::file_window_size - 4, 'a' )
+        + "\xC3\xA9\x80\x80\x80" + std::string( 10, 'b' );
+    write_input( str );
+    const utf8::file input( input_path );
+    BOOST_REQUIRE_EQUAL( utf8::find_invalid( input ),
+        static_cast<std::size_t>(utf8::find_invalid( str.cbegin( ), str.cend( ) ) - str.cbegin( )) );
+    BOOST_REQUIRE_THROW( utf8::utf8to16( input, output_path ), utf8::invalid_utf8 );
+
+    std::string expected;
+    utf8::replace_invalid( str.cbegin( ), str.cend( ), std::back_inserter( expected ) );
+    utf8::replace_invalid( input, output_path );
+    BOOST_REQUIRE( read_output( ) == expected );
+}
+
+BOOST_FIXTURE_TEST_CASE( empty_and_missing_files, file_fixture )
+{
+    write_input( std::string( ) );
+    const utf8::file input( input_path );
+    BOOST_REQUIRE( input.begin( ) == input.end( ) );
+    BOOST_REQUIRE( utf8::is_valid( input ) );
+    utf8::utf8to32( input, output_path );
+    BOOST_REQUIRE( read_output( ).empty( ) );
+
+    BOOST_REQUIRE_THROW( utf8::file( "utf8ut_file_missing.txt" ), std::system_error );
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
@@ -54,6 +54,27 @@ struct valid_u32_with_it : valid_u32
     const std::u32string::const_iterator dec_end = dec.cend( );
 };
 
+// long enough to span several SIMD blocks and mixes all sequence lengths
+struct mixed_u8 : virtual boost::noncopyable
+{
+    const std::string text = std::string( u8"The quick brown fox jumps over the lazy dog. " )
+        + u8"\u0421\u044A\u0435\u0448\u044C \u0436\u0435 \u0435\u0449\u0451 \u044D\u0442\u0438\u0445 \u043C\u044F\u0433\u043A\u0438\u0445 "
+        + u8"\u65E5\u672C\u8A9E\u306E\u30C6\u30AD\u30B9\u30C8 "
+        + u8"\U0001F600\U0001F44D\U00010346\U0001D11E\U0010FFFF "
+        + u8"ASCII again, then \u00E4\u00F6\u00FC\u00DF and \uFFFD\uD7FF\uE000 mixed "
+        + u8"\u0448\U0001F600a\u65E5b\u00E9c\U0001D11E\u3044\u0041";
+};
+
+// malformed sequences to be spliced into mixed_u8::text
+struct malformed_u8 : virtual boost::noncopyable
+{
+    const std::array< const char *, 14 > malformed = {
+        "\x80", "\xBF\x80", "\xC0\xAF", "\xC1\xBF", "\xE0\x80\xAF", "\xE6\x97",
+        "\xED\xA0\x80", "\xF0\x80\x80\xAF", "\xF0\x9F\x98", "\xF4\x90\x80\x80",
+        "\xF5\x80\x80\x80", "\xF8\x88\x80\x80\x80", "\xFE", "\xFF",
+    };
+};
+
 struct invalid_u8 : virtual boost::noncopyable
 {
     const std::string enc = "\xe6\x97\xa5\xd1\x88\xFA \x80\xE0\xA0\xC0\xAF\xED\xA0\x80z";
@@ -0,0 +1,56 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#include <array>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+#include <utf8.h>
+
+BOOST_AUTO_TEST_SUITE( utf8ut_literal )
+
+// U+0041 U+00E4 U+20AC U+1F600
+#define MIXED_LITERAL "A\xC3\xA4\xE2\x82\xAC\xF0\x9F\x98\x80"
+
+static_assert( utf8::static_utf16_length( MIXED_LITERAL ) == 5, "" );
+static_assert( utf8::static_utf32_length( MIXED_LITERAL ) == 4, "" );
+static_assert( utf8::static_utf16_length( "" ) == 0, "" );
+
+constexpr auto mixed16 = UTF8_STATIC_U16( MIXED_LITERAL );
+constexpr auto mixed32 = UTF8_STATIC_U32( MIXED_LITERAL );
+static_assert( mixed16.size( ) == 5 && mixed16[0] == 0x41 && mixed16[1] == 0xE4 && mixed16[2] == 0x20AC
+    && mixed16[3] == 0xD83D && mixed16[4] == 0xDE00, "" );
+static_assert( mixed32.size( ) == 4 && mixed32[2] == 0x20AC && mixed32[3] == 0x1F600, "" );
+
+static_assert( utf8::detail::sequence_length<int>( 0xE2 ) == 3, "" );
+static_assert( utf8::detail::encoded_utf8_size<int>( 0x10FFFF ) == 4, "" );
+
+BOOST_AUTO_TEST_CASE( matches_runtime )
+{
+    std::u16string text16;
+    std::u32string text32;
+    const std::string literal = MIXED_LITERAL;
+    utf8::utf8to16( literal.cbegin( ), literal.cend( ), std::back_inserter( text16 ) );
+    utf8::utf8to32( literal.cbegin( ), literal.cend( ), std::back_inserter( text32 ) );
+
+    BOOST_REQUIRE( std::u16string( mixed16.cbegin( ), mixed16.cend( ) ) == text16 );
+    BOOST_REQUIRE( std::u32string( mixed32.cbegin( ), mixed32.cend( ) ) == text32 );
+}
+
+BOOST_AUTO_TEST_CASE( invalid_literal )
+{
+    // the same expressions wouldn't compile in a constant expression
+    BOOST_REQUIRE_THROW( utf8::static_utf16_length( "a\xC0\xAF" ), utf8::invalid_utf8 );
+    BOOST_REQUIRE_THROW( utf8::static_utf16_length( "\xE2\x82" ), utf8::invalid_utf8 );
+    BOOST_REQUIRE_THROW( utf8::static_utf32_length( "\xED\xA0\x80" ), utf8::invalid_utf8 );
+    BOOST_REQUIRE_THROW( utf8::static_utf32_length( "a\x80" ), utf8::invalid_utf8 );
+    BOOST_REQUIRE_THROW( utf8::static_utf8to16<3>( "ab" ), std::invalid_argument );
+    BOOST_REQUIRE_NO_THROW( utf8::static_utf8to32<2>( "ab" ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
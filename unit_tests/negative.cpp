@@ -123,7 +123,7 @@ BOOST_FIXTURE_TEST_CASE( first_possible_sequences_of_certain_length, first_possi
             it = encoded[i].cbegin( ),
             end = encoded[i].cend( );
 
-        BOOST_CHECKPOINT( "first_possible_sequences_of_certain_length i=" << i );
+        BOOST_TEST_CHECKPOINT( "first_possible_sequences_of_certain_length i=" << i );
         char32_t dec_char = utf8::next( it, end );
         BOOST_CHECK_EQUAL( dec_char, decoded[i] );
     }
@@ -137,7 +137,7 @@ BOOST_FIXTURE_TEST_CASE( last_possible_sequences_of_certain_length, last_possibl
             it = encoded[i].cbegin( ),
             end = encoded[i].cend( );
 
-        BOOST_CHECKPOINT( "last_possible_sequences_of_certain_length i=" << i );
+        BOOST_TEST_CHECKPOINT( "last_possible_sequences_of_certain_length i=" << i );
         char32_t dec_char = utf8::next( it, end );
         BOOST_CHECK_EQUAL( dec_char, decoded[i] );
     }
@@ -151,7 +151,7 @@ BOOST_FIXTURE_TEST_CASE( misc_boundary_conditions, misc_boundary_conditions_fixt
             it = encoded[i].cbegin( ),
             end = encoded[i].cend( );
 
-        BOOST_CHECKPOINT( "misc_boundary_conditions i=" << i );
+        BOOST_TEST_CHECKPOINT( "misc_boundary_conditions i=" << i );
         char32_t dec_char = utf8::next( it, end );
         BOOST_CHECK_EQUAL( dec_char, decoded[i] );
     }
@@ -207,7 +207,7 @@ BOOST_FIXTURE_TEST_CASE( first_possible_sequences_of_certain_length, first_possi
             it = encoded[i].cbegin( ),
             end = encoded[i].cend( );
 
-        BOOST_CHECKPOINT( "first_possible_sequences_of_certain_length i=" << i );
+        BOOST_TEST_CHECKPOINT( "first_possible_sequences_of_certain_length i=" << i );
         char32_t dec_char = utf8::unchecked::next( it );
         BOOST_CHECK_EQUAL( dec_char, decoded[i] );
     }
@@ -221,7 +221,7 @@ BOOST_FIXTURE_TEST_CASE( last_possible_sequences_of_certain_length, last_possibl
             it = encoded[i].cbegin( ),
             end = encoded[i].cend( );
 
-        BOOST_CHECKPOINT( "last_possible_sequences_of_certain_length i=" << i );
+        BOOST_TEST_CHECKPOINT( "last_possible_sequences_of_certain_length i=" << i );
         char32_t dec_char = utf8::unchecked::next( it );
         BOOST_CHECK_EQUAL( dec_char, decoded[i] );
     }
@@ -235,7 +235,7 @@ BOOST_FIXTURE_TEST_CASE( misc_boundary_conditions, misc_boundary_conditions_fixt
             it = encoded[i].cbegin( ),
             end = encoded[i].cend( );
 
-        BOOST_CHECKPOINT( "misc_boundary_conditions i=" << i );
+        BOOST_TEST_CHECKPOINT( "misc_boundary_conditions i=" << i );
         char32_t dec_char = utf8::unchecked::next( it );
         BOOST_CHECK_EQUAL( dec_char, decoded[i] );
     }
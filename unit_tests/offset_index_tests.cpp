@@ -0,0 +1,112 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <utf8.h>
+
+#include "fixtures.hpp"
+
+BOOST_AUTO_TEST_SUITE( utf8ut_offset_index )
+
+// Compares every lookup with a linear scan, the deque takes the scalar path.
+template< typename container >
+static void require_consistent_index( const container &text, std::size_t interval )
+{
+    BOOST_TEST_CHECKPOINT( "offset_index interval=" << interval );
+    const utf8::offset_index index( text.begin( ), text.end( ), interval );
+    BOOST_REQUIRE_EQUAL( index.interval( ), interval );
+    BOOST_REQUIRE_EQUAL( index.octets( ), text.size( ) );
+    BOOST_REQUIRE_EQUAL( index.code_points( ),
+        static_cast<std::size_t>(utf8::distance( text.begin( ), text.end( ) )) );
+
+    auto it = text.begin( );
+    for (std::size_t n = 0; n <= index.code_points( ); ++n)
+    {
+        BOOST_REQUIRE( index.advance( text.begin( ), n ) == it );
+        BOOST_REQUIRE_EQUAL( index.offset( text.begin( ), n ), static_cast<std::size_t>(it - text.begin( )) );
+        BOOST_REQUIRE_EQUAL( index.distance( text.begin( ), it ), n );
+        if (it != text.end( ))
+        {
+            // the trail octets belong to code point n, too
+            auto trail = it;
+            utf8::next( trail, text.end( ) );
+            for (auto pos = it + 1; pos != trail; ++pos)
+            {
+                BOOST_REQUIRE_EQUAL( index.index( text.begin( ), pos - text.begin( ) ), n );
+            }
+            it = trail;
+        }
+    }
+    BOOST_REQUIRE_THROW( index.advance( text.begin( ), index.code_points( ) + 1 ), std::out_of_range );
+    BOOST_REQUIRE_THROW( index.index( text.begin( ), text.size( ) + 1 ), std::out_of_range );
+}
+
+BOOST_FIXTURE_TEST_CASE( lookup, fixtures::mixed_u8 )
+{
+    std::string str;
+    for (int i = 0; i < 20; ++i)
+    {
+        str += text;
+    }
+    const std::deque<char> str_deque( str.cbegin( ), str.cend( ) );
+    for (std::size_t interval : { 1, 3, 16, 17, 64, 1000 })
+    {
+        require_consistent_index( str, interval );
+        require_consistent_index( str_deque, interval );
+    }
+    require_consistent_index( std::string( ), 64 );
+}
+
+BOOST_FIXTURE_TEST_CASE( substr, fixtures::mixed_u8 )
+{
+    const utf8::offset_index index( text.cbegin( ), text.cend( ), 7 );
+    std::u32string u32;
+    utf8::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( u32 ) );
+    for (std::size_t pos = 0; pos <= u32.size( ); pos += 5)
+    {
+        for (std::size_t count : { std::size_t( 0 ), std::size_t( 1 ), std::size_t( 13 ), std::string::npos })
+        {
+            std::string expected;
+            const std::u32string part = u32.substr( pos, count );
+            utf8::utf32to8( part.cbegin( ), part.cend( ), std::back_inserter( expected ) );
+            BOOST_REQUIRE( index.substr( text, pos, count ) == expected );
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( serialization, fixtures::mixed_u8 )
+{
+    for (std::size_t interval : { 1, 5, 64 })
+    {
+        const utf8::offset_index index( text.cbegin( ), text.cend( ), interval );
+        std::vector<uint8_t> data;
+        index.serialize( std::back_inserter( data ) );
+        BOOST_REQUIRE( utf8::offset_index::deserialize( data.cbegin( ), data.cend( ) ) == index );
+
+        // every truncation and a damaged signature are rejected
+        for (std::size_t size = 0; size < data.size( ); ++size)
+        {
+            BOOST_REQUIRE_THROW( utf8::offset_index::deserialize( data.cbegin( ), data.cbegin( ) + size ),
+                std::invalid_argument );
+        }
+        data[0] = 'X';
+        BOOST_REQUIRE_THROW( utf8::offset_index::deserialize( data.cbegin( ), data.cend( ) ), std::invalid_argument );
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( invalid_input, fixtures::mixed_u8 )
+{
+    const std::string str = text + "\xED\xA0\x80";
+    BOOST_REQUIRE_THROW( utf8::offset_index( str.cbegin( ), str.cend( ) ), utf8::invalid_utf8 );
+    BOOST_REQUIRE_THROW( utf8::offset_index( text.cbegin( ), text.cend( ), 0 ), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
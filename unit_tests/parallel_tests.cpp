@@ -0,0 +1,140 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <utf8.h>
+#include <utf8/parallel.h>
+
+#include "fixtures.hpp"
+
+BOOST_AUTO_TEST_SUITE( utf8ut_parallel )
+
+// spans a few chunks, so that errors can be put around their boundaries
+struct large_fixture : fixtures::mixed_u8
+{
+    std::string large;
+
+    large_fixture( )
+    {
+        while (large.size( ) < 3 * utf8::detail::parallel_chunk_size + 1000)
+        {
+            large += text;
+        }
+    }
+};
+
+static const unsigned threads = 4;
+
+template< typename unit_type, typename serial_conversion, typename parallel_conversion >
+static void require_same_conversion( const std::string &str, serial_conversion serial, parallel_conversion parallel )
+{
+    std::vector<unit_type> expected( str.size( ), unit_type( 0x5A ) ), output( expected );
+    std::string expected_error, error;
+    std::ptrdiff_t expected_written = -1, written = -1;
+    try
+    {
+        expected_written = serial( str.cbegin( ), str.cend( ), expected.begin( ) ) - expected.begin( );
+    }
+    catch (const utf8::exception &exc)
+    {
+        expected_error = typeid(exc).name( );
+    }
+    try
+    {
+        written = parallel( str.cbegin( ), str.cend( ), output.begin( ), threads ) - output.begin( );
+    }
+    catch (const utf8::exception &exc)
+    {
+        error = typeid(exc).name( );
+    }
+    BOOST_REQUIRE_EQUAL( error, expected_error );
+    BOOST_REQUIRE_EQUAL( written, expected_written );
+    BOOST_REQUIRE( output == expected );
+}
+
+static void require_same_as_serial( const std::string &str )
+{
+    BOOST_REQUIRE( utf8::parallel::find_invalid( str.cbegin( ), str.cend( ), threads )
+        == utf8::find_invalid( str.cbegin( ), str.cend( ) ) );
+    BOOST_REQUIRE_EQUAL( utf8::parallel::is_valid( str.cbegin( ), str.cend( ), threads ),
+        utf8::is_valid( str.cbegin( ), str.cend( ) ) );
+
+    std::string expected_error, error;
+    std::ptrdiff_t expected_dist = -1, dist = -1;
+    try
+    {
+        expected_dist = utf8::distance( str.cbegin( ), str.cend( ) );
+    }
+    catch (const utf8::exception &exc)
+    {
+        expected_error = typeid(exc).name( );
+    }
+    try
+    {
+        dist = utf8::parallel::distance( str.cbegin( ), str.cend( ), threads );
+    }
+    catch (const utf8::exception &exc)
+    {
+        error = typeid(exc).name( );
+    }
+    BOOST_REQUIRE_EQUAL( error, expected_error );
+    BOOST_REQUIRE_EQUAL( dist, expected_dist );
+
+    typedef std::string::const_iterator octet_iterator;
+    require_same_conversion<char16_t>( str,
+        []( octet_iterator start, octet_iterator end, std::vector<char16_t>::iterator result )
+        { return utf8::utf8to16( start, end, result ); },
+        []( octet_iterator start, octet_iterator end, std::vector<char16_t>::iterator result, unsigned n )
+        { return utf8::parallel::utf8to16( start, end, result, n ); } );
+    require_same_conversion<char32_t>( str,
+        []( octet_iterator start, octet_iterator end, std::vector<char32_t>::iterator result )
+        { return utf8::utf8to32( start, end, result ); },
+        []( octet_iterator start, octet_iterator end, std::vector<char32_t>::iterator result, unsigned n )
+        { return utf8::parallel::utf8to32( start, end, result, n ); } );
+}
+
+BOOST_FIXTURE_TEST_CASE( valid_input, large_fixture )
+{
+    require_same_as_serial( large );
+    require_same_as_serial( text );
+}
+
+// the preallocated utf-16 output of every chunk is counted by the simd kernel
+BOOST_AUTO_TEST_CASE( supplementary_input )
+{
+    std::string str;
+    while (str.size( ) < 3 * utf8::detail::parallel_chunk_size + 1000)
+    {
+        str += u8"\U0001F600\U0001F44D\U00010346";
+    }
+    require_same_as_serial( str );
+}
+
+BOOST_FIXTURE_TEST_CASE( invalid_input, large_fixture )
+{
+    const std::size_t chunk = utf8::detail::parallel_chunk_size;
+    for (const char *invalid : { "\x80", "\xED\xA0\x80", "\xF0\x9F\x98" })
+    {
+        for (std::size_t pos : { std::size_t( 0 ), chunk - 1, chunk, chunk + 2, large.size( ) })
+        {
+            std::string str = large;
+            str.insert( pos, invalid );
+            BOOST_TEST_CHECKPOINT( "invalid_input pos=" << pos );
+            require_same_as_serial( str );
+        }
+    }
+
+    // a long run of trail octets across a chunk boundary
+    std::string str = large;
+    str.replace( chunk - 8, 16, std::string( 16, '\x80' ) );
+    require_same_as_serial( str );
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
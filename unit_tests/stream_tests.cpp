@@ -0,0 +1,125 @@
+// Copyright 2015 Henrik Steffen Gaßmann
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <utf8.h>
+
+#include "fixtures.hpp"
+
+BOOST_AUTO_TEST_SUITE( utf8ut_stream )
+
+struct stream_fixture : fixtures::mixed_u8, fixtures::malformed_u8 {};
+
+// Feeds str in chunks of chunk_size octets, the deque takes the scalar path.
+// Returns the error of the first rejected chunk or the one of finish().
+template< typename unit_type, typename input_type >
+static utf8::error_code decode_chunked( const input_type &input, std::size_t chunk_size, std::basic_string<unit_type> &output )
+{
+    utf8::stream_transcoder<unit_type> transcoder;
+    for (auto it = input.cbegin( ); it != input.cend( ); )
+    {
+        const auto chunk_end = it + std::min<std::ptrdiff_t>( chunk_size, input.cend( ) - it );
+        const auto r = transcoder.decode( it, chunk_end, std::back_inserter( output ) );
+        if (!r)
+        {
+            return r.error;
+        }
+        BOOST_REQUIRE( r.in == chunk_end );
+        BOOST_REQUIRE( transcoder.pending_octets( ) < 4 );
+        it = chunk_end;
+    }
+    return transcoder.finish( );
+}
+
+template< typename unit_type >
+static void require_same_as_whole( const std::string &str, std::size_t chunk_size )
+{
+    std::basic_string<unit_type> expected( str.size( ), unit_type( 0 ) );
+    const auto expected_r = sizeof( unit_type ) == 2
+        ? utf8::try_utf8to16( str.cbegin( ), str.cend( ), expected.begin( ) )
+        : utf8::try_utf8to32( str.cbegin( ), str.cend( ), expected.begin( ) );
+    expected.erase( expected_r.out, expected.end( ) );
+
+    std::basic_string<unit_type> output, scalar_output;
+    const utf8::error_code error = decode_chunked( str, chunk_size, output );
+    const utf8::error_code scalar_error = decode_chunked( std::deque<char>( str.cbegin( ), str.cend( ) ),
+        chunk_size, scalar_output );
+
+    BOOST_REQUIRE( error == expected_r.error );
+    BOOST_REQUIRE( scalar_error == expected_r.error );
+    BOOST_REQUIRE( output == expected );
+    BOOST_REQUIRE( scalar_output == expected );
+}
+
+BOOST_FIXTURE_TEST_CASE( chunked_valid_input, stream_fixture )
+{
+    for (std::size_t chunk_size = 1; chunk_size <= text.size( ); chunk_size += chunk_size < 8 ? 1 : 29)
+    {
+        BOOST_TEST_CHECKPOINT( "chunked_valid_input chunk_size=" << chunk_size );
+        require_same_as_whole<char16_t>( text, chunk_size );
+        require_same_as_whole<char32_t>( text, chunk_size );
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( chunked_invalid_input, stream_fixture )
+{
+    for (const char *invalid : malformed)
+    {
+        for (size_t pos = 0; pos <= text.size( ); pos += 7)
+        {
+            std::string str = text;
+            str.insert( pos, invalid );
+            for (std::size_t chunk_size : { 1, 2, 3, 5, 64 })
+            {
+                BOOST_TEST_CHECKPOINT( "chunked_invalid_input pos=" << pos << " chunk_size=" << chunk_size );
+                require_same_as_whole<char16_t>( str, chunk_size );
+                require_same_as_whole<char32_t>( str, chunk_size );
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( split_sequence )
+{
+    const std::string str = u8"\U0001F600";
+    std::u32string output;
+    utf8::stream_decoder decoder;
+
+    auto r = decoder.decode( str.cbegin( ), str.cbegin( ) + 1, std::back_inserter( output ) );
+    BOOST_REQUIRE( r && r.in == str.cbegin( ) + 1 );
+    BOOST_REQUIRE_EQUAL( decoder.pending_octets( ), 1u );
+    r = decoder.decode( str.cbegin( ) + 1, str.cbegin( ) + 3, std::back_inserter( output ) );
+    BOOST_REQUIRE( r );
+    BOOST_REQUIRE_EQUAL( decoder.pending_octets( ), 3u );
+    BOOST_REQUIRE( output.empty( ) );
+    r = decoder.decode( str.cbegin( ) + 3, str.cend( ), std::back_inserter( output ) );
+    BOOST_REQUIRE( r );
+    BOOST_REQUIRE_EQUAL( decoder.pending_octets( ), 0u );
+    BOOST_REQUIRE( output == U"\U0001F600" );
+    BOOST_REQUIRE( decoder.finish( ) == utf8::error_code::ok );
+
+    // the continuation is missing, the error is reported in front of the 'a'
+    const std::string broken = "\xE6\x97" "a";
+    r = decoder.decode( broken.cbegin( ), broken.cbegin( ) + 2, std::back_inserter( output ) );
+    BOOST_REQUIRE( r );
+    r = decoder.decode( broken.cbegin( ) + 2, broken.cend( ), std::back_inserter( output ) );
+    BOOST_REQUIRE( r.error == utf8::error_code::invalid_utf8 );
+    BOOST_REQUIRE( r.in == broken.cbegin( ) + 2 );
+    BOOST_REQUIRE_EQUAL( decoder.pending_octets( ), 0u );
+
+    // the stream ends within a sequence
+    r = decoder.decode( broken.cbegin( ), broken.cbegin( ) + 2, std::back_inserter( output ) );
+    BOOST_REQUIRE( r );
+    BOOST_REQUIRE( decoder.finish( ) == utf8::error_code::not_enough_room );
+    BOOST_REQUIRE_EQUAL( decoder.pending_octets( ), 0u );
+}
+
+BOOST_AUTO_TEST_SUITE_END( )
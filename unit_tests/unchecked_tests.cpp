@@ -4,6 +4,8 @@
 // (See accompanying file ../LICENSE or http://www.boost.org/LICENSE_1_0.txt)
 ////////////////////////////////////////////////////////////////////////////////
 #include <cstdint>
+#include <deque>
+#include <string>
 
 #include <boost/test/unit_test.hpp>
 
@@ -127,6 +129,111 @@ BOOST_FIXTURE_TEST_CASE( utf8to16, utf16conv_fixture )
     BOOST_CHECK( it_u16 == str.end( ) );
 }
 
+BOOST_FIXTURE_TEST_CASE( distance_contiguous, fixtures::mixed_u8 )
+{
+    std::u32string str;
+    utf8::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( str ) );
+    const std::deque<char> scalar_text( text.cbegin( ), text.cend( ) );
+    BOOST_CHECK_EQUAL( lib::distance( text.cbegin( ), text.cend( ) ), static_cast<std::ptrdiff_t>(str.size( )) );
+    BOOST_CHECK_EQUAL( lib::distance( scalar_text.cbegin( ), scalar_text.cend( ) ), static_cast<std::ptrdiff_t>(str.size( )) );
+    BOOST_CHECK_EQUAL( lib::distance( text.cend( ), text.cbegin( ) ), 0 );
+}
+
+BOOST_FIXTURE_TEST_CASE( advance_contiguous, fixtures::mixed_u8 )
+{
+    const std::string text4 = text + text + text + text;
+    const std::deque<char> scalar_text( text4.cbegin( ), text4.cend( ) );
+    const std::ptrdiff_t num_cps = lib::distance( text4.cbegin( ), text4.cend( ) );
+    for (std::ptrdiff_t n = 0; n <= num_cps; ++n)
+    {
+        BOOST_TEST_CHECKPOINT( "n=" << n );
+        std::string::const_iterator it = text4.cbegin( );
+        std::deque<char>::const_iterator scalar_it = scalar_text.cbegin( );
+        lib::advance( it, n );
+        lib::advance( scalar_it, n );
+        BOOST_REQUIRE_EQUAL( it - text4.cbegin( ), scalar_it - scalar_text.cbegin( ) );
+
+        lib::iterator<std::string::const_iterator> u8it( text4.cbegin( ) );
+        u8it += n;
+        BOOST_REQUIRE( u8it.base( ) == it );
+        u8it += -n;
+        BOOST_REQUIRE( u8it.base( ) == text4.cbegin( ) );
+
+        it = text4.cend( );
+        scalar_it = scalar_text.cend( );
+        lib::retreat( it, n );
+        lib::retreat( scalar_it, n );
+        BOOST_REQUIRE_EQUAL( text4.cend( ) - it, scalar_text.cend( ) - scalar_it );
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( utf8to32_contiguous, fixtures::mixed_u8 )
+{
+    // the std::deque takes the scalar path
+    const std::string text4 = text + text + text + text;
+    const std::deque<char> scalar_input( text4.cbegin( ), text4.cend( ) );
+    std::u32string str( text4.size( ), 0 ), scalar_str( text4.size( ), 0 );
+
+    str.resize( lib::utf8to32( text4.cbegin( ), text4.cend( ), str.begin( ) ) - str.begin( ) );
+    scalar_str.resize( lib::utf8to32( scalar_input.cbegin( ), scalar_input.cend( ), scalar_str.begin( ) ) - scalar_str.begin( ) );
+    BOOST_REQUIRE( str == scalar_str );
+
+    std::string round_trip( text4.size( ), 0 );
+    round_trip.resize( lib::utf32to8( str.cbegin( ), str.cend( ), round_trip.begin( ) ) - round_trip.begin( ) );
+    BOOST_REQUIRE( round_trip == text4 );
+}
+
+BOOST_FIXTURE_TEST_CASE( utf16to32_contiguous, fixtures::mixed_u8 )
+{
+    // the std::deque takes the scalar path
+    std::u16string text16;
+    std::u32string text32;
+    lib::utf8to16( text.cbegin( ), text.cend( ), std::back_inserter( text16 ) );
+    lib::utf8to32( text.cbegin( ), text.cend( ), std::back_inserter( text32 ) );
+    for (int i = 0; i < 2; ++i)
+    {
+        text16 += text16;
+        text32 += text32;
+    }
+    const std::deque<char16_t> scalar_input( text16.cbegin( ), text16.cend( ) );
+    std::u32string str( text16.size( ), 0 ), scalar_str( text16.size( ), 0 );
+    str.resize( lib::utf16to32( text16.cbegin( ), text16.cend( ), str.begin( ) ) - str.begin( ) );
+    scalar_str.resize( lib::utf16to32( scalar_input.cbegin( ), scalar_input.cend( ), scalar_str.begin( ) ) - scalar_str.begin( ) );
+    BOOST_REQUIRE( str == text32 );
+    BOOST_REQUIRE( scalar_str == text32 );
+
+    const std::deque<char32_t> scalar_input32( text32.cbegin( ), text32.cend( ) );
+    std::u16string str16( text16.size( ), 0 ), scalar_str16( text16.size( ), 0 );
+    str16.resize( lib::utf32to16( text32.cbegin( ), text32.cend( ), str16.begin( ) ) - str16.begin( ) );
+    scalar_str16.resize( lib::utf32to16( scalar_input32.cbegin( ), scalar_input32.cend( ), scalar_str16.begin( ) ) - scalar_str16.begin( ) );
+    BOOST_REQUIRE( str16 == text16 );
+    BOOST_REQUIRE( scalar_str16 == text16 );
+}
+
+BOOST_AUTO_TEST_CASE( latin1_contiguous )
+{
+    // the std::deque takes the scalar path
+    std::string latin1;
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        latin1 += static_cast<char>(i % 5 < 2 ? 'a' + i % 26 : (i * 7) & 0xFF);
+    }
+    const std::deque<char> scalar_input( latin1.cbegin( ), latin1.cend( ) );
+    std::string str( 2 * latin1.size( ), 0 ), scalar_str( 2 * latin1.size( ), 0 );
+    str.resize( lib::latin1to8( latin1.cbegin( ), latin1.cend( ), str.begin( ) ) - str.begin( ) );
+    scalar_str.resize( lib::latin1to8( scalar_input.cbegin( ), scalar_input.cend( ), scalar_str.begin( ) ) - scalar_str.begin( ) );
+    BOOST_REQUIRE( str == scalar_str );
+    BOOST_REQUIRE_EQUAL( str.size( ), utf8::utf8_length_from_latin1( latin1.cbegin( ), latin1.cend( ) ) );
+
+    const std::deque<char> scalar_str_deque( str.cbegin( ), str.cend( ) );
+    std::string round_trip( latin1.size( ), 0 ), scalar_round_trip( latin1.size( ), 0 );
+    BOOST_REQUIRE( lib::utf8tolatin1( str.cbegin( ), str.cend( ), round_trip.begin( ) ) == round_trip.end( ) );
+    BOOST_REQUIRE( lib::utf8tolatin1( scalar_str_deque.cbegin( ), scalar_str_deque.cend( ), scalar_round_trip.begin( ) )
+        == scalar_round_trip.end( ) );
+    BOOST_REQUIRE( round_trip == latin1 );
+    BOOST_REQUIRE( scalar_round_trip == latin1 );
+}
+
 struct iterator_fixture : fixtures::valid_u8_with_it, fixtures::valid_u32 {};
 
 BOOST_FIXTURE_TEST_CASE( iterator, iterator_fixture )